@@ -0,0 +1,176 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Heap allocations made to build and serialize an outgoing message, with
+//messages on the heap and with PolluxMessageArena, in steady state, then
+//through the whole ZebulonPayloadClient::transmit path against a loopback
+//server playing zebulon. On the receive side, PolluxPayload::receive of a
+//message routed to a handler with observers, delivered on arrival and in
+//sequence order.
+//Allocations are counted by replacing the global operator new: by the
+//calling thread, and by the whole process (gRPC threads and the loopback
+//server included).
+//usage: pollux-bench-alloc [iterations (default 100000)]
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxMessageArena.h"
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+#include "pollux.pb.h"
+
+namespace {
+
+std::atomic<size_t> nbAllocations{0};
+thread_local size_t nbThreadAllocations = 0;
+
+}
+
+void* operator new(size_t size) {
+  ++nbAllocations;
+  ++nbThreadAllocations;
+  if (void* pointer = std::malloc(size ? size : 1)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+namespace {
+
+const std::string key("alloc_bench");
+const int zebulonPort = 50996;
+
+class ZebulonReceiver final: public pollux::ZebulonPayload::Service {
+  public:
+    grpc::Status Transmit(
+      grpc::ServerContext* context,
+      const pollux::PolluxMessage* message,
+      pollux::PolluxMessageResponse* response) override {
+      return grpc::Status::OK;
+    }
+};
+
+//what the typed transmits and setRouting fill in
+void fill(pollux::PolluxMessage& message, int64_t value) {
+  message.set_key(key);
+  message.set_int64value(value);
+  message.set_origin(0);
+  message.add_destinations(1);
+  message.add_sequences(value);
+}
+
+template <typename Build>
+void run(const char* name, size_t iterations, Build build) {
+  std::string buffer;
+  //warm up: thread blocks, buffer capacity, connection
+  for (size_t i = 0; i < 16; i++) {
+    build(i, buffer);
+  }
+  const size_t before = nbAllocations;
+  const size_t threadBefore = nbThreadAllocations;
+  const auto start{std::chrono::steady_clock::now()};
+  for (size_t i = 0; i < iterations; i++) {
+    build(i, buffer);
+  }
+  const std::chrono::duration<double> elapsed_seconds{std::chrono::steady_clock::now() - start};
+  std::cout << std::setw(10) << name << std::fixed << std::setprecision(3)
+    << std::setw(20) << double(nbThreadAllocations - threadBefore) / iterations
+    << std::setw(20) << double(nbAllocations - before) / iterations
+    << std::setw(12) << std::setprecision(1) << elapsed_seconds.count() * 1e9 / iterations << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const size_t iterations = argc > 1 ? std::stoul(argv[1]) : 100000;
+
+  std::cout << std::setw(10) << "messages" << std::setw(20) << "thread allocs/msg"
+    << std::setw(20) << "process allocs/msg" << std::setw(12) << "ns/msg" << std::endl;
+  run("heap", iterations, [](size_t i, std::string& buffer) {
+    pollux::PolluxMessage message;
+    fill(message, i);
+    message.SerializeToString(&buffer);
+  });
+  run("arena", iterations, [](size_t i, std::string& buffer) {
+    PolluxMessageArena arena;
+    auto message = arena.create<pollux::PolluxMessage>();
+    fill(*message, i);
+    message->SerializeToString(&buffer);
+  });
+
+  {
+    PolluxPayload payload("alloc_bench");
+    payload.setLocalID(1);
+    size_t nbHandled = 0;
+    PolluxPayload::Registrations registrations;
+    registrations.registerMessageHandler(payload, key, [&nbHandled](const pollux::PolluxMessage*) { ++nbHandled; });
+    for (int i = 0; i < 2; i++) {
+      registrations.addMessageObserver(payload, [&nbHandled](const pollux::PolluxMessage*) { ++nbHandled; });
+    }
+    pollux::PolluxMessage message;
+    fill(message, 1);
+    message.clear_sequences();
+    run("dispatch", iterations, [&payload, &message](size_t i, std::string&) {
+      payload.receive(&message);
+    });
+    //sequence numbers go on across the warm up and measured runs
+    uint64_t sequence = 0;
+    run("in order", iterations, [&payload, &message, &sequence](size_t i, std::string&) {
+      message.clear_sequences();
+      message.add_sequences(++sequence);
+      payload.receive(&message);
+    });
+  }
+
+  spdlog::set_level(spdlog::level::warn);
+  ZebulonReceiver receiver;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureServerCredentials());
+  builder.RegisterService(&receiver);
+  auto server = builder.BuildAndStart();
+  //one gRPC call per message: fewer iterations keep the run short
+  const size_t nbTransmits = std::max(iterations / 10, size_t(1));
+  {
+    //floor: what gRPC allocates for a unary call, message built once
+    auto stub = pollux::ZebulonPayload::NewStub(
+      grpc::CreateChannel("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureChannelCredentials()));
+    pollux::PolluxMessage message;
+    fill(message, 1);
+    pollux::PolluxMessageResponse response;
+    run("grpc call", nbTransmits, [&](size_t i, std::string&) {
+      grpc::ClientContext context;
+      stub->Transmit(&context, message, &response);
+    });
+  }
+  {
+    ZebulonPayloadClient client(
+      grpc::CreateChannel("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureChannelCredentials()), 0);
+    //as negotiated in Start: sequence numbers, no compression
+    pollux::PolluxCapabilities capabilities;
+    capabilities.set_sequencing(true);
+    client.setCapabilities(capabilities);
+    run("ordered", nbTransmits, [&client](size_t i, std::string&) {
+      client.transmit(1, key, int64_t(i));
+    });
+    client.setOrdered(false);
+    run("unordered", nbTransmits, [&client](size_t i, std::string&) {
+      client.transmit(1, key, int64_t(i));
+    });
+  }
+  server->Shutdown();
+  return 0;
+}
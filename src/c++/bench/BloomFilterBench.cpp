@@ -0,0 +1,130 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//PolluxBloomFilter checked against std::unordered_set then measured.
+//Random key sets are inserted with a reference set alongside: no inserted
+//key may be reported absent, insert must report every key seen before as
+//present, the false positive rate of never inserted keys must stay close
+//to the sizing target and hashBatch must match hash.
+//Throughput of hash against hashBatch and of contains is then reported.
+//usage: pollux-bench-bloom [keys per seed (default 200000)]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_set>
+
+#include "PolluxBloomFilter.h"
+
+namespace {
+
+const size_t nbHashedKeys = 1 << 20;
+const size_t nbHashRounds = 50;
+
+//returns false on the first check failing
+bool check(uint32_t seed, size_t nbKeys, double falsePositiveRate) {
+  size_t nbBits = PolluxBloomFilter::getOptimalNbBits(nbKeys, falsePositiveRate);
+  PolluxBloomFilter filter(nbBits, PolluxBloomFilter::getOptimalNbHashes(nbBits, nbKeys));
+  std::unordered_set<uint64_t> reference;
+  std::mt19937_64 generator(seed);
+  //a small key range makes keys repeat
+  std::uniform_int_distribution<uint64_t> keys(0, nbKeys * 2);
+  std::vector<uint64_t> batch(nbKeys);
+  for (auto& key: batch) {
+    key = keys(generator);
+  }
+  std::vector<uint64_t> hashes(nbKeys);
+  PolluxBloomFilter::hashBatch(batch.data(), batch.size(), hashes.data());
+  for (size_t i=0; i<nbKeys; i++) {
+    uint64_t key = batch[i];
+    if (hashes[i] != PolluxBloomFilter::hash(key)) {
+      std::cerr << "seed " << seed << ": hashBatch differs from hash for key " << key << std::endl;
+      return false;
+    }
+    bool seen = not reference.insert(key).second;
+    bool present = filter.insert(hashes[i]);
+    if (seen and not present) {
+      std::cerr << "seed " << seed << ": key " << key << " inserted again reported absent" << std::endl;
+      return false;
+    }
+  }
+  for (auto key: reference) {
+    if (not filter.contains(PolluxBloomFilter::hash(key))) {
+      std::cerr << "seed " << seed << ": false negative for key " << key << std::endl;
+      return false;
+    }
+  }
+  //keys above the inserted range were never inserted
+  const size_t nbQueries = 100000;
+  size_t nbFalsePositives = 0;
+  for (size_t i=0; i<nbQueries; i++) {
+    nbFalsePositives += filter.contains(PolluxBloomFilter::hash(nbKeys * 4 + generator() % (nbKeys * 64)));
+  }
+  //blocked filters pay a little over the classic sizing formula
+  double rate = double(nbFalsePositives) / nbQueries;
+  double targetRate = falsePositiveRate * double(nbKeys) / reference.size();
+  if (rate > targetRate * 3 + 0.001) {
+    std::cerr << "seed " << seed << ": false positive rate " << rate << " for target " << falsePositiveRate << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template<typename Function>
+double getNanosecondsPerKey(Function function, size_t nbKeys) {
+  const auto start{std::chrono::steady_clock::now()};
+  for (size_t round=0; round<nbHashRounds; round++) {
+    function();
+  }
+  std::chrono::duration<double, std::nano> elapsed{std::chrono::steady_clock::now() - start};
+  return elapsed.count() / (nbHashRounds * nbKeys);
+}
+
+}
+
+int main(int argc, char** argv) {
+  const size_t nbKeys = argc > 1 ? std::stoul(argv[1]) : 200000;
+  for (double falsePositiveRate: {0.1, 0.01, 0.001}) {
+    for (uint32_t seed=1; seed<=4; seed++) {
+      if (not check(seed, nbKeys, falsePositiveRate)) {
+        return 1;
+      }
+    }
+  }
+  std::cout << "random key sets checked against std::unordered_set" << std::endl;
+
+  std::mt19937_64 generator(42);
+  std::vector<uint64_t> keys(nbHashedKeys);
+  for (auto& key: keys) {
+    key = generator();
+  }
+  std::vector<uint64_t> hashes(nbHashedKeys);
+  double scalar = getNanosecondsPerKey([&]() {
+    for (size_t i=0; i<keys.size(); i++) {
+      hashes[i] = PolluxBloomFilter::hash(keys[i]);
+    }
+    //keeps the stores from being dropped
+    asm volatile("" ::: "memory");
+  }, keys.size());
+  double batched = getNanosecondsPerKey([&]() {
+    PolluxBloomFilter::hashBatch(keys.data(), keys.size(), hashes.data());
+    asm volatile("" ::: "memory");
+  }, keys.size());
+  size_t nbBits = PolluxBloomFilter::getOptimalNbBits(nbHashedKeys, 0.01);
+  PolluxBloomFilter filter(nbBits, PolluxBloomFilter::getOptimalNbHashes(nbBits, nbHashedKeys));
+  for (auto hash: hashes) {
+    filter.insert(hash);
+  }
+  size_t nbFound = 0;
+  double contains = getNanosecondsPerKey([&]() {
+    for (auto hash: hashes) {
+      nbFound += filter.contains(hash);
+    }
+  }, keys.size());
+  std::cout << std::fixed << std::setprecision(2)
+    << "hash          " << std::setw(8) << scalar << " ns/key" << std::endl
+    << "hashBatch     " << std::setw(8) << batched << " ns/key" << std::endl
+    << "contains      " << std::setw(8) << contains << " ns/key (" << nbFound << " found)" << std::endl;
+  return 0;
+}
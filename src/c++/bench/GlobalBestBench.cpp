@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//PolluxGlobalBest convergence check: every payload submits random candidates
+//from its own thread, most of them not improving, while messages are
+//delivered concurrently (queued and delivered by another thread, or handed
+//over in the sender thread). Once quiet, the owner register must hold the
+//best submitted candidate and every payload cache must be the confirmed
+//owner register. Messages per submit are reported.
+//usage: pollux-bench-globalbest [submits per payload (default 2000)]
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxGlobalBest.h"
+#include "PolluxLoopback.h"
+
+namespace {
+
+const size_t nbPayloads = 8;
+const int owner = 0;
+
+struct Result {
+  size_t  nbSent      {0};
+  size_t  nbMessages  {0};
+  bool    converged   {false};
+};
+
+Result run(PolluxLoopback::Mode mode, size_t nbSubmits, uint32_t seed) {
+  PolluxLoopback loopback(nbPayloads, mode);
+  std::vector<std::unique_ptr<PolluxGlobalBest>> nodes;
+  for (int id=0; id<int(nbPayloads); id++) {
+    nodes.push_back(std::make_unique<PolluxGlobalBest>(id, owner, loopback.getMessageSender(id)));
+    auto node = nodes.back().get();
+    loopback.setHandler(id, [node](const pollux::PolluxMessage* message) { node->receive(message); });
+  }
+
+  std::atomic<size_t> nbRunning {nbPayloads};
+  std::thread delivery([&]() {
+    while (nbRunning > 0) {
+      if (loopback.deliver() == 0) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  std::vector<double> bests(nbPayloads, std::numeric_limits<double>::max());
+  std::vector<size_t> nbSent(nbPayloads, 0);
+  std::vector<std::thread> threads;
+  for (int id=0; id<int(nbPayloads); id++) {
+    threads.emplace_back([&, id]() {
+      std::mt19937_64 generator(seed * nbPayloads + id);
+      std::uniform_real_distribution<double> distribution(0, 1000000);
+      for (size_t i=0; i<nbSubmits; i++) {
+        double fitness = distribution(generator);
+        bests[id] = std::min(bests[id], fitness);
+        if (nodes[id]->submit(fitness, {double(id), fitness})) {
+          ++nbSent[id];
+        }
+      }
+      --nbRunning;
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  delivery.join();
+  while (loopback.deliver() > 0);
+
+  Result result;
+  double best = *std::min_element(bests.begin(), bests.end());
+  auto reference = nodes[owner]->getBest();
+  result.converged = reference.fitness == best and reference.version > 0
+    and reference.values == std::vector<double>({double(reference.origin), best});
+  for (int id=0; id<int(nbPayloads); id++) {
+    auto entry = nodes[id]->getBest();
+    if (entry.origin != reference.origin or entry.version != reference.version
+      or entry.fitness != reference.fitness or entry.values != reference.values) {
+      std::cerr << "seed " << seed << ": payload " << id << " holds " << entry.fitness
+        << " (version " << entry.version << ") for " << reference.fitness
+        << " (version " << reference.version << ") on the owner" << std::endl;
+      result.converged = false;
+    }
+  }
+  if (reference.fitness != best) {
+    std::cerr << "seed " << seed << ": owner holds " << reference.fitness << " for " << best << " submitted" << std::endl;
+  }
+  for (auto sent: nbSent) {
+    result.nbSent += sent;
+  }
+  result.nbMessages = loopback.getNbMessages();
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  const size_t nbSubmits = argc > 1 ? std::stoul(argv[1]) : 2000;
+  const uint32_t nbSeeds = 10;
+
+  std::cout << std::setw(10) << "mode" << std::setw(12) << "converged"
+    << std::setw(12) << "improving" << std::setw(18) << "messages/submit" << std::endl;
+  bool converged = true;
+  for (auto mode: {PolluxLoopback::Queued, PolluxLoopback::Immediate}) {
+    size_t nbConverged = 0;
+    double nbSent = 0;
+    double nbMessages = 0;
+    for (uint32_t seed=1; seed<=nbSeeds; seed++) {
+      auto result = run(mode, nbSubmits, seed);
+      nbConverged += result.converged ? 1 : 0;
+      nbSent += result.nbSent;
+      nbMessages += result.nbMessages;
+    }
+    converged = converged and nbConverged == nbSeeds;
+    std::cout << std::setw(10) << (mode == PolluxLoopback::Queued ? "queued" : "immediate")
+      << std::setw(9) << nbConverged << "/" << nbSeeds
+      << std::setw(12) << std::fixed << std::setprecision(1) << nbSent/nbSeeds
+      << std::setw(18) << std::setprecision(3) << nbMessages/(nbSeeds*nbSubmits*nbPayloads) << std::endl;
+  }
+  return converged ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//PolluxGlobalCounters check: payloads on their own threads mix fetchAdd
+//calls, left in flight while more are sent, with combined add and max
+//updates and flushes, messages being delivered by another thread, so that
+//owner answers overtake each other. Every fetchAdd must get a distinct
+//previous value, together covering 0..calls-1, and once quiet every cache
+//must hold the owner values. Messages per operation are reported.
+//usage: pollux-bench-counters [operations per payload (default 5000)]
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxGlobalCounters.h"
+#include "PolluxLoopback.h"
+
+namespace {
+
+const size_t nbPayloads = 8;
+const int owner = 0;
+const uint32_t nbSeeds = 5;
+
+struct Result {
+  size_t  nbFetches   {0};
+  size_t  nbMessages  {0};
+  bool    correct     {true};
+};
+
+Result run(size_t nbOperations, uint32_t seed) {
+  PolluxLoopback loopback(nbPayloads);
+  std::vector<std::unique_ptr<PolluxGlobalCounters>> nodes;
+  for (int id=0; id<int(nbPayloads); id++) {
+    //flushes are explicit or done by updates every millisecond
+    nodes.push_back(std::make_unique<PolluxGlobalCounters>(id, owner, loopback.getMessageSender(id),
+      std::chrono::milliseconds(1)));
+    auto node = nodes.back().get();
+    loopback.setHandler(id, [node](const pollux::PolluxMessage* message) { node->receive(message); });
+  }
+
+  std::atomic<size_t> nbRunning {nbPayloads};
+  std::thread delivery([&]() {
+    while (nbRunning > 0) {
+      if (loopback.deliver() == 0) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  std::vector<std::vector<int64_t>> tickets(nbPayloads);
+  std::vector<int64_t> totals(nbPayloads, 0);
+  std::vector<int64_t> peaks(nbPayloads, 0);
+  std::vector<std::thread> threads;
+  for (int id=0; id<int(nbPayloads); id++) {
+    threads.emplace_back([&, id]() {
+      auto node = nodes[id].get();
+      std::mt19937_64 generator(seed * nbPayloads + id);
+      std::uniform_int_distribution<int> operations(0, 99);
+      std::uniform_int_distribution<int64_t> values(1, 1000000);
+      std::vector<std::future<int64_t>> fetches;
+      for (size_t i=0; i<nbOperations; i++) {
+        int operation = operations(generator);
+        if (operation < 30) {
+          fetches.push_back(node->fetchAdd("tickets", 1));
+        } else if (operation < 70) {
+          int64_t delta = values(generator);
+          totals[id] += delta;
+          node->add("total", delta);
+        } else if (operation < 90) {
+          int64_t value = values(generator);
+          peaks[id] = std::max(peaks[id], value);
+          node->max("peak", value);
+        } else if (operation < 95) {
+          node->flush();
+        } else {
+          node->get("total", std::chrono::milliseconds(0));
+        }
+        //a few answers awaited on the way, most left in flight
+        if (fetches.size() > 64) {
+          tickets[id].push_back(fetches.front().get());
+          fetches.erase(fetches.begin());
+        }
+      }
+      node->flush();
+      for (auto& fetch: fetches) {
+        tickets[id].push_back(fetch.get());
+      }
+      --nbRunning;
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  delivery.join();
+  while (loopback.deliver() > 0);
+  //nothing pending anymore: every payload asks for fresh values
+  for (auto& node: nodes) {
+    node->flush();
+  }
+  while (loopback.deliver() > 0);
+
+  Result result;
+  std::vector<int64_t> all;
+  for (const auto& payloadTickets: tickets) {
+    all.insert(all.end(), payloadTickets.begin(), payloadTickets.end());
+  }
+  std::sort(all.begin(), all.end());
+  result.nbFetches = all.size();
+  for (size_t i=0; i<all.size(); i++) {
+    if (all[i] != int64_t(i)) {
+      std::cerr << "seed " << seed << ": fetchAdd previous values are not 0.." << all.size()-1
+        << " (" << all[i] << " at " << i << ")" << std::endl;
+      result.correct = false;
+      break;
+    }
+  }
+  int64_t total = 0;
+  for (auto value: totals) {
+    total += value;
+  }
+  int64_t peak = *std::max_element(peaks.begin(), peaks.end());
+  const std::map<std::string, int64_t> expected({
+    {"tickets", int64_t(all.size())}, {"total", total}, {"peak", peak}});
+  for (int id=0; id<int(nbPayloads); id++) {
+    for (const auto& [name, value]: expected) {
+      if (nodes[id]->get(name) != value) {
+        std::cerr << "seed " << seed << ": payload " << id << " reads " << nodes[id]->get(name)
+          << " for " << name << ", " << value << " expected" << std::endl;
+        result.correct = false;
+      }
+    }
+  }
+  result.nbMessages = loopback.getNbMessages();
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  const size_t nbOperations = argc > 1 ? std::stoul(argv[1]) : 5000;
+
+  std::cout << std::setw(8) << "seed" << std::setw(12) << "fetchAdds"
+    << std::setw(18) << "messages/op" << std::setw(10) << "correct" << std::endl;
+  bool correct = true;
+  for (uint32_t seed=1; seed<=nbSeeds; seed++) {
+    auto result = run(nbOperations, seed);
+    correct = correct and result.correct;
+    std::cout << std::setw(8) << seed << std::setw(12) << result.nbFetches
+      << std::setw(18) << std::fixed << std::setprecision(3) << double(result.nbMessages)/(nbOperations*nbPayloads)
+      << std::setw(10) << (result.correct ? "yes" : "no") << std::endl;
+  }
+  return correct ? 0 : 1;
+}
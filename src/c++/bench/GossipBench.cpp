@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Gossip convergence time versus message count, compared to the
+//all-to-all broadcast used by PSO (every payload transmits to all others).
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxGossip.h"
+#include "PolluxLoopback.h"
+
+namespace {
+
+struct Result {
+  size_t  rounds        {0};
+  size_t  convergedAt   {0};
+  size_t  nbMessages    {0};
+  size_t  nbDuplicates  {0};
+  bool    converged     {false};
+};
+
+//every payload submits a local best, then gossip until silence
+Result run(size_t nbPayloads, size_t fanout, std::mt19937& generator) {
+  PolluxLoopback loopback(nbPayloads);
+  std::vector<std::unique_ptr<PolluxGossip>> nodes;
+  for (int id=0; id<int(nbPayloads); id++) {
+    nodes.push_back(std::make_unique<PolluxGossip>(id, loopback.getOtherIDs(id), fanout, loopback.getMessageSender(id)));
+    auto node = nodes.back().get();
+    loopback.setHandler(id, [node](const pollux::PolluxMessage* message) { node->receive(message); });
+  }
+  std::uniform_real_distribution<double> distribution(-1000, 1000);
+  double globalBest = std::numeric_limits<double>::max();
+  for (auto& node: nodes) {
+    double fitness = distribution(generator);
+    globalBest = std::min(globalBest, fitness);
+    node->submit(fitness, {fitness, -fitness});
+  }
+
+  Result result;
+  const size_t maxRounds = 1000;
+  while (result.rounds < maxRounds) {
+    size_t sent = 0;
+    for (auto& node: nodes) {
+      sent += node->round();
+    }
+    size_t delivered = loopback.deliver();
+    ++result.rounds;
+    if (not result.converged) {
+      result.converged = std::all_of(nodes.begin(), nodes.end(),
+        [globalBest](const auto& node) { return node->getBest().fitness == globalBest; });
+      if (result.converged) {
+        result.convergedAt = result.rounds;
+      }
+    }
+    if (sent == 0 and delivered == 0) {
+      break;
+    }
+  }
+  //flush eventual pull answers
+  while (loopback.deliver() > 0);
+  if (not result.converged) {
+    result.converged = std::all_of(nodes.begin(), nodes.end(),
+      [globalBest](const auto& node) { return node->getBest().fitness == globalBest; });
+    result.convergedAt = result.rounds;
+  }
+  result.nbMessages = loopback.getNbMessages();
+  for (auto& node: nodes) {
+    result.nbDuplicates += node->getNbDuplicates();
+  }
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  std::mt19937 generator(42);
+  const size_t nbRuns = 5;
+
+  std::cout << std::setw(8) << "payloads" << std::setw(8) << "fanout"
+    << std::setw(12) << "converged" << std::setw(12) << "rounds"
+    << std::setw(14) << "messages" << std::setw(14) << "duplicates"
+    << std::setw(14) << "broadcast" << std::endl;
+  for (size_t nbPayloads: {16, 64, 256, 1024, 4096}) {
+    for (size_t fanout: {1, 2, 4}) {
+      size_t nbConverged = 0;
+      double convergedAt = 0;
+      double nbMessages = 0;
+      double nbDuplicates = 0;
+      for (size_t run=0; run<nbRuns; run++) {
+        auto result = ::run(nbPayloads, fanout, generator);
+        nbConverged += result.converged ? 1 : 0;
+        convergedAt += result.convergedAt;
+        nbMessages += result.nbMessages;
+        nbDuplicates += result.nbDuplicates;
+      }
+      std::cout << std::setw(8) << nbPayloads << std::setw(8) << fanout
+        << std::setw(9) << nbConverged << "/" << nbRuns
+        << std::setw(12) << std::fixed << std::setprecision(1) << convergedAt/nbRuns
+        << std::setw(14) << std::setprecision(0) << nbMessages/nbRuns
+        << std::setw(14) << nbDuplicates/nbRuns
+        //all-to-all broadcast: one round, every payload sends to all others
+        << std::setw(14) << nbPayloads*(nbPayloads-1) << std::endl;
+    }
+  }
+  return 0;
+}
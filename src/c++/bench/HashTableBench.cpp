@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//PolluxHashTable against std::unordered_map. Random insert/erase/find
+//sequences are first checked against the reference map (small key ranges
+//make probe chains wrap around and erase shift them back), then
+//throughput of both is measured.
+//usage: pollux-bench-hashtable [checked operations per seed (default 200000)]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+#include "PolluxHashTable.h"
+
+namespace {
+
+const size_t nbEntries = 1000000;
+const size_t nbLookups = 4000000;
+
+//returns false on the first divergence from the reference map
+bool check(uint32_t seed, size_t nbOperations, uint64_t keyRange) {
+  PolluxHashTable table;
+  std::unordered_map<PolluxHashTable::Key, PolluxHashTable::Value> reference;
+  std::mt19937_64 generator(seed);
+  std::uniform_int_distribution<uint64_t> keys(0, keyRange - 1);
+  std::uniform_int_distribution<int> operations(0, 9);
+  for (size_t i=0; i<nbOperations; i++) {
+    PolluxHashTable::Key key = keys(generator);
+    std::optional<PolluxHashTable::Value> got;
+    std::optional<PolluxHashTable::Value> expected;
+    auto rit = reference.find(key);
+    if (rit != reference.end()) {
+      expected = rit->second;
+    }
+    int operation = operations(generator);
+    const char* name = "find";
+    if (operation < 4) {
+      name = "insert";
+      PolluxHashTable::Value value = int64_t(generator());
+      got = table.insert(key, value);
+      reference[key] = value;
+    } else if (operation < 7) {
+      name = "erase";
+      got = table.erase(key);
+      reference.erase(key);
+    } else {
+      got = table.find(key);
+    }
+    if (got != expected or table.size() != reference.size()) {
+      std::cerr << "seed " << seed << ", operation " << i << ": " << name << " " << key
+        << " diverges from reference" << std::endl;
+      return false;
+    }
+  }
+  //every remaining entry must still be reachable
+  for (const auto& [key, value]: reference) {
+    if (table.find(key) != value) {
+      std::cerr << "seed " << seed << ": key " << key << " lost" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename Insert, typename Find, typename Erase>
+void measure(const char* name, const std::vector<uint64_t>& keys, Insert insert, Find find, Erase erase) {
+  auto start{std::chrono::steady_clock::now()};
+  for (auto key: keys) {
+    insert(key);
+  }
+  std::chrono::duration<double, std::nano> inserted{std::chrono::steady_clock::now() - start};
+  start = std::chrono::steady_clock::now();
+  size_t nbFound = 0;
+  for (size_t i=0; i<nbLookups; i++) {
+    //half hits, half misses
+    nbFound += find(i % 2 ? keys[(i * 7919) % keys.size()] : ~uint64_t(i));
+  }
+  std::chrono::duration<double, std::nano> found{std::chrono::steady_clock::now() - start};
+  start = std::chrono::steady_clock::now();
+  for (auto key: keys) {
+    erase(key);
+  }
+  std::chrono::duration<double, std::nano> erased{std::chrono::steady_clock::now() - start};
+  std::cout << std::setw(16) << name << std::fixed << std::setprecision(1)
+    << std::setw(12) << inserted.count() / keys.size()
+    << std::setw(12) << found.count() / nbLookups
+    << std::setw(12) << erased.count() / keys.size()
+    << "  (" << nbFound << " found)" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const size_t nbOperations = argc > 1 ? std::stoul(argv[1]) : 200000;
+  for (uint64_t keyRange: {16ul, 100ul, 1000ul, 100000ul}) {
+    for (uint32_t seed=1; seed<=8; seed++) {
+      if (not check(seed, nbOperations, keyRange)) {
+        return 1;
+      }
+    }
+  }
+  std::cout << "random operations checked against std::unordered_map" << std::endl;
+
+  std::mt19937_64 generator(42);
+  std::vector<uint64_t> keys(nbEntries);
+  for (auto& key: keys) {
+    key = generator() >> 1;
+  }
+  std::cout << std::setw(16) << "ns/op" << std::setw(12) << "insert"
+    << std::setw(12) << "find" << std::setw(12) << "erase" << std::endl;
+  {
+    PolluxHashTable table;
+    measure("PolluxHashTable", keys,
+      [&](uint64_t key) { table.insert(key, int64_t(key)); },
+      [&](uint64_t key) { return table.find(key).has_value(); },
+      [&](uint64_t key) { table.erase(key); });
+  }
+  {
+    std::unordered_map<uint64_t, int64_t> map;
+    measure("unordered_map", keys,
+      [&](uint64_t key) { map[key] = int64_t(key); },
+      [&](uint64_t key) { return map.find(key) != map.end(); },
+      [&](uint64_t key) { map.erase(key); });
+  }
+  return 0;
+}
@@ -0,0 +1,170 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Zebulon calls per iteration of co-located payloads, talking directly to
+//zebulon or through a PolluxNodeAggregator. A local server plays zebulon:
+//it releases an iteration once every payload arrived and counts calls.
+//Each payload sends messages to a remote payload and contributes to
+//a reduction every iteration. Aggregated payloads run with and without
+//the nodeBarrier capability (every payload then reports alone).
+
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxNodeAggregator.h"
+
+namespace {
+
+const int zebulonPort = 50997;
+const size_t nbNodePayloads = 8;
+const uint32_t nbIterations = 100;
+const size_t nbMessagesPerIteration = 16;
+//not on the node: messages and reductions go through zebulon
+const int remoteID = 1000;
+
+class ZebulonReceiver final: public pollux::ZebulonPayload::Service {
+  public:
+    grpc::Status PayloadLoopReadyForNextIteration(
+      grpc::ServerContext* context,
+      const pollux::PayloadLoopMessage* message,
+      pollux::PolluxStandardResponse* response) override {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++nbCalls_;
+      uint32_t iteration = message->iteration();
+      arrived_ += std::max(message->partids_size(), 1);
+      if (arrived_ == nbNodePayloads) {
+        arrived_ = 0;
+        released_ = iteration + 1;
+        release_.notify_all();
+      } else {
+        release_.wait(lock, [&]() { return released_ > iteration; });
+      }
+      response->set_iteration(released_);
+      return grpc::Status::OK;
+    }
+    grpc::Status Transmit(
+      grpc::ServerContext* context,
+      const pollux::PolluxMessage* message,
+      pollux::PolluxMessageResponse* response) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++nbCalls_;
+      ++nbMessages_;
+      return grpc::Status::OK;
+    }
+    grpc::Status TransmitBatch(
+      grpc::ServerContext* context,
+      const pollux::PolluxMessageBatch* batch,
+      pollux::PolluxMessageResponse* response) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++nbCalls_;
+      nbMessages_ += batch->messages_size();
+      return grpc::Status::OK;
+    }
+    //calls and messages since last reset
+    std::pair<size_t, size_t> reset() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::pair<size_t, size_t> counters(nbCalls_, nbMessages_);
+      nbCalls_ = 0;
+      nbMessages_ = 0;
+      released_ = 0;
+      return counters;
+    }
+  private:
+    std::mutex              mutex_;
+    std::condition_variable release_;
+    size_t                  arrived_    {0};
+    uint32_t                released_   {0};
+    size_t                  nbCalls_    {0};
+    size_t                  nbMessages_ {0};
+};
+
+void run(ZebulonReceiver& receiver, bool aggregated, bool nodeBarrier) {
+  std::vector<int> partIDs;
+  for (int id=0; id<int(nbNodePayloads); id++) {
+    partIDs.push_back(id);
+  }
+  partIDs.push_back(remoteID);
+  std::vector<std::unique_ptr<ZebulonPayloadClient>> clients;
+  std::vector<std::unique_ptr<PolluxNodeAggregator>> aggregators;
+  for (int id=0; id<int(nbNodePayloads); id++) {
+    clients.push_back(std::make_unique<ZebulonPayloadClient>(
+      grpc::CreateChannel("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureChannelCredentials()), id));
+    auto capabilities = clients.back()->getAdvertisedCapabilities();
+    capabilities.set_nodebarrier(nodeBarrier);
+    clients.back()->setCapabilities(capabilities);
+    if (aggregated) {
+      aggregators.push_back(std::make_unique<PolluxNodeAggregator>(
+        "node-bench", nbNodePayloads, id, partIDs, clients.back().get(),
+        [](const pollux::PolluxMessage*) {}));
+    }
+  }
+
+  const auto start{std::chrono::steady_clock::now()};
+  std::vector<std::thread> threads;
+  for (int id=0; id<int(nbNodePayloads); id++) {
+    threads.emplace_back([&, id]() {
+      auto client = clients[id].get();
+      auto aggregator = aggregated ? aggregators[id].get() : nullptr;
+      const ZebulonPayloadClient::Destinations remote({remoteID});
+      const ZebulonPayloadClient::DoubleArray contribution(16, double(id));
+      for (uint32_t iteration = 0; iteration < nbIterations; iteration++) {
+        for (size_t i=0; i<nbMessagesPerIteration; i++) {
+          pollux::PolluxMessage message;
+          message.set_key("bench");
+          message.set_int64value(i);
+          if (aggregator) {
+            aggregator->transmit(remote, message);
+          } else {
+            client->transmit(remote, message);
+          }
+        }
+        if (aggregator) {
+          aggregator->reduce(remote, "sum", contribution, PolluxNodeAggregator::Sum);
+          aggregator->sendPayloadLoopReadyForNextIteration(iteration);
+        } else {
+          client->transmit(remoteID, "sum", contribution);
+          client->sendPayloadLoopReadyForNextIteration(iteration);
+        }
+      }
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  const std::chrono::duration<double> elapsed_seconds{std::chrono::steady_clock::now() - start};
+  //first constructed is the leader, it goes last
+  while (not aggregators.empty()) {
+    aggregators.pop_back();
+  }
+  auto [nbCalls, nbMessages] = receiver.reset();
+  std::cout << std::setw(12) << (not aggregated ? "direct" : nodeBarrier ? "aggregated" : "report alone")
+    << std::setw(12) << std::fixed << std::setprecision(3) << elapsed_seconds.count()*1000/nbIterations
+    << std::setw(14) << std::setprecision(1) << double(nbCalls)/nbIterations
+    << std::setw(14) << double(nbMessages)/nbIterations << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  ZebulonReceiver receiver;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureServerCredentials());
+  builder.RegisterService(&receiver);
+  auto server = builder.BuildAndStart();
+
+  std::cout << nbNodePayloads << " payloads on one node, " << nbIterations << " iterations, "
+    << nbMessagesPerIteration << " remote messages and 1 reduction per payload and iteration" << std::endl;
+  std::cout << std::setw(12) << "mode" << std::setw(12) << "ms/iter"
+    << std::setw(14) << "calls/iter" << std::setw(14) << "msgs/iter" << std::endl;
+  run(receiver, false, true);
+  run(receiver, true, true);
+  run(receiver, true, false);
+  server->Shutdown();
+  return 0;
+}
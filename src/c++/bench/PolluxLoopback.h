@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_LOOPBACK_H_
+#define __POLLUX_LOOPBACK_H_
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+#include "ZebulonPayloadClient.h"
+
+//In process network used by benchmarks: payload library modules are plugged
+//on it through ZebulonPayloadClient::MessageSender instead of a real zebulon.
+//Payload IDs are 0..nbPayloads-1.
+//In Queued mode, messages are stored and delivered by deliver() calls:
+//messages sent while delivering are delivered on the next call (one round).
+//In Immediate mode, messages are handed to the destination handler
+//directly in the sender thread.
+class PolluxLoopback {
+  public:
+    enum Mode { Queued, Immediate };
+    using Handler = std::function<void(const pollux::PolluxMessage* message)>;
+
+    PolluxLoopback(size_t nbPayloads, Mode mode=Queued):
+      mode_(mode),
+      handlers_(nbPayloads)
+    {}
+
+    size_t getNbPayloads() const { return handlers_.size(); }
+
+    //IDs of all payloads but id
+    std::vector<int> getOtherIDs(int id) const {
+      std::vector<int> ids;
+      for (int i=0; i<int(handlers_.size()); i++) {
+        if (i != id) {
+          ids.push_back(i);
+        }
+      }
+      return ids;
+    }
+
+    void setHandler(int id, Handler handler) { handlers_[id] = handler; }
+
+    ZebulonPayloadClient::MessageSender getMessageSender(int origin) {
+      return [this, origin](const ZebulonPayloadClient::Destinations& destinations, pollux::PolluxMessage& message) {
+        message.set_origin(origin);
+        auto targets = destinations.empty() ? getOtherIDs(origin) : destinations;
+        for (auto destination: targets) {
+          ++nbMessages_;
+          nbBytes_ += message.ByteSizeLong();
+          if (mode_ == Immediate) {
+            handlers_[destination](&message);
+          } else {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.emplace_back(destination, message);
+          }
+        }
+      };
+    }
+
+    //Queued mode: deliver pending messages, returns number of delivered messages
+    size_t deliver() {
+      std::deque<std::pair<int, pollux::PolluxMessage>> pending;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(queue_);
+      }
+      for (const auto& [destination, message]: pending) {
+        handlers_[destination](&message);
+      }
+      return pending.size();
+    }
+
+    size_t getNbMessages() const { return nbMessages_; }
+    size_t getNbBytes() const { return nbBytes_; }
+    void resetCounters() { nbMessages_ = 0; nbBytes_ = 0; }
+
+  private:
+    Mode                                              mode_;
+    std::vector<Handler>                              handlers_;
+    std::mutex                                        mutex_;
+    std::deque<std::pair<int, pollux::PolluxMessage>> queue_      {};
+    std::atomic<size_t>                               nbMessages_ {0};
+    std::atomic<size_t>                               nbBytes_    {0};
+};
+
+#endif /* __POLLUX_LOOPBACK_H_ */
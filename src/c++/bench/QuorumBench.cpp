@@ -0,0 +1,84 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Iteration time of synchronized mode with a quorum barrier, PolluxQuorumBarrier
+//being the local zebulon stand-in, with random stragglers.
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "PolluxQuorumBarrier.h"
+
+namespace {
+
+const size_t nbPayloads = 64;
+const uint32_t nbIterations = 100;
+const double stragglerProbability = 0.05;
+const auto iterationTime = std::chrono::microseconds(1000);
+const auto stragglerTime = std::chrono::microseconds(10000);
+
+struct Result {
+  double  seconds         {0};
+  size_t  nbLoops         {0};
+  size_t  nbLateArrivals  {0};
+  size_t  nbTimeouts      {0};
+};
+
+Result run(double fraction, std::chrono::milliseconds timeout) {
+  std::vector<int> partIDs;
+  for (int id=0; id<int(nbPayloads); id++) {
+    partIDs.push_back(id);
+  }
+  PolluxQuorumBarrier barrier(partIDs, fraction, timeout);
+  std::atomic<size_t> nbLoops {0};
+
+  const auto start{std::chrono::steady_clock::now()};
+  std::vector<std::thread> threads;
+  for (int id=0; id<int(nbPayloads); id++) {
+    threads.emplace_back([&, id]() {
+      std::mt19937 generator(id);
+      std::uniform_real_distribution<double> distribution(0, 1);
+      uint32_t iteration = 0;
+      while (iteration < nbIterations) {
+        std::this_thread::sleep_for(distribution(generator) < stragglerProbability ? stragglerTime : iterationTime);
+        ++nbLoops;
+        //a late payload directly jumps to the current iteration
+        iteration = barrier.arriveAndWait(id, iteration);
+      }
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  const std::chrono::duration<double> elapsed_seconds{std::chrono::steady_clock::now() - start};
+  Result result;
+  result.seconds = elapsed_seconds.count();
+  result.nbLoops = nbLoops;
+  result.nbLateArrivals = barrier.getNbLateArrivals();
+  result.nbTimeouts = barrier.getNbTimeoutReleases();
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::cout << nbPayloads << " payloads, " << nbIterations << " iterations, "
+    << stragglerProbability*100 << "% stragglers" << std::endl;
+  std::cout << std::setw(10) << "fraction" << std::setw(10) << "timeout"
+    << std::setw(12) << "ms/iter" << std::setw(10) << "loops"
+    << std::setw(10) << "late" << std::setw(10) << "timeouts" << std::endl;
+  using namespace std::chrono_literals;
+  for (auto [fraction, timeout]: std::vector<std::pair<double, std::chrono::milliseconds>>{
+      {1.0, 0ms}, {0.99, 0ms}, {0.95, 0ms}, {0.9, 0ms}, {1.0, 3ms}}) {
+    auto result = run(fraction, timeout);
+    std::cout << std::setw(10) << std::fixed << std::setprecision(2) << fraction
+      << std::setw(8) << timeout.count() << "ms"
+      << std::setw(12) << std::setprecision(3) << result.seconds*1000/nbIterations
+      << std::setw(10) << result.nbLoops
+      << std::setw(10) << result.nbLateArrivals
+      << std::setw(10) << result.nbTimeouts << std::endl;
+  }
+  return 0;
+}
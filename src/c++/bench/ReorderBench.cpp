@@ -0,0 +1,276 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//PolluxPayload reorder buffer check: sequenced messages from several origins
+//reach one payload shuffled, duplicated or lost, some of them arriving late
+//after their gap was skipped. Origins restart with a new incarnation whose
+//sequence numbers start over while messages of the previous one still
+//arrive. Messages are received by one thread, or by several ones at once.
+//From each origin, deliveries must never go back to a previous incarnation,
+//must be in increasing sequence order within one, and every sequence number
+//given up below the last delivered one must have been reported to skip
+//observers. With one receiving thread, every message of the last
+//incarnation that was not lost must be delivered.
+//usage: pollux-bench-reorder [messages per incarnation (default 2000)]
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+
+namespace {
+
+const int localID = 0;
+const int nbOrigins = 4;
+const size_t nbIncarnations = 3;
+const size_t maxPending = 16;
+//shuffle distance, below maxPending: in order messages are never skipped
+const size_t maxDisplacement = 3;
+const uint32_t nbSeeds = 5;
+
+struct Sent {
+  int       origin      {0};
+  size_t    incarnation {0};
+  uint64_t  sequence    {0};
+};
+
+struct Delivered {
+  size_t    incarnation {0};
+  uint64_t  sequence    {0};
+};
+
+//records deliveries, incarnation values are mapped back to their index
+class Receiver final: public PolluxPayload {
+  public:
+    Receiver(): PolluxPayload("reorder") {
+      setLocalID(localID);
+    }
+    void setIncarnations(std::map<uint64_t, size_t> incarnations) { incarnations_ = std::move(incarnations); }
+    void transmit(const pollux::PolluxMessage* message) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      delivered_[message->origin()].push_back(
+        Delivered{incarnations_.at(message->incarnation()), message->sequences(0)});
+    }
+    std::map<int, std::vector<Delivered>> getDelivered() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return delivered_;
+    }
+  private:
+    std::map<uint64_t, size_t>            incarnations_ {};
+    std::mutex                            mutex_;
+    std::map<int, std::vector<Delivered>> delivered_    {};
+};
+
+struct Schedule {
+  std::vector<pollux::PolluxMessage>  messages      {};
+  //incarnation value to index
+  std::map<uint64_t, size_t>          incarnations  {};
+  //last incarnation sequence numbers that must be delivered, per origin
+  std::map<int, std::set<uint64_t>>   expected      {};
+};
+
+//per origin: incarnations one after the other, messages shuffled by up to
+//maxDisplacement, 2% lost, 1% duplicated, 1% arriving after the incarnation
+//(skipped by then in the last one) and 1% of the previous incarnation
+//arriving during the next one. The last incarnation ends with more than
+//maxPending messages in order so that its last gap is skipped.
+Schedule makeSchedule(std::mt19937_64& generator, size_t nbMessages) {
+  Schedule schedule;
+  std::uniform_int_distribution<int> fates(0, 99);
+  std::vector<std::vector<Sent>> streams(nbOrigins);
+  for (int origin=1; origin<=nbOrigins; origin++) {
+    auto& stream = streams[origin-1];
+    std::vector<Sent> stragglers;
+    for (size_t incarnation=0; incarnation<nbIncarnations; incarnation++) {
+      bool last = incarnation == nbIncarnations - 1;
+      std::vector<Sent> sent;
+      std::vector<Sent> late;
+      std::vector<Sent> nextStragglers;
+      size_t nbSent = nbMessages + (last ? 2*maxPending : 0);
+      for (uint64_t sequence=1; sequence<=nbSent; sequence++) {
+        Sent message{origin, incarnation, sequence};
+        int fate = (last and sequence > nbMessages) ? 99 : fates(generator);
+        if (fate < 2) {
+          continue;
+        }
+        if (fate < 3) {
+          late.push_back(message);
+          continue;
+        }
+        if (fate < 4 and not last) {
+          nextStragglers.push_back(message);
+          continue;
+        }
+        if (fate < 5) {
+          sent.push_back(message);
+        }
+        sent.push_back(message);
+        if (last) {
+          schedule.expected[origin].insert(sequence);
+        }
+      }
+      //sorted on position plus a random delay: nothing moves further
+      std::vector<std::pair<size_t, size_t>> delays;
+      for (size_t i=0; i<sent.size(); i++) {
+        delays.emplace_back(i + generator() % (maxDisplacement + 1), i);
+      }
+      std::sort(delays.begin(), delays.end());
+      std::vector<Sent> shuffled;
+      for (const auto& [delay, i]: delays) {
+        shuffled.push_back(sent[i]);
+      }
+      sent = std::move(shuffled);
+      //stragglers of the previous incarnation come after the first message
+      //of this one
+      if (not sent.empty()) {
+        stream.push_back(sent.front());
+        stream.insert(stream.end(), stragglers.begin(), stragglers.end());
+        stream.insert(stream.end(), sent.begin() + 1, sent.end());
+      }
+      stream.insert(stream.end(), late.begin(), late.end());
+      stragglers = std::move(nextStragglers);
+    }
+  }
+  std::vector<std::vector<uint64_t>> values(nbOrigins);
+  for (auto& originValues: values) {
+    for (size_t incarnation=0; incarnation<nbIncarnations; incarnation++) {
+      uint64_t value = generator() | 1;
+      originValues.push_back(value);
+      schedule.incarnations[value] = incarnation;
+    }
+  }
+  //origins interleaved, each stream kept in its order
+  std::vector<size_t> positions(nbOrigins, 0);
+  size_t nbLeft = 0;
+  for (const auto& stream: streams) {
+    nbLeft += stream.size();
+  }
+  for (; nbLeft>0; nbLeft--) {
+    size_t index = generator() % nbLeft;
+    int origin = 0;
+    while (index >= streams[origin].size() - positions[origin]) {
+      index -= streams[origin].size() - positions[origin];
+      origin++;
+    }
+    const auto& sent = streams[origin][positions[origin]++];
+    pollux::PolluxMessage message;
+    message.set_key("bench");
+    message.set_origin(sent.origin);
+    message.set_incarnation(values[origin][sent.incarnation]);
+    message.add_destinations(localID);
+    message.add_sequences(sent.sequence);
+    schedule.messages.push_back(std::move(message));
+  }
+  return schedule;
+}
+
+struct Result {
+  size_t  nbMessages  {0};
+  size_t  nbDelivered {0};
+  size_t  nbSkipped   {0};
+  size_t  nbReordered {0};
+  bool    correct     {true};
+};
+
+Result run(uint32_t seed, size_t nbMessages, size_t nbThreads) {
+  std::mt19937_64 generator(seed);
+  auto schedule = makeSchedule(generator, nbMessages);
+  Receiver receiver;
+  receiver.setIncarnations(schedule.incarnations);
+  //no timeout: skips only depend on what arrived
+  receiver.setReorderLimits(maxPending, std::chrono::milliseconds(0));
+  std::mutex skippedMutex;
+  std::map<int, size_t> skipped;
+  PolluxPayload::Registrations registrations;
+  registrations.addSkipObserver(receiver, [&skippedMutex, &skipped](int origin, size_t nbSkipped) {
+    std::lock_guard<std::mutex> lock(skippedMutex);
+    skipped[origin] += nbSkipped;
+  });
+
+  std::atomic<size_t> next {0};
+  std::vector<std::thread> threads;
+  for (size_t i=0; i<nbThreads; i++) {
+    threads.emplace_back([&]() {
+      for (size_t index=next++; index<schedule.messages.size(); index=next++) {
+        receiver.receive(&schedule.messages[index]);
+      }
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  registrations.clear();
+
+  Result result;
+  result.nbMessages = schedule.messages.size();
+  result.nbSkipped = receiver.getNbSkipped();
+  result.nbReordered = receiver.getNbReordered();
+  auto delivered = receiver.getDelivered();
+  for (int origin=1; origin<=nbOrigins; origin++) {
+    const auto& deliveries = delivered[origin];
+    result.nbDelivered += deliveries.size();
+    //sequence numbers given up: below the last delivered one, not delivered
+    size_t nbGivenUp = 0;
+    std::set<uint64_t> last;
+    for (size_t i=0; i<deliveries.size(); i++) {
+      const auto& delivery = deliveries[i];
+      bool first = i == 0 or delivery.incarnation != deliveries[i-1].incarnation;
+      if (not first and delivery.sequence <= deliveries[i-1].sequence) {
+        std::cerr << "seed " << seed << ": " << delivery.sequence << " from " << origin
+          << " delivered after " << deliveries[i-1].sequence << std::endl;
+        result.correct = false;
+      }
+      if (i > 0 and delivery.incarnation < deliveries[i-1].incarnation) {
+        std::cerr << "seed " << seed << ": " << origin << " incarnation " << delivery.incarnation
+          << " delivered after incarnation " << deliveries[i-1].incarnation << std::endl;
+        result.correct = false;
+      }
+      uint64_t previous = first ? 0 : deliveries[i-1].sequence;
+      if (delivery.sequence > previous) {
+        nbGivenUp += delivery.sequence - previous - 1;
+      }
+      if (delivery.incarnation == nbIncarnations - 1) {
+        last.insert(delivery.sequence);
+      }
+    }
+    if (skipped[origin] != nbGivenUp) {
+      std::cerr << "seed " << seed << ": " << skipped[origin] << " skips reported for " << origin
+        << ", " << nbGivenUp << " sequence numbers given up" << std::endl;
+      result.correct = false;
+    }
+    if (nbThreads == 1 and last != schedule.expected[origin]) {
+      std::cerr << "seed " << seed << ": " << last.size() << " messages of the last incarnation of " << origin
+        << " delivered, " << schedule.expected[origin].size() << " expected" << std::endl;
+      result.correct = false;
+    }
+  }
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::err);
+  const size_t nbMessages = argc > 1 ? std::stoul(argv[1]) : 2000;
+
+  std::cout << std::setw(8) << "threads" << std::setw(8) << "seed" << std::setw(10) << "received"
+    << std::setw(11) << "delivered" << std::setw(9) << "skipped" << std::setw(11) << "reordered"
+    << std::setw(9) << "correct" << std::endl;
+  bool correct = true;
+  for (size_t nbThreads: {1, 4}) {
+    for (uint32_t seed=1; seed<=nbSeeds; seed++) {
+      auto result = run(seed, nbMessages, nbThreads);
+      correct = correct and result.correct;
+      std::cout << std::setw(8) << nbThreads << std::setw(8) << seed << std::setw(10) << result.nbMessages
+        << std::setw(11) << result.nbDelivered << std::setw(9) << result.nbSkipped
+        << std::setw(11) << result.nbReordered << std::setw(9) << (result.correct ? "yes" : "no") << std::endl;
+    }
+  }
+  return correct ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//PolluxReplayLog checked against a reference model then measured.
+//Random appends (broadcasts to random destination subsets, random sizes),
+//cumulative acknowledgements and replays run on small memory limits so that
+//messages spill and the file ring wraps around. A replay must return every
+//unacknowledged message of its destination in sequence order with its
+//content, or report a loss and return only the ones still held, in order.
+//With a spill file large enough nothing may be lost.
+//Append and replay throughput is then reported.
+//usage: pollux-bench-replay [checked operations per seed (default 20000)]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include "PolluxReplayLog.h"
+
+namespace {
+
+const int nbDestinations = 8;
+const size_t nbMeasured = 200000;
+const size_t measuredSize = 1024;
+//as ZebulonPayloadClient::AckInterval
+const uint64_t ackInterval = 64;
+
+//unacknowledged contents, per destination and sequence number
+using Reference = std::map<int, std::map<uint64_t, std::string>>;
+
+//returns false on the first divergence from the reference
+bool checkReplay(PolluxReplayLog& log, const Reference& reference, int destination, bool lossless, uint32_t seed) {
+  std::vector<pollux::PolluxMessage> messages;
+  bool complete = log.replay(destination, messages);
+  const auto& expected = reference.at(destination);
+  if (lossless and not complete) {
+    std::cerr << "seed " << seed << ": loss reported to " << destination << " with a large spill file" << std::endl;
+    return false;
+  }
+  if (complete and messages.size() != expected.size()) {
+    std::cerr << "seed " << seed << ": " << messages.size() << " messages replayed to " << destination
+      << " for " << expected.size() << " unacknowledged" << std::endl;
+    return false;
+  }
+  uint64_t previous = 0;
+  for (const auto& message: messages) {
+    uint64_t sequence = message.sequences_size() == 1 ? message.sequences(0) : 0;
+    auto eit = expected.find(sequence);
+    if (message.destinations_size() != 1 or int(message.destinations(0)) != destination
+      or sequence <= previous or eit == expected.end() or eit->second != message.bytesvalue()) {
+      std::cerr << "seed " << seed << ": message " << sequence << " replayed to " << destination
+        << " unexpected, out of order or corrupted" << std::endl;
+      return false;
+    }
+    previous = sequence;
+  }
+  return true;
+}
+
+bool check(uint32_t seed, size_t nbOperations, size_t memoryLimit, size_t fileSize, bool lossless) {
+  PolluxReplayLog log(memoryLimit, fileSize);
+  Reference reference;
+  std::map<int, uint64_t> sequences;
+  std::mt19937_64 generator(seed);
+  std::uniform_int_distribution<int> operations(0, 99);
+  std::uniform_int_distribution<int> destinations(0, nbDestinations - 1);
+  std::uniform_int_distribution<size_t> sizes(1, 2000);
+  for (int destination=0; destination<nbDestinations; destination++) {
+    reference[destination];
+  }
+  for (size_t i=0; i<nbOperations; i++) {
+    int operation = operations(generator);
+    if (operation < 70) {
+      std::vector<int> targets;
+      for (int destination=0; destination<nbDestinations; destination++) {
+        if (generator() % 3 == 0) {
+          targets.push_back(destination);
+        }
+      }
+      if (targets.empty()) {
+        targets.push_back(destinations(generator));
+      }
+      pollux::PolluxMessage message;
+      message.set_key("bench");
+      std::string content(sizes(generator), '\0');
+      for (auto& c: content) {
+        c = char(generator());
+      }
+      message.set_bytesvalue(content);
+      for (auto destination: targets) {
+        uint64_t sequence = ++sequences[destination];
+        message.add_sequences(sequence);
+        reference[destination][sequence] = content;
+      }
+      log.append(targets, message);
+    } else if (operation < 95) {
+      //cumulative, somewhere between the last acknowledgement and the last sent
+      int destination = destinations(generator);
+      auto& expected = reference[destination];
+      if (expected.empty()) {
+        continue;
+      }
+      auto it = expected.begin();
+      std::advance(it, generator() % expected.size());
+      uint64_t sequence = it->first;
+      log.acknowledge(destination, sequence);
+      expected.erase(expected.begin(), expected.upper_bound(sequence));
+    } else if (not checkReplay(log, reference, destinations(generator), lossless, seed)) {
+      return false;
+    }
+  }
+  for (int destination=0; destination<nbDestinations; destination++) {
+    if (not checkReplay(log, reference, destination, lossless, seed)) {
+      return false;
+    }
+  }
+  if (lossless and log.getNbLost() != 0) {
+    std::cerr << "seed " << seed << ": " << log.getNbLost() << " records lost with a large spill file" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const size_t nbOperations = argc > 1 ? std::stoul(argv[1]) : 20000;
+  for (uint32_t seed=1; seed<=4; seed++) {
+    //spills, the ring never wraps over unacknowledged records
+    if (not check(seed, nbOperations, 64*1024, 64*1024*1024, true)) {
+      return 1;
+    }
+    //wraps around: losses are reported
+    if (not check(seed, nbOperations, 16*1024, 256*1024, false)) {
+      return 1;
+    }
+    //memory only
+    if (not check(seed, nbOperations, 1024*1024*1024, 0, true)) {
+      return 1;
+    }
+  }
+  std::cout << "random operations checked against a reference model" << std::endl;
+
+  PolluxReplayLog log(16*1024*1024, 256*1024*1024);
+  std::vector<int> destinations;
+  for (int destination=0; destination<nbDestinations; destination++) {
+    destinations.push_back(destination);
+  }
+  pollux::PolluxMessage message;
+  message.set_key("bench");
+  message.set_bytesvalue(std::string(measuredSize, 'x'));
+  auto start{std::chrono::steady_clock::now()};
+  for (uint64_t sequence=1; sequence<=nbMeasured; sequence++) {
+    auto data = std::make_shared<const std::string>(message.SerializeAsString());
+    std::vector<uint64_t> sequences(destinations.size(), sequence);
+    log.append(destinations, sequences, std::move(data));
+    //half of the destinations keep up
+    if (sequence % ackInterval == 0) {
+      for (int destination=0; destination<nbDestinations/2; destination++) {
+        log.acknowledge(destination, sequence);
+      }
+    }
+  }
+  std::chrono::duration<double, std::nano> appended{std::chrono::steady_clock::now() - start};
+  start = std::chrono::steady_clock::now();
+  std::vector<pollux::PolluxMessage> messages;
+  bool complete = log.replay(nbDestinations - 1, messages);
+  std::chrono::duration<double, std::nano> replayed{std::chrono::steady_clock::now() - start};
+  std::cout << std::fixed << std::setprecision(1)
+    << "append   " << std::setw(10) << appended.count() / nbMeasured << " ns/message ("
+    << nbDestinations << " destinations, " << measuredSize << " bytes, " << log.getNbSpilled() << " spilled)" << std::endl
+    << "replay   " << std::setw(10) << replayed.count() / std::max(messages.size(), size_t(1)) << " ns/message ("
+    << messages.size() << " replayed" << (complete ? "" : ", some lost") << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Stale synchronous parallel throughput as a function of the staleness bound
+//with random stragglers (noisy spot instances).
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxStaleSynchronous.h"
+#include "PolluxLoopback.h"
+
+namespace {
+
+const size_t nbPayloads = 16;
+const size_t nbIterations = 200;
+const double stragglerProbability = 0.05;
+const auto iterationTime = std::chrono::microseconds(1000);
+const auto stragglerTime = std::chrono::microseconds(10000);
+
+struct Result {
+  double  seconds     {0};
+  size_t  nbBlocked   {0};
+  size_t  nbMessages  {0};
+};
+
+//staleness: FinishedClock means free running
+Result run(uint32_t staleness) {
+  PolluxLoopback loopback(nbPayloads, PolluxLoopback::Immediate);
+  std::vector<std::unique_ptr<PolluxStaleSynchronous>> nodes;
+  for (int id=0; id<int(nbPayloads); id++) {
+    nodes.push_back(std::make_unique<PolluxStaleSynchronous>(id, loopback.getOtherIDs(id), staleness, loopback.getMessageSender(id)));
+  }
+  for (int id=0; id<int(nbPayloads); id++) {
+    auto node = nodes[id].get();
+    loopback.setHandler(id, [node](const pollux::PolluxMessage* message) {
+      node->observe(message);
+      if (message->key() == PolluxStaleSynchronous::ClockKey or message->key() == PolluxStaleSynchronous::WaitKey) {
+        node->receive(message);
+      }
+    });
+  }
+
+  const auto start{std::chrono::steady_clock::now()};
+  std::vector<std::thread> threads;
+  for (int id=0; id<int(nbPayloads); id++) {
+    threads.emplace_back([&, id]() {
+      auto node = nodes[id].get();
+      auto sender = loopback.getMessageSender(id);
+      std::mt19937 generator(id);
+      std::uniform_real_distribution<double> distribution(0, 1);
+      std::uniform_int_distribution<int> peers(0, nbPayloads-2);
+      for (size_t iteration=0; iteration<nbIterations; iteration++) {
+        std::this_thread::sleep_for(distribution(generator) < stragglerProbability ? stragglerTime : iterationTime);
+        //application message to a random peer, carrying the clock
+        int peer = peers(generator);
+        ZebulonPayloadClient::Destinations destinations({peer >= id ? peer+1 : peer});
+        pollux::PolluxMessage message;
+        message.set_key("data");
+        message.set_int64value(iteration);
+        node->stamp(destinations, message);
+        sender(destinations, message);
+        if (staleness != PolluxStaleSynchronous::FinishedClock) {
+          node->advance();
+        }
+      }
+      node->finish();
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  const std::chrono::duration<double> elapsed_seconds{std::chrono::steady_clock::now() - start};
+  Result result;
+  result.seconds = elapsed_seconds.count();
+  for (auto& node: nodes) {
+    result.nbBlocked += node->getNbBlocked();
+  }
+  result.nbMessages = loopback.getNbMessages();
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  std::cout << nbPayloads << " payloads, " << nbIterations << " iterations, "
+    << stragglerProbability*100 << "% stragglers" << std::endl;
+  std::cout << std::setw(10) << "staleness" << std::setw(12) << "seconds"
+    << std::setw(14) << "iter/s" << std::setw(12) << "blocked"
+    << std::setw(12) << "messages" << std::endl;
+  for (uint32_t staleness: {0u, 1u, 2u, 4u, 8u, 16u, PolluxStaleSynchronous::FinishedClock}) {
+    auto result = run(staleness);
+    std::cout << std::setw(10) << (staleness == PolluxStaleSynchronous::FinishedClock ? "free" : std::to_string(staleness))
+      << std::setw(12) << std::fixed << std::setprecision(3) << result.seconds
+      << std::setw(14) << std::setprecision(0) << nbPayloads*nbIterations/result.seconds
+      << std::setw(12) << result.nbBlocked
+      << std::setw(12) << result.nbMessages << std::endl;
+  }
+  return 0;
+}
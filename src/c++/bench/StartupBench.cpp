@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Cold start latency of payload processes: time from fork to the
+//PayloadReady call, per transport profile. A local server plays zebulon and
+//terminates each payload once ready. The bench runs itself as the payload,
+//payload log files are written in the current directory.
+//usage: pollux-bench-startup [runs per profile (default 20)]
+
+#include <algorithm>
+#include <condition_variable>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxMethods.h"
+#include "PolluxPayload.h"
+
+namespace {
+
+const int zebulonPort = 50998;
+
+class ZebulonReceiver final: public pollux::ZebulonPayload::Service {
+  public:
+    grpc::Status PayloadReady(
+      grpc::ServerContext* context,
+      const pollux::PayloadReadyMessage* message,
+      pollux::PolluxStandardResponse* response) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        port_ = message->port();
+      }
+      ready_.notify_all();
+      return grpc::Status::OK;
+    }
+    grpc::Status PolluxReport(
+      grpc::ServerContext* context,
+      const pollux::PolluxReportMessage* message,
+      pollux::PolluxStandardResponse* response) override {
+      auto rit = message->map().find("startup_timeline");
+      if (rit != message->map().end()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timeline_ = rit->second;
+      }
+      return grpc::Status::OK;
+    }
+    //port of the ready payload, 0 after timeout
+    uint32_t waitReady(std::chrono::seconds timeout) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait_for(lock, timeout, [this]() { return port_ != 0; });
+      uint32_t port = port_;
+      port_ = 0;
+      return port;
+    }
+    std::string getTimeline() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return timeline_;
+    }
+  private:
+    std::mutex              mutex_;
+    std::condition_variable ready_;
+    uint32_t                port_     {0};
+    std::string             timeline_ {};
+};
+
+pid_t spawnPayload(int id, const std::string& profile) {
+  const std::string port(std::to_string(zebulonPort));
+  const std::string idString(std::to_string(id));
+  pid_t pid = fork();
+  if (pid == 0) {
+    execl("/proc/self/exe", "pollux-bench-startup", "payload",
+      "--port", port.c_str(), "--id", idString.c_str(), "--zebulon_ip", "127.0.0.1",
+      "--transport_profile", profile.c_str(), static_cast<char*>(nullptr));
+    _exit(127);
+  }
+  return pid;
+}
+
+void terminatePayload(uint32_t port) {
+  auto stub = pollux::PolluxPayload::NewStub(
+    grpc::CreateChannel("127.0.0.1:" + std::to_string(port), grpc::InsecureChannelCredentials()));
+  grpc::ClientContext context;
+  pollux::PayloadTerminateMessage request;
+  pollux::EmptyResponse response;
+  stub->Terminate(&context, request, &response);
+}
+
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 and std::string(argv[1]) == "payload") {
+    PolluxPayload payload("startup-bench");
+    return Pollux::Main(argc - 1, argv + 1, &payload);
+  }
+  spdlog::set_level(spdlog::level::warn);
+  const size_t nbRuns = std::max(argc > 1 ? std::stoul(argv[1]) : 20, 1ul);
+
+  ZebulonReceiver receiver;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureServerCredentials());
+  builder.RegisterService(&receiver);
+  auto server = builder.BuildAndStart();
+
+  std::cout << std::setw(10) << "profile" << std::setw(12) << "min ms"
+    << std::setw(12) << "median ms" << std::setw(12) << "p95 ms" << std::endl;
+  int id = 0;
+  for (const std::string profile: {"lazy", "lan", "wan"}) {
+    std::vector<double> latencies;
+    for (size_t run = 0; run < nbRuns; run++) {
+      const auto start{std::chrono::steady_clock::now()};
+      pid_t pid = spawnPayload(id++, profile);
+      uint32_t port = receiver.waitReady(std::chrono::seconds(30));
+      const std::chrono::duration<double, std::milli> elapsed{std::chrono::steady_clock::now() - start};
+      if (port == 0) {
+        std::cerr << "payload " << id - 1 << " not ready" << std::endl;
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return 1;
+      }
+      latencies.push_back(elapsed.count());
+      terminatePayload(port);
+      waitpid(pid, nullptr, 0);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << std::setw(10) << profile << std::fixed << std::setprecision(2)
+      << std::setw(12) << latencies.front()
+      << std::setw(12) << latencies[latencies.size() / 2]
+      << std::setw(12) << latencies[latencies.size() * 95 / 100] << std::endl;
+    std::cout << "  last timeline (ms): " << receiver.getTimeline() << std::endl;
+  }
+  server->Shutdown();
+  return 0;
+}
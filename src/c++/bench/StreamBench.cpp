@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Large message throughput through fragment streams on loopback TCP,
+//as a function of the message size and of the number of data channels.
+//A local server plays zebulon and puts messages back together.
+//usage: pollux-bench-stream [max size in MiB (default 1024)]
+
+#include <iomanip>
+#include <iostream>
+
+#include <sys/resource.h>
+
+#include "spdlog/spdlog.h"
+
+#include "ZebulonPayloadClient.h"
+
+namespace {
+
+const std::string address("127.0.0.1:50999");
+
+class StreamReceiver final: public pollux::ZebulonPayload::Service {
+  public:
+    grpc::Status TransmitStream(
+      grpc::ServerContext* context,
+      grpc::ServerReader<pollux::PolluxMessage>* reader,
+      pollux::PolluxMessageResponse* response) override {
+      pollux::PolluxMessage fragment;
+      while (reader->Read(&fragment)) {
+        pollux::PolluxMessage message;
+        if (assembler_.addFragment(fragment, message)) {
+          receivedBytes_ += message.bytesvalue().size();
+        }
+      }
+      return grpc::Status::OK;
+    }
+    size_t getReceivedBytes() const { return receivedBytes_; }
+  private:
+    //only its reassembly side is used
+    ZebulonPayloadClient  assembler_      {ZebulonPayloadClient::createLaneChannel(address), -1};
+    std::atomic<size_t>   receivedBytes_  {0};
+};
+
+//peak resident memory in MiB
+double getMaxResident() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  const size_t maxSize = (argc > 1 ? std::stoul(argv[1]) : 1024) * 1024 * 1024;
+
+  StreamReceiver receiver;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort(address, grpc::InsecureServerCredentials());
+  builder.RegisterService(&receiver);
+  auto server = builder.BuildAndStart();
+
+  std::cout << std::setw(12) << "size (MiB)" << std::setw(10) << "channels"
+    << std::setw(12) << "seconds" << std::setw(12) << "Gbit/s"
+    << std::setw(14) << "peak RSS MiB" << std::endl;
+  //protobuf messages are limited to 2 GiB
+  for (size_t size = 1024*1024; size <= maxSize and size < (size_t(2) << 30); size *= 4) {
+    pollux::PolluxMessage message;
+    message.mutable_bytesvalue()->assign(size, 'p');
+    for (size_t nbChannels: {1, 2, 4, 8}) {
+      ZebulonPayloadClient client(ZebulonPayloadClient::createLaneChannel(address), 0);
+      //as negotiated in Start: fragments, no compression
+      pollux::PolluxCapabilities capabilities;
+      capabilities.set_streaming(true);
+      client.setCapabilities(capabilities);
+      std::vector<std::shared_ptr<grpc::Channel>> channels;
+      for (size_t i = 0; i < nbChannels; i++) {
+        channels.push_back(ZebulonPayloadClient::createLaneChannel(address));
+      }
+      client.setDataChannels(channels);
+      const size_t before = receiver.getReceivedBytes();
+      const auto start{std::chrono::steady_clock::now()};
+      client.transmit(ZebulonPayloadClient::Destinations({1}), message);
+      const std::chrono::duration<double> elapsed_seconds{std::chrono::steady_clock::now() - start};
+      if (receiver.getReceivedBytes() - before != size) {
+        std::cerr << "message of " << size << " bytes not received" << std::endl;
+        return 1;
+      }
+      std::cout << std::setw(12) << size / (1024*1024) << std::setw(10) << nbChannels
+        << std::setw(12) << std::fixed << std::setprecision(3) << elapsed_seconds.count()
+        << std::setw(12) << std::setprecision(2) << size * 8 / elapsed_seconds.count() / 1e9
+        << std::setw(14) << std::setprecision(0) << getMaxResident() << std::endl;
+    }
+  }
+  server->Shutdown();
+  return 0;
+}
@@ -0,0 +1,190 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//Key subscriptions check: a ZebulonPayloadClient talks to a local server
+//playing zebulon that records the destinations of every Transmit call.
+//Random subscriptions (keys, prefixes, empty sets, older versions, restarted
+//incarnations) are recorded for the peers while broadcasts, reserved key
+//broadcasts and explicit transmits are sent. Each call must carry the
+//destinations of a reference model: interested peers for a filtered
+//broadcast (no call when none), all of them (empty destinations) for a
+//reserved key or before any subscription, explicit destinations untouched.
+//usage: pollux-bench-subscriptions [operations per seed (default 5000)]
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
+
+#include "spdlog/spdlog.h"
+
+#include "ZebulonPayloadClient.h"
+
+namespace {
+
+const int zebulonPort = 50996;
+const int nbPeers = 7;
+const uint32_t nbSeeds = 4;
+const std::vector<std::string> keys({"a", "b", "c", "ab", "abc", "ba", "_pollux_bench"});
+const std::vector<std::string> subscribedKeys({"a", "b", "c", "ab", "a*", "ab*", "b*"});
+
+class ZebulonReceiver final: public pollux::ZebulonPayload::Service {
+  public:
+    grpc::Status Transmit(
+      grpc::ServerContext* context,
+      const pollux::PolluxMessage* message,
+      pollux::PolluxMessageResponse* response) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      calls_.emplace_back(message->key(),
+        ZebulonPayloadClient::Destinations(message->destinations().begin(), message->destinations().end()));
+      return grpc::Status::OK;
+    }
+    //calls since the last take
+    std::vector<std::pair<std::string, ZebulonPayloadClient::Destinations>> take() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return std::move(calls_);
+    }
+  private:
+    std::mutex                                                              mutex_;
+    std::vector<std::pair<std::string, ZebulonPayloadClient::Destinations>> calls_  {};
+};
+
+struct Subscriptions {
+  uint64_t              incarnation {0};
+  uint64_t              version     {0};
+  std::set<std::string> keys        {};
+};
+
+//what the client must do, peers without entry never published
+class Reference {
+  public:
+    void set(int id, const pollux::PolluxSubscriptions& subscriptions) {
+      auto& recorded = subscriptions_[id];
+      if (recorded and subscriptions.incarnation() == recorded->incarnation
+        and subscriptions.version() < recorded->version) {
+        return;
+      }
+      recorded = Subscriptions{subscriptions.incarnation(), subscriptions.version(),
+        {subscriptions.keys().begin(), subscriptions.keys().end()}};
+    }
+    //no value: transmit skipped
+    std::optional<ZebulonPayloadClient::Destinations> getDestinations(
+      const std::string& key,
+      const ZebulonPayloadClient::Destinations& destinations) const {
+      if (not destinations.empty() or key.starts_with("_pollux_") or subscriptions_.empty()) {
+        return destinations;
+      }
+      ZebulonPayloadClient::Destinations subscribers;
+      for (int id=1; id<=nbPeers; id++) {
+        auto sit = subscriptions_.find(id);
+        if (sit == subscriptions_.end() or isInterested(*sit->second, key)) {
+          subscribers.push_back(id);
+        }
+      }
+      if (subscribers.empty()) {
+        return std::nullopt;
+      }
+      return subscribers;
+    }
+  private:
+    static bool isInterested(const Subscriptions& subscriptions, const std::string& key) {
+      if (subscriptions.keys.empty() or subscriptions.keys.count(key)) {
+        return true;
+      }
+      return std::any_of(subscriptions.keys.begin(), subscriptions.keys.end(), [&key](const std::string& subscribed) {
+        return subscribed.ends_with('*') and key.starts_with(subscribed.substr(0, subscribed.size()-1));
+      });
+    }
+    std::map<int, std::optional<Subscriptions>> subscriptions_ {};
+};
+
+bool check(ZebulonReceiver& receiver, uint32_t seed, size_t nbOperations) {
+  ZebulonPayloadClient client(
+    grpc::CreateChannel("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureChannelCredentials()), 0);
+  //sequenced broadcasts are expanded to all peers: not what is checked here
+  client.setOrdered(false);
+  ZebulonPayloadClient::Destinations peers;
+  for (int id=1; id<=nbPeers; id++) {
+    peers.push_back(id);
+  }
+  client.setPeers(peers);
+  Reference reference;
+  std::mt19937_64 generator(seed);
+  std::uniform_int_distribution<int> operations(0, 99);
+  std::uniform_int_distribution<int> ids(1, nbPeers);
+  std::uniform_int_distribution<size_t> keyIndices(0, keys.size()-1);
+  std::uniform_int_distribution<size_t> subscribedIndices(0, subscribedKeys.size()-1);
+  std::uniform_int_distribution<uint64_t> incarnations(1, 3);
+  std::uniform_int_distribution<uint64_t> versions(1, 20);
+  for (size_t i=0; i<nbOperations; i++) {
+    int operation = operations(generator);
+    if (operation < 30) {
+      pollux::PolluxSubscriptions subscriptions;
+      subscriptions.set_incarnation(incarnations(generator));
+      subscriptions.set_version(versions(generator));
+      for (size_t nbKeys=generator()%4; nbKeys>0; nbKeys--) {
+        subscriptions.add_keys(subscribedKeys[subscribedIndices(generator)]);
+      }
+      int id = ids(generator);
+      client.setSubscriptions(id, subscriptions);
+      reference.set(id, subscriptions);
+      continue;
+    }
+    std::string key = keys[keyIndices(generator)];
+    ZebulonPayloadClient::Destinations destinations;
+    if (operation >= 90) {
+      destinations.push_back(ids(generator));
+    }
+    client.transmit(destinations, key, "bench");
+    auto expected = reference.getDestinations(key, destinations);
+    auto calls = receiver.take();
+    if (not expected) {
+      if (not calls.empty()) {
+        std::cerr << "seed " << seed << ": broadcast of " << key << " sent while nobody subscribed" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (calls.size() != 1 or calls[0].first != key or calls[0].second != *expected) {
+      std::cerr << "seed " << seed << ": transmit of " << key << " sent " << calls.size() << " calls, to:";
+      for (const auto& [callKey, callDestinations]: calls) {
+        for (auto destination: callDestinations) {
+          std::cerr << " " << destination;
+        }
+        std::cerr << ";";
+      }
+      std::cerr << " expected:";
+      for (auto destination: *expected) {
+        std::cerr << " " << destination;
+      }
+      std::cerr << std::endl;
+      return false;
+    }
+  }
+  std::cout << "seed " << seed << ": " << client.getNbFilteredDeliveries() << " deliveries filtered" << std::endl;
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  const size_t nbOperations = argc > 1 ? std::stoul(argv[1]) : 5000;
+  ZebulonReceiver receiver;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:" + std::to_string(zebulonPort), grpc::InsecureServerCredentials());
+  builder.RegisterService(&receiver);
+  auto server = builder.BuildAndStart();
+
+  bool correct = true;
+  for (uint32_t seed=1; seed<=nbSeeds and correct; seed++) {
+    correct = check(receiver, seed, nbOperations);
+  }
+  server->Shutdown();
+  if (correct) {
+    std::cout << "broadcast expansion checked against a reference model" << std::endl;
+  }
+  return correct ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+//PolluxTaskPool termination check: an irregular random task tree is
+//explored by payloads running on their own threads, messages being
+//delivered by another one. Only payload 0 gets the root task, the others
+//start idle and steal. Once every run() returned (Dijkstra-Safra
+//termination), exactly the tree tasks must have been executed: an early
+//termination leaves tasks unexecuted. Run time and steals are reported.
+//usage: pollux-bench-taskpool [tree depth (default 14)]
+
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxTaskPool.h"
+#include "PolluxLoopback.h"
+
+namespace {
+
+const uint32_t nbSeeds = 5;
+const auto taskTime = std::chrono::microseconds(5);
+
+uint64_t mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+//task: node hash and depth, 0 to 4 children
+std::vector<std::pair<uint64_t, int64_t>> getChildren(uint64_t node, int64_t depth, int64_t maxDepth) {
+  std::vector<std::pair<uint64_t, int64_t>> children;
+  if (depth < maxDepth) {
+    for (uint64_t i=0; i<mix(node) % 5; i++) {
+      children.emplace_back(mix(node + i + 1), depth + 1);
+    }
+  }
+  return children;
+}
+
+size_t getTreeSize(uint64_t node, int64_t depth, int64_t maxDepth) {
+  size_t size = 1;
+  for (const auto& [child, childDepth]: getChildren(node, depth, maxDepth)) {
+    size += getTreeSize(child, childDepth, maxDepth);
+  }
+  return size;
+}
+
+pollux::PolluxMessage makeTask(uint64_t node, int64_t depth) {
+  pollux::PolluxMessage task;
+  auto values = task.mutable_int64arrayvalue();
+  values->add_values(int64_t(node));
+  values->add_values(depth);
+  return task;
+}
+
+struct Result {
+  double  seconds         {0};
+  size_t  nbExecuted      {0};
+  size_t  nbStolen        {0};
+  size_t  nbStealRequests {0};
+  bool    terminated      {false};
+};
+
+Result run(size_t nbPayloads, uint64_t root, int64_t maxDepth) {
+  PolluxLoopback loopback(nbPayloads);
+  std::vector<int> partIDs;
+  for (int id=0; id<int(nbPayloads); id++) {
+    partIDs.push_back(id);
+  }
+  std::vector<std::unique_ptr<PolluxTaskPool>> pools;
+  for (int id=0; id<int(nbPayloads); id++) {
+    pools.push_back(std::make_unique<PolluxTaskPool>("bench", id, partIDs, loopback.getMessageSender(id)));
+    auto pool = pools.back().get();
+    loopback.setHandler(id, [pool](const pollux::PolluxMessage* message) { pool->receive(message); });
+  }
+  pools[0]->push(makeTask(root, 0));
+
+  std::atomic<size_t> nbRunning {nbPayloads};
+  std::thread delivery([&]() {
+    while (nbRunning > 0) {
+      if (loopback.deliver() == 0) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  const auto start{std::chrono::steady_clock::now()};
+  std::vector<std::thread> threads;
+  for (int id=0; id<int(nbPayloads); id++) {
+    threads.emplace_back([&, id]() {
+      auto pool = pools[id].get();
+      pool->run([pool, maxDepth](const pollux::PolluxMessage& task) {
+        const auto until = std::chrono::steady_clock::now() + taskTime;
+        while (std::chrono::steady_clock::now() < until);
+        const auto& values = task.int64arrayvalue().values();
+        for (const auto& [child, depth]: getChildren(uint64_t(values[0]), values[1], maxDepth)) {
+          pool->push(makeTask(child, depth));
+        }
+      });
+      --nbRunning;
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  const std::chrono::duration<double> elapsed_seconds{std::chrono::steady_clock::now() - start};
+  delivery.join();
+  //late steal requests and refusals
+  while (loopback.deliver() > 0);
+
+  Result result;
+  result.seconds = elapsed_seconds.count();
+  result.terminated = true;
+  for (const auto& pool: pools) {
+    result.nbExecuted += pool->getNbExecuted();
+    result.nbStolen += pool->getNbStolen();
+    result.nbStealRequests += pool->getNbStealRequests();
+    result.terminated = result.terminated and pool->isTerminated();
+  }
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::warn);
+  const int64_t maxDepth = argc > 1 ? std::stol(argv[1]) : 14;
+
+  std::cout << std::setw(10) << "payloads" << std::setw(10) << "tasks" << std::setw(12) << "executed"
+    << std::setw(10) << "seconds" << std::setw(10) << "stolen" << std::setw(10) << "requests" << std::endl;
+  bool correct = true;
+  for (size_t nbPayloads: {2, 4, 8, 16}) {
+    for (uint32_t seed=1; seed<=nbSeeds; seed++) {
+      uint64_t root = mix(seed);
+      size_t nbTasks = getTreeSize(root, 0, maxDepth);
+      auto result = run(nbPayloads, root, maxDepth);
+      std::cout << std::setw(10) << nbPayloads << std::setw(10) << nbTasks << std::setw(12) << result.nbExecuted
+        << std::setw(10) << std::fixed << std::setprecision(3) << result.seconds
+        << std::setw(10) << result.nbStolen << std::setw(10) << result.nbStealRequests << std::endl;
+      if (not result.terminated or result.nbExecuted != nbTasks) {
+        std::cerr << "seed " << seed << ": " << result.nbExecuted << " tasks executed for "
+          << nbTasks << (result.terminated ? "" : ", not terminated everywhere") << std::endl;
+        correct = false;
+      }
+    }
+  }
+  return correct ? 0 : 1;
+}
@@ -16,8 +16,6 @@ namespace {
 
 size_t numPixels = 1000;
 
-std::map<size_t, std::pair<double, double> > _particlesData; 
-
 class PolluxPayLoadPSO: public PolluxPayload {
   public:
     PolluxPayLoadPSO(): PolluxPayload("pollux-payload-pso") {}
@@ -125,6 +123,8 @@ class PolluxPayLoadPSO: public PolluxPayload {
         particle_->setCurrentPosition(pixels[getLocalID()*numPixels/numParticles]);
       }
       
+      globalBest_ = std::make_unique<PolluxGlobalBest>(*this, client);
+
       bestSolution_ = particle_->GetBestLocalPosition();
       for (int j = 0; j < 1; j++) {
         particle_->SetBestGlobalPosition(bestSolution_);
@@ -148,46 +148,31 @@ class PolluxPayLoadPSO: public PolluxPayload {
           particle_->getCurrentPosition().first,
           particle_->getCurrentPosition().second);
 
-      _particlesData.clear();
-
       spdlog::info("Main loop started iteration: {}", iteration_);
       spdlog::info("Particle before SA: {},{}", particle_->getCurrentPosition().first, particle_->getCurrentPosition().second);
       //particle_->runSimulatedAnealing();
       spdlog::info("Particle position after SA: {},{}", particle_->getCurrentPosition().first, particle_->getCurrentPosition().second);
-      //while (_particlesData.size() < control_.partids().size()) {
-         std::ostringstream PLOG_INFO;
-         PLOG_INFO <<  "sending " << particle_->GetBestLocalPosition().first << " " << (particle_->GetBestLocalPosition().second);
-
-         ZebulonPayloadClient::DoubleArray data {
-           particle_->GetBestLocalPosition().first,
-           particle_->GetBestLocalPosition().second
-         };
-         client->transmit("POSITION", data);
-         PLOG_INFO << "size: " << _particlesData.size();
-         spdlog::info("{}", PLOG_INFO.str());
-         //sleep(1);
-      //}
-      {
+
+      //only improvements of the global best are sent to the register owner
+      auto localBest = particle_->GetBestLocalPosition();
+      if (globalBest_->submit(func_(localBest.first, localBest.second), {localBest.first, localBest.second})) {
+        spdlog::info("submitted {} {}", localBest.first, localBest.second);
+      }
+
+      auto globalBest = globalBest_->getBest();
+      if (globalBest.isValid()
+        and globalBest.fitness < func_(bestSolution_.first, bestSolution_.second)) {
+        bestSolution_ = std::pair<double, double>(globalBest.values[0], globalBest.values[1]);
         std::ostringstream PLOG_INFO;
-        PLOG_INFO << "continue";
+        PLOG_INFO <<  "FOUND NEW BEST" <<  " " << bestSolution_.first <<  " " << bestSolution_.second << " " << 
+        globalBest.fitness;
         spdlog::info("{}", PLOG_INFO.str());
-      }
-      for (int i = 0; i < getNumberOfPayloads(); i++) {
-        auto value = func_(_particlesData[i].first, _particlesData[i].second);
-        auto best = func_(bestSolution_.first, bestSolution_.second);
-        if (value < best) {
-          bestSolution_ = _particlesData[i];
-          std::ostringstream PLOG_INFO;
-          PLOG_INFO <<  "FOUND NEW BEST" <<  " " << bestSolution_.first <<  " " << bestSolution_.second << " " << 
-          func_(bestSolution_.first, bestSolution_.second);
-          spdlog::info("{}", PLOG_INFO.str());
-          {
-            std::ostringstream log;
-            log << "Particle " << i+1 << " value: " << value << " at: " << bestSolution_.first << ":" << bestSolution_.second;
-            client->polluxLog("NEW BEST", log.str());
-          }
-          particle_->SetBestGlobalPosition(bestSolution_);
+        {
+          std::ostringstream log;
+          log << "Particle " << globalBest.origin << " value: " << globalBest.fitness << " at: " << bestSolution_.first << ":" << bestSolution_.second;
+          client->polluxLog("NEW BEST", log.str());
         }
+        particle_->SetBestGlobalPosition(bestSolution_);
       }
 
       if (iterationsNum_ == iteration_) {
@@ -197,28 +182,6 @@ class PolluxPayLoadPSO: public PolluxPayload {
       }
     }
 
-    void transmit(const pollux::PolluxMessage* message) override {
-      std::ostringstream logMessage;
-      logMessage << "Pollux Message received: "
-        << "origin=" << message->origin();
-      logMessage << ", key=" << message->key();
-      switch (message->value_case()) {
-        case pollux::PolluxMessage::kDoubleArrayValue:
-          if (message->doublearrayvalue().values_size() != 2) {
-            std::ostringstream reason;
-            reason << "malformed message: expecting two double values, got: " << message->doublearrayvalue().values_size();
-            throw PolluxPayloadException(reason.str());
-          }
-          logMessage << ", value=" << message->strvalue() << std::endl;
-          _particlesData[message->origin()].first = message->doublearrayvalue().values()[0];
-          _particlesData[message->origin()].second = message->doublearrayvalue().values()[1];
-          break;
-        default:
-          break;
-      }
-      spdlog::info("{}", logMessage.str());
-    }
-
   private:
     int   iteration_ = 0;
     size_t iterationsNum_ = 100;
@@ -228,6 +191,7 @@ class PolluxPayLoadPSO: public PolluxPayload {
     std::vector<std::pair<double, double>> solutions_;
     std::pair<double, double> bestSolution_;
     std::function<double(double, double)> func_;
+    std::unique_ptr<PolluxGlobalBest> globalBest_;
 };
 
 }
@@ -22,6 +22,10 @@ class PolluxPayloadTest: public PolluxPayload {
         maxIterations_ = std::get<UserOptionType::LONG>(*maxIterationsOption);
       }
       spdlog::info("Number of iterations: {}", maxIterations_);
+      if (not isSynchronized() and getStaleness() > 0) {
+        ssp_ = std::make_unique<PolluxStaleSynchronous>(*this, client);
+        spdlog::info("Stale synchronous parallel mode, staleness: {}", ssp_->getStaleness());
+      }
     }
 
     void loop(ZebulonPayloadClient* client) override {
@@ -73,6 +77,9 @@ class PolluxPayloadTest: public PolluxPayload {
         if (isSynchronized() and nbMessages > 4) {
           break;
         }
+        if (ssp_) {
+          ssp_->advance();
+        }
       }
       if (isSynchronized()) {
         if (iteration_ > maxIterations_) {
@@ -119,6 +126,7 @@ class PolluxPayloadTest: public PolluxPayload {
   private:
     int                     iteration_      {1};
     int                     maxIterations_  {5};
+    std::unique_ptr<PolluxStaleSynchronous> ssp_;
 };
 
 }
@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxBloomFilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+//bit positions inside a block are derived from a second mix of the hash:
+//double hashing, position i is (first + i*step) modulo BlockBits,
+//first is taken from the product upper bits that depend on every hash bit
+constexpr uint64_t BitsMixer = 0x9e3779b97f4a7c15ULL;
+
+}
+
+PolluxBloomFilter::PolluxBloomFilter(size_t nbBits, size_t nbHashes):
+  blocks_(std::max((nbBits + BlockBits - 1) / BlockBits, size_t(1))),
+  nbHashes_(std::clamp(nbHashes, size_t(1), size_t(16))) {}
+
+uint64_t PolluxBloomFilter::hash(uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
+}
+
+//the 64 bits multiplies only vectorize with AVX2 (emulated) or AVX-512DQ:
+//x86-64 builds get clones for both, picked when the library is loaded
+#if defined(__x86_64__) and defined(__GNUC__) and not defined(__clang__)
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#endif
+void PolluxBloomFilter::hashBatch(const uint64_t* __restrict keys, size_t nbKeys, uint64_t* __restrict hashes) {
+  for (size_t i = 0; i < nbKeys; i++) {
+    hashes[i] = hash(keys[i]);
+  }
+}
+
+size_t PolluxBloomFilter::getBlockIndex(uint64_t hash) const {
+  //upper 32 bits pick the block (multiply-shift range reduction),
+  //lower ones are left to choose the owner of a sharded filter
+  return ((hash >> 32) * blocks_.size()) >> 32;
+}
+
+bool PolluxBloomFilter::insert(uint64_t hash) {
+  Block& block = blocks_[getBlockIndex(hash)];
+  uint64_t bits = hash * BitsMixer;
+  uint64_t position = bits >> 55;
+  uint64_t step = (bits >> 32) | 1;
+  bool present = true;
+  for (size_t i = 0; i < nbHashes_; i++) {
+    uint64_t& word = block.words[position / 64];
+    uint64_t mask = uint64_t(1) << (position % 64);
+    present = present and (word & mask);
+    word |= mask;
+    position = (position + step) % BlockBits;
+  }
+  if (not present) {
+    ++nbInserted_;
+  }
+  return present;
+}
+
+bool PolluxBloomFilter::contains(uint64_t hash) const {
+  const Block& block = blocks_[getBlockIndex(hash)];
+  uint64_t bits = hash * BitsMixer;
+  uint64_t position = bits >> 55;
+  uint64_t step = (bits >> 32) | 1;
+  for (size_t i = 0; i < nbHashes_; i++) {
+    if (not (block.words[position / 64] & (uint64_t(1) << (position % 64)))) {
+      return false;
+    }
+    position = (position + step) % BlockBits;
+  }
+  return true;
+}
+
+size_t PolluxBloomFilter::getOptimalNbBits(size_t nbEntries, double falsePositiveRate) {
+  falsePositiveRate = std::clamp(falsePositiveRate, 1e-9, 0.5);
+  double nbBits = -double(std::max(nbEntries, size_t(1))) * std::log(falsePositiveRate) / (std::log(2) * std::log(2));
+  return size_t(std::ceil(nbBits));
+}
+
+size_t PolluxBloomFilter::getOptimalNbHashes(size_t nbBits, size_t nbEntries) {
+  double nbHashes = double(nbBits) / double(std::max(nbEntries, size_t(1))) * std::log(2);
+  return std::clamp(size_t(std::round(nbHashes)), size_t(1), size_t(16));
+}
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_BLOOM_FILTER_H_
+#define __POLLUX_BLOOM_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Blocked Bloom filter: all bits of a key live in one 64 bytes block,
+//a query or an insertion touches a single cache line.
+//Operations take the key hash (see hashBatch), so that hashing can be done
+//once by the caller and the hash sent to the filter owner.
+class PolluxBloomFilter {
+  public:
+    static constexpr size_t BlockBits = 512;
+
+    //nbBits is rounded up to a whole number of blocks
+    PolluxBloomFilter(size_t nbBits, size_t nbHashes);
+
+    //returns true if hash was probably already present
+    bool insert(uint64_t hash);
+    bool contains(uint64_t hash) const;
+
+    size_t getNbBits() const { return blocks_.size() * BlockBits; }
+    size_t getNbHashes() const { return nbHashes_; }
+    size_t getNbInserted() const { return nbInserted_; }
+
+    //hash keys in one branch free pass, vectorized on x86-64 CPUs with AVX2
+    //(GCC builds), scalar elsewhere. keys and hashes must not overlap.
+    static void hashBatch(const uint64_t* keys, size_t nbKeys, uint64_t* hashes);
+    static uint64_t hash(uint64_t key);
+
+    //optimal sizing for an expected number of entries and false positive rate
+    static size_t getOptimalNbBits(size_t nbEntries, double falsePositiveRate);
+    static size_t getOptimalNbHashes(size_t nbBits, size_t nbEntries);
+
+  private:
+    struct alignas(64) Block {
+      uint64_t words[BlockBits/64] {};
+    };
+
+    size_t getBlockIndex(uint64_t hash) const;
+
+    std::vector<Block>  blocks_     {};
+    size_t              nbHashes_   {1};
+    size_t              nbInserted_ {0};
+};
+
+#endif /* __POLLUX_BLOOM_FILTER_H_ */
@@ -0,0 +1,459 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_DISTRIBUTED_ARRAY_H_
+#define __POLLUX_DISTRIBUTED_ARRAY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+#include "ZebulonPayloadClient.h"
+
+//PGAS style array partitioned across payloads instead of being replicated
+//in each of them (distance matrix, pheromone table...).
+//Elements are distributed by blocks or cyclically over the sorted part IDs.
+//put, accumulate and get are one-sided: the owner does not take part, its
+//elements are updated by the message handler, off its compute thread.
+//Remote operations are buffered per owner and sent as one aggregated message
+//on flush(), when a buffer is full or when a get needs an answer.
+//Operations from one payload to one owner are applied in order: a get sees
+//the preceding puts of the same payload. Remote puts are visible to others
+//once flushed and a barrier (next iteration) separates them from the reads.
+//A get fails with PolluxPayloadException when an owner rejects its batch
+//(bad index...) or does not answer within timeout.
+template<typename T>
+class PolluxDistributedArray {
+  public:
+    static_assert(std::is_arithmetic_v<T> and sizeof(T) <= sizeof(int64_t),
+      "distributed array elements are arithmetic and at most 64 bits");
+
+    static constexpr const char* OperationsPrefix = "_pollux_darray_ops:";
+    static constexpr const char* ValuesPrefix = "_pollux_darray_values:";
+    static constexpr const char* ErrorPrefix = "_pollux_darray_error:";
+
+    enum Distribution { Block, Cyclic };
+
+    //transport agnostic constructor
+    //name: identifies the array, same on every payload
+    //partIDs: all payloads IDs sharing the array (local one included)
+    //maxBatchSize: buffered operations per owner triggering a send
+    //timeout: for get answers
+    PolluxDistributedArray(
+      const std::string& name,
+      size_t size,
+      int localID,
+      const std::vector<int>& partIDs,
+      Distribution distribution,
+      ZebulonPayloadClient::MessageSender sender,
+      size_t maxBatchSize = 4096,
+      std::chrono::milliseconds timeout = std::chrono::seconds(10)):
+      name_(name),
+      size_(size),
+      localID_(localID),
+      partIDs_(partIDs),
+      distribution_(distribution),
+      sender_(sender),
+      maxBatchSize_(std::max(maxBatchSize, size_t(1))),
+      timeout_(timeout) {
+      std::sort(partIDs_.begin(), partIDs_.end());
+      auto pit = std::find(partIDs_.begin(), partIDs_.end(), localID_);
+      if (pit == partIDs_.end()) {
+        throw PolluxPayloadException("distributed array " + name_ + ": local ID not in part IDs");
+      }
+      rank_ = std::distance(partIDs_.begin(), pit);
+      blockSize_ = (size_ + partIDs_.size() - 1) / partIDs_.size();
+      local_.resize(getLocalSize(rank_));
+      batches_.resize(partIDs_.size());
+      timeoutThread_ = std::thread(&PolluxDistributedArray::checkTimeouts, this);
+    }
+
+    //convenience constructor: array is shared by all payloads,
+    //message handlers are registered on payload
+    PolluxDistributedArray(
+      PolluxPayload& payload,
+      ZebulonPayloadClient* client,
+      const std::string& name,
+      size_t size,
+      Distribution distribution = Block,
+      std::chrono::milliseconds timeout = std::chrono::seconds(10)):
+      PolluxDistributedArray(name, size, payload.getLocalID(), getAllIDs(payload), distribution,
+        client->getMessageSender(), 4096, timeout) {
+      auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+      registrations_.registerMessageHandler(payload, OperationsPrefix + name_, handler);
+      registrations_.registerMessageHandler(payload, ValuesPrefix + name_, handler);
+      registrations_.registerMessageHandler(payload, ErrorPrefix + name_, handler);
+    }
+    PolluxDistributedArray(const PolluxDistributedArray&) = delete;
+    ~PolluxDistributedArray() {
+      //no answer handled while the timeout thread stops
+      registrations_.clear();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+      }
+      deadlinesChanged_.notify_all();
+      timeoutThread_.join();
+      std::lock_guard<std::mutex> lock(mutex_);
+      while (not pendingGets_.empty()) {
+        failLocked(pendingGets_.begin(), "distributed array " + name_ + " stopped");
+      }
+    }
+
+    size_t size() const { return size_; }
+    int getOwner(size_t index) const { return partIDs_[getRank(index)]; }
+    bool isLocal(size_t index) const { return getRank(index) == rank_; }
+
+    //local elements, in increasing global index order
+    size_t getLocalSize() const { return local_.size(); }
+    size_t getGlobalIndex(size_t localOffset) const {
+      if (distribution_ == Block) {
+        return rank_*blockSize_ + localOffset;
+      }
+      return localOffset*partIDs_.size() + rank_;
+    }
+    T getLocal(size_t localOffset) const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return local_[localOffset];
+    }
+    void setLocal(size_t localOffset, T value) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      local_[localOffset] = value;
+    }
+
+    void put(size_t index, T value) { apply(Put, index, value); }
+    void accumulate(size_t index, T value) { apply(Accumulate, index, value); }
+
+    //local values are read immediately, remote ones with one request per owner
+    std::future<std::vector<T>> get(const std::vector<size_t>& indices) {
+      auto request = std::make_shared<GetRequest>();
+      request->values.resize(indices.size());
+      std::vector<std::vector<size_t>> positions(partIDs_.size());
+      std::vector<pollux::PolluxMessage> messages;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t position = 0; position < indices.size(); position++) {
+          size_t index = checkIndex(indices[position]);
+          size_t rank = getRank(index);
+          if (rank == rank_) {
+            request->values[position] = local_[getLocalOffset(index)];
+          } else {
+            positions[rank].push_back(position);
+            batches_[rank].push_back(Operation{Get, index, 0});
+          }
+        }
+        auto deadline = std::chrono::steady_clock::now() + timeout_;
+        for (size_t rank = 0; rank < partIDs_.size(); rank++) {
+          if (not positions[rank].empty()) {
+            uint64_t correlationID = nextCorrelationID_++;
+            pendingGets_[correlationID] = PendingGet{request, std::move(positions[rank]), partIDs_[rank], deadline};
+            deadlines_.emplace(deadline, correlationID);
+            ++request->remaining;
+            messages.push_back(takeBatchLocked(rank, correlationID));
+          }
+        }
+      }
+      if (not messages.empty()) {
+        deadlinesChanged_.notify_all();
+      }
+      auto values = request->promise.get_future();
+      if (messages.empty()) {
+        request->promise.set_value(std::move(request->values));
+      }
+      send(messages);
+      return values;
+    }
+    std::future<T> get(size_t index) {
+      return std::async(std::launch::deferred,
+        [values = get(std::vector<size_t>({index}))]() mutable { return values.get()[0]; });
+    }
+
+    //send all buffered operations
+    void flush() {
+      std::vector<pollux::PolluxMessage> messages;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t rank = 0; rank < partIDs_.size(); rank++) {
+          if (not batches_[rank].empty()) {
+            messages.push_back(takeBatchLocked(rank, 0));
+          }
+        }
+      }
+      send(messages);
+    }
+
+    //handle operations (owner side), get answers and errors
+    void receive(const pollux::PolluxMessage* message) {
+      if (message->key().rfind(ErrorPrefix, 0) == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto pit = pendingGets_.find(message->correlationid());
+        if (pit != pendingGets_.end()) {
+          failLocked(pit, message->strvalue());
+        }
+        return;
+      }
+      if (message->value_case() != pollux::PolluxMessage::kInt64ArrayValue) {
+        throw PolluxPayloadException("malformed distributed array message from: "
+          + std::to_string(message->origin()));
+      }
+      ++nbReceivedMessages_;
+      const auto& values = message->int64arrayvalue().values();
+      if (message->key().rfind(ValuesPrefix, 0) == 0) {
+        receiveValues(message->correlationid(), values);
+        return;
+      }
+      if (values.size() % 3 != 0) {
+        throw PolluxPayloadException("malformed distributed array operations from: "
+          + std::to_string(message->origin()));
+      }
+      pollux::PolluxMessage answer;
+      auto answerValues = answer.mutable_int64arrayvalue()->mutable_values();
+      try {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < values.size(); i += 3) {
+          size_t index = checkIndex(values[i+1]);
+          if (getRank(index) != rank_) {
+            throw PolluxPayloadException("distributed array " + name_ + ": element "
+              + std::to_string(index) + " is not owned by " + std::to_string(localID_));
+          }
+          T& element = local_[getLocalOffset(index)];
+          switch (static_cast<OperationKind>(values[i])) {
+            case Put: element = decode(values[i+2]); break;
+            case Accumulate: element += decode(values[i+2]); break;
+            case Get: answerValues->Add(encode(element)); break;
+          }
+        }
+      } catch (const PolluxPayloadException& e) {
+        //the waiting get fails instead of timing out, the batch is rejected
+        if (message->correlationid() != 0) {
+          pollux::PolluxMessage error;
+          error.set_key(ErrorPrefix + name_);
+          error.set_correlationid(message->correlationid());
+          error.set_strvalue(e.getReason());
+          ++nbSentMessages_;
+          sender_(ZebulonPayloadClient::Destinations({int(message->origin())}), error);
+        }
+        throw;
+      }
+      if (message->correlationid() != 0) {
+        answer.set_key(ValuesPrefix + name_);
+        answer.set_correlationid(message->correlationid());
+        ++nbSentMessages_;
+        sender_(ZebulonPayloadClient::Destinations({int(message->origin())}), answer);
+      }
+    }
+
+    size_t getNbSentMessages() const { return nbSentMessages_; }
+    size_t getNbReceivedMessages() const { return nbReceivedMessages_; }
+
+  private:
+    enum OperationKind { Put = 0, Accumulate = 1, Get = 2 };
+    struct Operation {
+      OperationKind kind  {Put};
+      size_t        index {0};
+      int64_t       value {0};
+    };
+    struct GetRequest {
+      std::promise<std::vector<T>> promise    {};
+      std::vector<T>               values     {};
+      size_t                       remaining  {0};
+      bool                         failed     {false};
+    };
+    using Deadline = std::chrono::steady_clock::time_point;
+    struct PendingGet {
+      std::shared_ptr<GetRequest>  request    {};
+      //positions in request values of the asked elements
+      std::vector<size_t>          positions  {};
+      int                          owner      {-1};
+      Deadline                     deadline   {};
+    };
+
+    static std::vector<int> getAllIDs(const PolluxPayload& payload) {
+      auto ids = payload.getOtherIDs();
+      ids.push_back(payload.getLocalID());
+      return ids;
+    }
+    //values travel as their bit pattern in an int64 array
+    static int64_t encode(T value) {
+      int64_t bits = 0;
+      std::memcpy(&bits, &value, sizeof(T));
+      return bits;
+    }
+    static T decode(int64_t bits) {
+      T value;
+      std::memcpy(&value, &bits, sizeof(T));
+      return value;
+    }
+
+    size_t getRank(size_t index) const {
+      return distribution_ == Block ? index/blockSize_ : index%partIDs_.size();
+    }
+    size_t getLocalOffset(size_t index) const {
+      return distribution_ == Block ? index%blockSize_ : index/partIDs_.size();
+    }
+    size_t getLocalSize(size_t rank) const {
+      if (distribution_ == Block) {
+        size_t first = rank*blockSize_;
+        return first >= size_ ? 0 : std::min(blockSize_, size_ - first);
+      }
+      return (size_ + partIDs_.size() - 1 - rank) / partIDs_.size();
+    }
+    size_t checkIndex(size_t index) const {
+      if (index >= size_) {
+        throw PolluxPayloadException("distributed array " + name_ + ": index "
+          + std::to_string(index) + " out of range");
+      }
+      return index;
+    }
+
+    void apply(OperationKind kind, size_t index, T value) {
+      pollux::PolluxMessage message;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        checkIndex(index);
+        size_t rank = getRank(index);
+        if (rank == rank_) {
+          T& element = local_[getLocalOffset(index)];
+          element = kind == Put ? value : element + value;
+          return;
+        }
+        batches_[rank].push_back(Operation{kind, index, encode(value)});
+        if (batches_[rank].size() < maxBatchSize_) {
+          return;
+        }
+        message = takeBatchLocked(rank, 0);
+      }
+      send(message);
+    }
+
+    //lock must be held
+    pollux::PolluxMessage takeBatchLocked(size_t rank, uint64_t correlationID) {
+      pollux::PolluxMessage message;
+      message.set_key(OperationsPrefix + name_);
+      message.set_correlationid(correlationID);
+      message.add_destinations(partIDs_[rank]);
+      auto values = message.mutable_int64arrayvalue()->mutable_values();
+      values->Reserve(3*batches_[rank].size());
+      for (const auto& operation: batches_[rank]) {
+        values->Add(operation.kind);
+        values->Add(operation.index);
+        values->Add(operation.value);
+      }
+      batches_[rank].clear();
+      return message;
+    }
+
+    void send(pollux::PolluxMessage& message) {
+      ZebulonPayloadClient::Destinations destinations(message.destinations().begin(), message.destinations().end());
+      message.clear_destinations();
+      ++nbSentMessages_;
+      sender_(destinations, message);
+    }
+    void send(std::vector<pollux::PolluxMessage>& messages) {
+      for (auto& message: messages) {
+        send(message);
+      }
+    }
+
+    void receiveValues(uint64_t correlationID, const google::protobuf::RepeatedField<int64_t>& values) {
+      std::shared_ptr<GetRequest> completed;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto pit = pendingGets_.find(correlationID);
+        if (pit == pendingGets_.end()) {
+          return;
+        }
+        auto& [request, positions, owner, deadline] = pit->second;
+        if (size_t(values.size()) != positions.size()) {
+          failLocked(pit, "distributed array " + name_ + ": unexpected number of values");
+          throw PolluxPayloadException("distributed array " + name_ + ": unexpected number of values");
+        }
+        for (size_t i = 0; i < positions.size(); i++) {
+          request->values[positions[i]] = decode(values[i]);
+        }
+        //a request failed by another owner is answered already
+        if (--request->remaining == 0 and not request->failed) {
+          completed = request;
+        }
+        eraseLocked(pit);
+      }
+      if (completed) {
+        completed->promise.set_value(std::move(completed->values));
+      }
+    }
+
+    //lock must be held: removes the pending get and its deadline
+    void eraseLocked(typename std::map<uint64_t, PendingGet>::iterator pit) {
+      auto [first, last] = deadlines_.equal_range(pit->second.deadline);
+      for (auto dit = first; dit != last; ++dit) {
+        if (dit->second == pit->first) {
+          deadlines_.erase(dit);
+          break;
+        }
+      }
+      pendingGets_.erase(pit);
+    }
+    //lock must be held: the whole get fails once
+    void failLocked(typename std::map<uint64_t, PendingGet>::iterator pit, const std::string& reason) {
+      auto request = pit->second.request;
+      --request->remaining;
+      eraseLocked(pit);
+      if (not request->failed) {
+        request->failed = true;
+        request->promise.set_exception(std::make_exception_ptr(PolluxPayloadException(reason)));
+      }
+    }
+
+    void checkTimeouts() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (not stopped_) {
+        if (deadlines_.empty()) {
+          deadlinesChanged_.wait(lock);
+          continue;
+        }
+        auto first = deadlines_.begin();
+        if (std::chrono::steady_clock::now() < first->first) {
+          deadlinesChanged_.wait_until(lock, first->first);
+          continue;
+        }
+        auto pit = pendingGets_.find(first->second);
+        failLocked(pit, "distributed array " + name_ + ": get from "
+          + std::to_string(pit->second.owner) + " timed out");
+      }
+    }
+
+    std::string                         name_               {};
+    size_t                              size_               {0};
+    int                                 localID_            {-1};
+    std::vector<int>                    partIDs_            {};
+    Distribution                        distribution_       {Block};
+    ZebulonPayloadClient::MessageSender sender_             {};
+    size_t                              maxBatchSize_       {4096};
+    std::chrono::milliseconds           timeout_            {0};
+    size_t                              rank_               {0};
+    size_t                              blockSize_          {0};
+    mutable std::mutex                  mutex_;
+    std::vector<T>                      local_              {};
+    //buffered remote operations per owner rank
+    std::vector<std::vector<Operation>> batches_            {};
+    uint64_t                            nextCorrelationID_  {1};
+    std::map<uint64_t, PendingGet>      pendingGets_        {};
+    std::condition_variable             deadlinesChanged_;
+    std::multimap<Deadline, uint64_t>   deadlines_          {};
+    bool                                stopped_            {false};
+    std::thread                         timeoutThread_      {};
+    std::atomic<size_t>                 nbSentMessages_     {0};
+    std::atomic<size_t>                 nbReceivedMessages_ {0};
+    PolluxPayload::Registrations        registrations_      {};
+};
+
+#endif /* __POLLUX_DISTRIBUTED_ARRAY_H_ */
@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxFlowControl.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+PolluxFlowControl::PolluxFlowControl(
+  int localID,
+  const std::vector<int>& peers,
+  ZebulonPayloadClient::MessageSender sender,
+  size_t window,
+  Policy policy,
+  std::chrono::milliseconds blockTimeout):
+  localID_(localID),
+  peers_(peers),
+  sender_(sender),
+  window_(std::max(window, size_t(1))),
+  grantBatch_(std::max(window_ / 4, size_t(1))),
+  policy_(policy),
+  blockTimeout_(blockTimeout)
+{}
+
+PolluxFlowControl::PolluxFlowControl(
+  PolluxPayload& payload,
+  ZebulonPayloadClient* client,
+  size_t window,
+  Policy policy,
+  std::chrono::milliseconds blockTimeout):
+  PolluxFlowControl(payload.getLocalID(), payload.getOtherIDs(), client->getMessageSender(), window, policy, blockTimeout) {
+  registrations_.registerMessageHandler(payload, CreditKey, [this](const pollux::PolluxMessage* message) { receive(message); });
+  //the synchronous server handles a message before answering its transmit:
+  //a message is consumed when payload receives it
+  registrations_.addMessageObserver(payload, [this](const pollux::PolluxMessage* message) {
+    if (message->key().rfind("_pollux_", 0) != 0) {
+      consumed(message->origin());
+    }
+  });
+  //skipped messages were sent with a credit but will never be consumed
+  registrations_.addSkipObserver(payload, [this](int origin, size_t nbSkipped) {
+    consumed(origin, nbSkipped);
+  });
+  client_ = client;
+  client->setAdmission(
+    [this](const ZebulonPayloadClient::Destinations& destinations, const pollux::PolluxMessage&) {
+      return acquire(destinations);
+    });
+}
+
+PolluxFlowControl::~PolluxFlowControl() {
+  if (client_) {
+    client_->setAdmission({});
+  }
+}
+
+size_t& PolluxFlowControl::getCreditsLocked(int destination) {
+  auto cit = credits_.find(destination);
+  if (cit == credits_.end()) {
+    cit = credits_.emplace(destination, window_).first;
+  }
+  return cit->second;
+}
+
+ZebulonPayloadClient::Destinations PolluxFlowControl::acquire(const ZebulonPayloadClient::Destinations& destinations) {
+  const auto& targets = destinations.empty() ? peers_ : destinations;
+  ZebulonPayloadClient::Destinations admitted;
+  admitted.reserve(targets.size());
+  //one deadline for the whole message, whatever its number of destinations
+  const auto deadline{std::chrono::steady_clock::now() + blockTimeout_};
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto destination: targets) {
+    size_t& credits = getCreditsLocked(destination);
+    if (credits == 0 and policy_ == Block) {
+      ++nbBlocked_;
+      ++nbWaiting_;
+      auto hasCredits = [&credits]() { return credits > 0; };
+      if (blockTimeout_.count() == 0) {
+        creditsReturned_.wait(lock, hasCredits);
+      } else {
+        creditsReturned_.wait_until(lock, deadline, hasCredits);
+      }
+      --nbWaiting_;
+    }
+    if (credits == 0) {
+      ++nbDropped_;
+      if (policy_ == Block) {
+        spdlog::warn("FlowControl: no credit for {} after {} ms, message dropped", destination, blockTimeout_.count());
+      } else {
+        spdlog::debug("FlowControl: no credit for {}, message dropped", destination);
+      }
+      continue;
+    }
+    --credits;
+    admitted.push_back(destination);
+  }
+  return admitted;
+}
+
+ZebulonPayloadClient::MessageSender PolluxFlowControl::getMessageSender() {
+  return [this](const ZebulonPayloadClient::Destinations& destinations, pollux::PolluxMessage& message) {
+    if (message.key().rfind("_pollux_", 0) == 0) {
+      sender_(destinations, message);
+      return;
+    }
+    auto admitted = acquire(destinations);
+    if (not admitted.empty()) {
+      sender_(admitted, message);
+    }
+  };
+}
+
+void PolluxFlowControl::consumed(int origin, size_t nbMessages) {
+  size_t credits = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t& pending = consumed_[origin];
+    pending += nbMessages;
+    if (pending < grantBatch_) {
+      return;
+    }
+    credits = pending;
+    pending = 0;
+  }
+  pollux::PolluxMessage message;
+  message.set_key(CreditKey);
+  message.set_int64value(credits);
+  ++nbCreditMessages_;
+  sender_(ZebulonPayloadClient::Destinations({origin}), message);
+}
+
+void PolluxFlowControl::receive(const pollux::PolluxMessage* message) {
+  if (message->value_case() != pollux::PolluxMessage::kInt64Value or message->int64value() <= 0) {
+    throw PolluxPayloadException("malformed flow control credits from: " + std::to_string(message->origin()));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t& credits = getCreditsLocked(message->origin());
+    credits = std::min(credits + size_t(message->int64value()), window_);
+  }
+  creditsReturned_.notify_all();
+}
+
+size_t PolluxFlowControl::getInFlight(int destination) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto cit = credits_.find(destination);
+  return cit == credits_.end() ? 0 : window_ - cit->second;
+}
@@ -0,0 +1,103 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_FLOW_CONTROL_H_
+#define __POLLUX_FLOW_CONTROL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Credit based flow control on outgoing messages.
+//A payload may have at most "window" messages in flight to each destination:
+//every message consumes a credit, receivers give credits back by batches
+//(CreditKey messages) once messages are consumed or skipped. Without credits,
+//the Block policy waits for them up to blockTimeout per message, then the
+//message is dropped for the destinations still without credit (a lost credit
+//message must not hang the sender forever), and the Drop policy drops it at
+//once.
+//Library reserved keys ("_pollux_") are not flow controlled: their protocols
+//(credits, tokens, answers sent from handlers) must never wait.
+class PolluxFlowControl {
+  public:
+    static constexpr const char* CreditKey = "_pollux_flow_credit";
+    static constexpr std::chrono::milliseconds DefaultBlockTimeout {10000};
+
+    enum Policy { Block, Drop };
+
+    //transport agnostic constructor
+    //peers: all other payloads IDs (broadcast expansion)
+    //sender: used for credits and by getMessageSender
+    //blockTimeout: 0 waits as long as needed
+    PolluxFlowControl(
+      int localID,
+      const std::vector<int>& peers,
+      ZebulonPayloadClient::MessageSender sender,
+      size_t window = 64,
+      Policy policy = Block,
+      std::chrono::milliseconds blockTimeout = DefaultBlockTimeout);
+    //convenience constructor: client transmits are admitted by this object and
+    //received messages are consumed as soon as payload handled them, or
+    //skipped by its reorder buffer
+    PolluxFlowControl(
+      PolluxPayload& payload,
+      ZebulonPayloadClient* client,
+      size_t window = 64,
+      Policy policy = Block,
+      std::chrono::milliseconds blockTimeout = DefaultBlockTimeout);
+    PolluxFlowControl(const PolluxFlowControl&) = delete;
+    //resets the client admission, to be destroyed once transmits stopped
+    ~PolluxFlowControl();
+
+    //sender side: takes one credit per destination
+    //returns the destinations the message may be sent to
+    ZebulonPayloadClient::Destinations acquire(const ZebulonPayloadClient::Destinations& destinations);
+    //sender applying acquire, for modules running on another transport
+    ZebulonPayloadClient::MessageSender getMessageSender();
+
+    //receiver side: messages from origin consumed, credits are given back
+    //by batches of a quarter of the window
+    void consumed(int origin, size_t nbMessages = 1);
+    //handle CreditKey messages
+    void receive(const pollux::PolluxMessage* message);
+
+    //metrics
+    size_t getWindow() const { return window_; }
+    //messages sent to destination not credited back yet
+    size_t getInFlight(int destination) const;
+    //threads currently waiting for credits
+    size_t getNbWaiting() const { return nbWaiting_; }
+    //messages that waited for credits
+    size_t getNbBlocked() const { return nbBlocked_; }
+    size_t getNbDropped() const { return nbDropped_; }
+    size_t getNbCreditMessages() const { return nbCreditMessages_; }
+
+  private:
+    //lock must be held
+    size_t& getCreditsLocked(int destination);
+
+    int                                 localID_          {-1};
+    std::vector<int>                    peers_            {};
+    ZebulonPayloadClient::MessageSender sender_           {};
+    size_t                              window_           {64};
+    size_t                              grantBatch_       {16};
+    Policy                              policy_           {Block};
+    std::chrono::milliseconds           blockTimeout_     {DefaultBlockTimeout};
+    mutable std::mutex                  mutex_;
+    std::condition_variable             creditsReturned_;
+    //sender side: available credits per destination
+    std::map<int, size_t>               credits_          {};
+    //receiver side: consumed messages not credited back yet per origin
+    std::map<int, size_t>               consumed_         {};
+    std::atomic<size_t>                 nbWaiting_        {0};
+    std::atomic<size_t>                 nbBlocked_        {0};
+    std::atomic<size_t>                 nbDropped_        {0};
+    std::atomic<size_t>                 nbCreditMessages_ {0};
+    ZebulonPayloadClient*               client_           {nullptr};
+    PolluxPayload::Registrations        registrations_    {};
+};
+
+#endif /* __POLLUX_FLOW_CONTROL_H_ */
@@ -0,0 +1,150 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxGlobalBest.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+namespace {
+
+//entry is encoded as: origin, version, fitness, values...
+constexpr int EntryHeaderSize = 3;
+
+PolluxGlobalBest::Entry decodeEntry(const pollux::PolluxMessage* message) {
+  if (message->value_case() != pollux::PolluxMessage::kDoubleArrayValue
+    or message->doublearrayvalue().values_size() < EntryHeaderSize) {
+    throw PolluxPayloadException("malformed global best message from: " + std::to_string(message->origin()));
+  }
+  const auto& values = message->doublearrayvalue().values();
+  PolluxGlobalBest::Entry entry;
+  entry.origin = static_cast<int>(values[0]);
+  entry.version = static_cast<uint64_t>(values[1]);
+  entry.fitness = values[2];
+  entry.values.assign(values.begin() + EntryHeaderSize, values.end());
+  return entry;
+}
+
+bool improves(const PolluxGlobalBest::Entry& candidate, const PolluxGlobalBest::Entry& current) {
+  return not current.isValid() or candidate.fitness < current.fitness;
+}
+
+}
+
+PolluxGlobalBest::PolluxGlobalBest(int localID, int owner, ZebulonPayloadClient::MessageSender sender):
+  localID_(localID),
+  owner_(owner),
+  sender_(sender)
+{}
+
+PolluxGlobalBest::PolluxGlobalBest(PolluxPayload& payload, ZebulonPayloadClient* client):
+  PolluxGlobalBest(payload.getLocalID(), payload.getLocalID(), client->getMessageSender()) {
+  for (auto id: payload.getOtherIDs()) {
+    owner_ = std::min(owner_, id);
+  }
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, SubmitKey, handler);
+  registrations_.registerMessageHandler(payload, UpdateKey, handler);
+}
+
+bool PolluxGlobalBest::submit(double fitness, const std::vector<double>& values) {
+  Entry entry{localID_, 0, fitness, values};
+  bool improved = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (improves(entry, cache_)) {
+      //optimistic local update, owner will confirm or send a better one
+      cache_ = entry;
+      improved = true;
+    } else if (cache_.origin == localID_ and cache_.version == 0) {
+      //previous candidate not confirmed yet (owner may not have been ready): resend it
+      entry = cache_;
+    } else {
+      return false;
+    }
+  }
+  if (isOwner()) {
+    improve(entry);
+  } else {
+    send(ZebulonPayloadClient::Destinations({owner_}), SubmitKey, entry);
+  }
+  return improved;
+}
+
+void PolluxGlobalBest::improve(const Entry& entry) {
+  Entry update;
+  bool improved = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (improves(entry, register_)) {
+      update = entry;
+      update.version = register_.version + 1;
+      register_ = update;
+      improved = true;
+    } else {
+      //the submitter cache is stale (missed or reordered update):
+      //it gets the register so that it stops resending its candidate
+      update = register_;
+    }
+    if (improves(update, cache_)
+      or (update.origin == cache_.origin and update.fitness == cache_.fitness)
+      or (not improved and entry.origin == localID_)) {
+      cache_ = update;
+    }
+  }
+  if (not improved) {
+    if (entry.origin != localID_) {
+      send(ZebulonPayloadClient::Destinations({entry.origin}), UpdateKey, update);
+    }
+    return;
+  }
+  spdlog::debug("Global best: new best {} from {} (version {})", update.fitness, update.origin, update.version);
+  //push to all payloads
+  send(ZebulonPayloadClient::Destinations(), UpdateKey, update);
+}
+
+void PolluxGlobalBest::receive(const pollux::PolluxMessage* message) {
+  Entry entry = decodeEntry(message);
+  if (message->key() == SubmitKey) {
+    if (not isOwner()) {
+      throw PolluxPayloadException("global best submit received by non owner: " + std::to_string(localID_));
+    }
+    improve(entry);
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    //register only improves: a reordered older update is simply not better
+    //an update of our own candidate confirms it, an equally good register
+    //answering our unconfirmed candidate replaces it
+    if (improves(entry, cache_)
+      or (entry.origin == cache_.origin and entry.fitness == cache_.fitness)
+      or (cache_.origin == localID_ and cache_.version == 0 and entry.fitness <= cache_.fitness)) {
+      cache_ = entry;
+    }
+  }
+}
+
+void PolluxGlobalBest::send(
+  const ZebulonPayloadClient::Destinations& destinations,
+  const char* key,
+  const Entry& entry) {
+  pollux::PolluxMessage message;
+  message.set_key(key);
+  auto doubleArray = message.mutable_doublearrayvalue();
+  doubleArray->mutable_values()->Reserve(EntryHeaderSize + entry.values.size());
+  doubleArray->add_values(entry.origin);
+  doubleArray->add_values(static_cast<double>(entry.version));
+  doubleArray->add_values(entry.fitness);
+  for (auto value: entry.values) {
+    doubleArray->add_values(value);
+  }
+  sender_(destinations, message);
+}
+
+PolluxGlobalBest::Entry PolluxGlobalBest::getBest() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cache_;
+}
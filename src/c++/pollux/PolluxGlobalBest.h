@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_GLOBAL_BEST_H_
+#define __POLLUX_GLOBAL_BEST_H_
+
+#include <mutex>
+
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Global best register with compare-and-improve semantics.
+//One owner payload keeps the argmin of all submitted (fitness, vector).
+//A payload only sends a candidate to the owner when it improves its cached
+//copy of the global best, the owner pushes the new best to every payload
+//only when it improves the register. Payloads read their cached copy.
+class PolluxGlobalBest {
+  public:
+    static constexpr const char* SubmitKey = "_pollux_globalbest_submit";
+    static constexpr const char* UpdateKey = "_pollux_globalbest_update";
+
+    struct Entry {
+      int                 origin    {-1};
+      //register version, 0 for a local candidate not yet confirmed by owner
+      uint64_t            version   {0};
+      double              fitness   {0};
+      std::vector<double> values    {};
+      bool isValid() const { return origin >= 0; }
+    };
+
+    //transport agnostic constructor: owner keeps the register
+    PolluxGlobalBest(int localID, int owner, ZebulonPayloadClient::MessageSender sender);
+    //convenience constructor: owner is the lowest payload ID,
+    //message handlers are registered on payload
+    PolluxGlobalBest(PolluxPayload& payload, ZebulonPayloadClient* client);
+    PolluxGlobalBest(const PolluxGlobalBest&) = delete;
+
+    //submit a local candidate (lower fitness is better)
+    //returns true if it improved the cached global best and was sent to the owner
+    //an own candidate not yet confirmed by the owner is sent again
+    bool submit(double fitness, const std::vector<double>& values);
+
+    //cached copy of the global best
+    Entry getBest() const;
+
+    //handle SubmitKey and UpdateKey messages
+    void receive(const pollux::PolluxMessage* message);
+
+    int getOwner() const { return owner_; }
+    bool isOwner() const { return owner_ == localID_; }
+
+  private:
+    //owner side: compare and improve then push to everyone,
+    //a non improving submitter gets the register back
+    void improve(const Entry& entry);
+    void send(const ZebulonPayloadClient::Destinations& destinations, const char* key, const Entry& entry);
+
+    int                                 localID_  {-1};
+    int                                 owner_    {-1};
+    ZebulonPayloadClient::MessageSender sender_   {};
+    mutable std::mutex                  mutex_;
+    //register value, only meaningful on owner
+    Entry                               register_ {};
+    //cached global best
+    Entry                               cache_    {};
+    PolluxPayload::Registrations        registrations_ {};
+};
+
+#endif /* __POLLUX_GLOBAL_BEST_H_ */
@@ -0,0 +1,239 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxGlobalCounters.h"
+
+#include <algorithm>
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+PolluxGlobalCounters::PolluxGlobalCounters(
+  int localID,
+  int owner,
+  ZebulonPayloadClient::MessageSender sender,
+  std::chrono::milliseconds flushInterval):
+  localID_(localID),
+  owner_(owner),
+  sender_(sender),
+  flushInterval_(flushInterval),
+  lastFlush_(Clock::now())
+{}
+
+PolluxGlobalCounters::PolluxGlobalCounters(
+  PolluxPayload& payload,
+  ZebulonPayloadClient* client,
+  std::chrono::milliseconds flushInterval):
+  PolluxGlobalCounters(payload.getLocalID(), payload.getLocalID(), client->getMessageSender(), flushInterval) {
+  for (auto id: payload.getOtherIDs()) {
+    owner_ = std::min(owner_, id);
+  }
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, UpdateKey, handler);
+  registrations_.registerMessageHandler(payload, ValuesKey, handler);
+  client_ = client;
+  //updates of the iteration reach the owner before the barrier,
+  //no refresh request is sent when there are none
+  hookID_ = client->addBarrierHook([this]() {
+    bool pending = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending = not pending_.empty();
+    }
+    if (pending) {
+      flush();
+    }
+  });
+}
+
+PolluxGlobalCounters::~PolluxGlobalCounters() {
+  if (client_) {
+    client_->removeBarrierHook(hookID_);
+  }
+}
+
+int64_t PolluxGlobalCounters::combine(Operation operation, int64_t current, int64_t value) {
+  switch (operation) {
+    case Add: return current + value;
+    case Max: return std::max(current, value);
+    case Min: return std::min(current, value);
+  }
+  return current;
+}
+
+void PolluxGlobalCounters::update(const std::string& name, Operation operation, int64_t value) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (isOwner()) {
+      auto vit = values_.find(name);
+      values_[name] = vit == values_.end() ? value : combine(operation, vit->second, value);
+      ++version_;
+      return;
+    }
+    auto pit = pending_.find(name);
+    if (pit == pending_.end()) {
+      pending_[name] = Pending{operation, value};
+    } else {
+      pit->second.value = combine(operation, pit->second.value, value);
+    }
+    if (Clock::now() - lastFlush_ < flushInterval_) {
+      return;
+    }
+  }
+  flush();
+}
+
+void PolluxGlobalCounters::flush() {
+  if (isOwner()) {
+    return;
+  }
+  pollux::PolluxCounterUpdates updates;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [name, pending]: pending_) {
+      auto update = updates.add_updates();
+      update->set_name(name);
+      update->set_operation(static_cast<pollux::PolluxCounterUpdate::Operation>(pending.operation));
+      update->set_value(pending.value);
+    }
+    pending_.clear();
+    lastFlush_ = Clock::now();
+  }
+  send(owner_, UpdateKey, updates, 0);
+}
+
+std::future<int64_t> PolluxGlobalCounters::fetchAdd(const std::string& name, int64_t delta) {
+  pollux::PolluxCounterUpdates updates;
+  auto update = updates.add_updates();
+  update->set_name(name);
+  update->set_operation(pollux::PolluxCounterUpdate::ADD);
+  update->set_value(delta);
+  std::future<int64_t> previous;
+  uint64_t correlationID = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (isOwner()) {
+      std::promise<int64_t> promise;
+      promise.set_value(values_[name]);
+      values_[name] += delta;
+      ++version_;
+      return promise.get_future();
+    }
+    correlationID = nextCorrelationID_++;
+    auto& pendingFetch = pendingFetches_[correlationID];
+    pendingFetch.name = name;
+    pendingFetch.delta = delta;
+    previous = pendingFetch.promise.get_future();
+  }
+  send(owner_, UpdateKey, updates, correlationID);
+  return previous;
+}
+
+int64_t PolluxGlobalCounters::get(const std::string& name, std::chrono::milliseconds maxAge) {
+  bool refresh = false;
+  int64_t value = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto vit = values_.find(name);
+    auto pit = pending_.find(name);
+    if (vit != values_.end()) {
+      value = vit->second;
+      if (pit != pending_.end()) {
+        value = combine(pit->second.operation, value, pit->second.value);
+      }
+    } else if (pit != pending_.end()) {
+      value = pit->second.value;
+    }
+    //maxAge in Clock period would overflow for the default value
+    bool expired = maxAge != std::chrono::milliseconds::max() and Clock::now() - lastRefresh_ > maxAge;
+    if (not isOwner() and expired) {
+      //avoid asking again before the answer
+      lastRefresh_ = Clock::now();
+      refresh = true;
+    }
+  }
+  if (refresh) {
+    flush();
+  }
+  return value;
+}
+
+pollux::PolluxCounterUpdates PolluxGlobalCounters::applyLocked(const pollux::PolluxCounterUpdates& updates) {
+  for (const auto& update: updates.updates()) {
+    auto operation = static_cast<Operation>(update.operation());
+    auto vit = values_.find(update.name());
+    if (vit == values_.end()) {
+      values_[update.name()] = update.value();
+    } else {
+      vit->second = combine(operation, vit->second, update.value());
+    }
+  }
+  version_ += updates.updates_size();
+  pollux::PolluxCounterUpdates values;
+  values.set_version(version_);
+  for (const auto& [name, value]: values_) {
+    auto update = values.add_updates();
+    update->set_name(name);
+    update->set_value(value);
+  }
+  return values;
+}
+
+void PolluxGlobalCounters::send(
+  int destination,
+  const char* key,
+  const pollux::PolluxCounterUpdates& updates,
+  uint64_t correlationID) {
+  pollux::PolluxMessage message;
+  message.set_key(key);
+  message.set_correlationid(correlationID);
+  message.set_bytesvalue(updates.SerializeAsString());
+  ++nbSentMessages_;
+  sender_(ZebulonPayloadClient::Destinations({destination}), message);
+}
+
+void PolluxGlobalCounters::receive(const pollux::PolluxMessage* message) {
+  pollux::PolluxCounterUpdates updates;
+  if (message->value_case() != pollux::PolluxMessage::kBytesValue
+    or not updates.ParseFromString(message->bytesvalue())) {
+    throw PolluxPayloadException("malformed counters message from: " + std::to_string(message->origin()));
+  }
+  if (message->key() == UpdateKey) {
+    pollux::PolluxCounterUpdates values;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      values = applyLocked(updates);
+    }
+    send(message->origin(), ValuesKey, values, message->correlationid());
+    return;
+  }
+  std::promise<int64_t> promise;
+  int64_t previous = 0;
+  bool fetched = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    //a fetchAdd answer is taken from its own values, even if overtaken
+    auto pit = pendingFetches_.find(message->correlationid());
+    if (pit != pendingFetches_.end()) {
+      for (const auto& update: updates.updates()) {
+        if (update.name() == pit->second.name) {
+          previous = update.value();
+        }
+      }
+      previous -= pit->second.delta;
+      promise = std::move(pit->second.promise);
+      pendingFetches_.erase(pit);
+      fetched = true;
+    }
+    if (updates.version() >= version_) {
+      for (const auto& update: updates.updates()) {
+        values_[update.name()] = update.value();
+      }
+      version_ = updates.version();
+      lastRefresh_ = Clock::now();
+    }
+  }
+  if (fetched) {
+    promise.set_value(previous);
+  }
+}
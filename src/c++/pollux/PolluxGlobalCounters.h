@@ -0,0 +1,113 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_GLOBAL_COUNTERS_H_
+#define __POLLUX_GLOBAL_COUNTERS_H_
+
+#include <atomic>
+#include <future>
+#include <mutex>
+
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Named global counters (progress, node budgets, evaluation limits...)
+//owned by one payload.
+//Local updates are combined (sum for Add, max for Max, min for Min) and sent
+//to the owner in one message on flush(), called explicitly, by an update
+//once flushInterval elapsed since the previous flush or, with the convenience
+//constructor, before reporting to the iteration barrier.
+//The owner answers each flush with all counters values: reads are served
+//from this cache combined with the local updates not sent yet. Answers older
+//than the cache (overtaken by a later one) are dropped.
+//fetchAdd is not combined: one round trip returning the previous value.
+class PolluxGlobalCounters {
+  public:
+    static constexpr const char* UpdateKey = "_pollux_counters_update";
+    static constexpr const char* ValuesKey = "_pollux_counters_values";
+
+    enum Operation {
+      Add = pollux::PolluxCounterUpdate::ADD,
+      Max = pollux::PolluxCounterUpdate::MAX,
+      Min = pollux::PolluxCounterUpdate::MIN
+    };
+
+    //transport agnostic constructor: owner keeps the counters
+    PolluxGlobalCounters(
+      int localID,
+      int owner,
+      ZebulonPayloadClient::MessageSender sender,
+      std::chrono::milliseconds flushInterval = std::chrono::milliseconds(10));
+    //convenience constructor: owner is the lowest payload ID,
+    //message handlers and a client barrier flush are registered
+    PolluxGlobalCounters(
+      PolluxPayload& payload,
+      ZebulonPayloadClient* client,
+      std::chrono::milliseconds flushInterval = std::chrono::milliseconds(10));
+    PolluxGlobalCounters(const PolluxGlobalCounters&) = delete;
+    //removes the client barrier flush, to be destroyed once transmits stopped
+    ~PolluxGlobalCounters();
+
+    //combined updates, a counter must always be updated with the same operation
+    void add(const std::string& name, int64_t delta) { update(name, Add, delta); }
+    void max(const std::string& name, int64_t value) { update(name, Max, value); }
+    void min(const std::string& name, int64_t value) { update(name, Min, value); }
+
+    //atomic fetch and add on the owner, returns the value before delta
+    std::future<int64_t> fetchAdd(const std::string& name, int64_t delta);
+
+    //send combined updates to the owner, or ask for fresh values if none
+    void flush();
+
+    //cached value including local updates not flushed yet, 0 if unknown
+    //if the cache is older than maxAge a refresh is requested (answer is not awaited)
+    int64_t get(const std::string& name, std::chrono::milliseconds maxAge = std::chrono::milliseconds::max());
+
+    //handle UpdateKey (owner side) and ValuesKey messages
+    void receive(const pollux::PolluxMessage* message);
+
+    int getOwner() const { return owner_; }
+    bool isOwner() const { return owner_ == localID_; }
+    size_t getNbSentMessages() const { return nbSentMessages_; }
+
+  private:
+    struct Pending {
+      Operation operation {Add};
+      int64_t   value     {0};
+    };
+    struct PendingFetch {
+      std::string             name    {};
+      int64_t                 delta   {0};
+      std::promise<int64_t>   promise {};
+    };
+    using Clock = std::chrono::steady_clock;
+
+    static int64_t combine(Operation operation, int64_t current, int64_t value);
+    void update(const std::string& name, Operation operation, int64_t value);
+    //owner side, lock must be held
+    //returns values of all counters
+    pollux::PolluxCounterUpdates applyLocked(const pollux::PolluxCounterUpdates& updates);
+    void send(int destination, const char* key, const pollux::PolluxCounterUpdates& updates, uint64_t correlationID);
+
+    int                                 localID_            {-1};
+    int                                 owner_              {-1};
+    ZebulonPayloadClient::MessageSender sender_             {};
+    std::chrono::milliseconds           flushInterval_      {10};
+    mutable std::mutex                  mutex_;
+    //owner: counters values, others: cache of the owner values
+    std::map<std::string, int64_t>      values_             {};
+    //owner: updates applied, others: version of the cache
+    uint64_t                            version_            {0};
+    std::map<std::string, Pending>      pending_            {};
+    Clock::time_point                   lastFlush_          {};
+    Clock::time_point                   lastRefresh_        {};
+    uint64_t                            nextCorrelationID_  {1};
+    //fetchAdd calls waiting for the owner answer
+    std::map<uint64_t, PendingFetch>    pendingFetches_     {};
+    std::atomic<size_t>                 nbSentMessages_     {0};
+    ZebulonPayloadClient*               client_             {nullptr};
+    size_t                              hookID_             {0};
+    PolluxPayload::Registrations        registrations_      {};
+};
+
+#endif /* __POLLUX_GLOBAL_COUNTERS_H_ */
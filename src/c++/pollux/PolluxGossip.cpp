@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxGossip.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+namespace {
+
+//record is encoded as: origin, version, fitness, values...
+constexpr int RecordHeaderSize = 3;
+
+PolluxGossip::Record decodeRecord(const pollux::PolluxMessage* message) {
+  if (message->value_case() != pollux::PolluxMessage::kDoubleArrayValue
+    or message->doublearrayvalue().values_size() < RecordHeaderSize) {
+    throw PolluxPayloadException("malformed gossip message from: " + std::to_string(message->origin()));
+  }
+  const auto& values = message->doublearrayvalue().values();
+  PolluxGossip::Record record;
+  record.origin = static_cast<int>(values[0]);
+  record.version = static_cast<uint64_t>(values[1]);
+  record.fitness = values[2];
+  record.values.assign(values.begin() + RecordHeaderSize, values.end());
+  return record;
+}
+
+}
+
+PolluxGossip::PolluxGossip(
+  int localID,
+  const std::vector<int>& peers,
+  size_t fanout,
+  ZebulonPayloadClient::MessageSender sender,
+  size_t rounds):
+  localID_(localID),
+  peers_(peers),
+  fanout_(std::max(fanout, size_t(1))),
+  rounds_(rounds),
+  sender_(sender),
+  generator_(std::random_device()() + localID) {
+  if (rounds_ == 0) {
+    rounds_ = getDefaultRounds(peers_.size()+1, fanout_);
+  }
+}
+
+PolluxGossip::PolluxGossip(PolluxPayload& payload, ZebulonPayloadClient* client, size_t fanout, size_t rounds):
+  PolluxGossip(payload.getLocalID(), payload.getOtherIDs(), fanout, client->getMessageSender(), rounds) {
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, PushKey, handler);
+  registrations_.registerMessageHandler(payload, PullKey, handler);
+}
+
+size_t PolluxGossip::getDefaultRounds(size_t nbPayloads, size_t fanout) {
+  //push phase infects the population in log_(fanout+1)(N) rounds,
+  //extra rounds and pull answers reach the last uninformed payloads
+  double rounds = std::ceil(std::log(double(std::max(nbPayloads, size_t(2)))) / std::log(double(fanout+1)));
+  return size_t(rounds) + 2;
+}
+
+bool PolluxGossip::submit(double fitness, const std::vector<double>& values) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (best_.isValid() and best_.fitness <= fitness) {
+    return false;
+  }
+  best_ = Record{localID_, ++localVersion_, fitness, values};
+  seenVersions_[localID_] = localVersion_;
+  hotRounds_ = rounds_;
+  return true;
+}
+
+size_t PolluxGossip::round() {
+  Record record;
+  std::vector<int> destinations;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (hotRounds_ == 0 or peers_.empty()) {
+      return 0;
+    }
+    --hotRounds_;
+    record = best_;
+    destinations = peers_;
+    size_t nbDestinations = std::min(fanout_, destinations.size());
+    //partial Fisher-Yates: first nbDestinations entries are the random pick
+    for (size_t i = 0; i < nbDestinations; i++) {
+      std::uniform_int_distribution<size_t> distribution(i, destinations.size()-1);
+      std::swap(destinations[i], destinations[distribution(generator_)]);
+    }
+    destinations.resize(nbDestinations);
+  }
+  for (auto destination: destinations) {
+    send(destination, PushKey, record);
+  }
+  return destinations.size();
+}
+
+void PolluxGossip::receive(const pollux::PolluxMessage* message) {
+  ++nbReceivedMessages_;
+  Record record = decodeRecord(message);
+  Record reply;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (merge(record)) {
+      spdlog::debug("Gossip: new best {} from {} (version {})", record.fitness, record.origin, record.version);
+    }
+    //pull: sender is behind, answer with our better record
+    if (message->key() == PushKey and best_.fitness < record.fitness) {
+      reply = best_;
+    }
+  }
+  if (reply.isValid()) {
+    send(message->origin(), PullKey, reply);
+  }
+}
+
+bool PolluxGossip::merge(const Record& record) {
+  auto sit = seenVersions_.find(record.origin);
+  if (sit != seenVersions_.end() and sit->second >= record.version) {
+    ++nbDuplicates_;
+    return false;
+  }
+  seenVersions_[record.origin] = record.version;
+  if (best_.isValid() and best_.fitness <= record.fitness) {
+    return false;
+  }
+  best_ = record;
+  hotRounds_ = rounds_;
+  return true;
+}
+
+void PolluxGossip::send(int destination, const char* key, const Record& record) {
+  pollux::PolluxMessage message;
+  message.set_key(key);
+  auto doubleArray = message.mutable_doublearrayvalue();
+  doubleArray->mutable_values()->Reserve(RecordHeaderSize + record.values.size());
+  doubleArray->add_values(record.origin);
+  doubleArray->add_values(static_cast<double>(record.version));
+  doubleArray->add_values(record.fitness);
+  for (auto value: record.values) {
+    doubleArray->add_values(value);
+  }
+  ++nbSentMessages_;
+  sender_(ZebulonPayloadClient::Destinations({destination}), message);
+}
+
+PolluxGossip::Record PolluxGossip::getBest() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return best_;
+}
+
+bool PolluxGossip::isHot() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hotRounds_ > 0;
+}
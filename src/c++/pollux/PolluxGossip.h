@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_GOSSIP_H_
+#define __POLLUX_GOSSIP_H_
+
+#include <atomic>
+#include <mutex>
+#include <random>
+
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Push-pull gossip spreading a small "best-so-far" record.
+//Instead of broadcasting every improvement to all payloads (O(N^2) messages
+//per iteration), each round a payload pushes its record to "fanout" random
+//peers while the record is "hot". A peer holding a better record answers
+//with it (pull). Records are (origin, version) stamped: every payload only
+//keeps the highest version seen per origin so duplicates are dropped.
+//A fresh record reaches all payloads in O(log N) rounds.
+class PolluxGossip {
+  public:
+    static constexpr const char* PushKey = "_pollux_gossip_push";
+    static constexpr const char* PullKey = "_pollux_gossip_pull";
+
+    struct Record {
+      int                 origin    {-1};
+      uint64_t            version   {0};
+      double              fitness   {0};
+      std::vector<double> values    {};
+      bool isValid() const { return origin >= 0; }
+    };
+
+    //transport agnostic constructor
+    //rounds: number of rounds a new record is pushed, 0 for default (O(log N))
+    PolluxGossip(
+      int localID,
+      const std::vector<int>& peers,
+      size_t fanout,
+      ZebulonPayloadClient::MessageSender sender,
+      size_t rounds = 0);
+    //convenience constructor: peers are payload other IDs and message
+    //handlers are registered on payload
+    PolluxGossip(PolluxPayload& payload, ZebulonPayloadClient* client, size_t fanout, size_t rounds = 0);
+    PolluxGossip(const PolluxGossip&) = delete;
+
+    //submit a local candidate (lower fitness is better)
+    //returns true if it improves the known best
+    bool submit(double fitness, const std::vector<double>& values);
+
+    //one gossip round: push the best record to fanout random peers if it is hot
+    //returns the number of sent messages
+    size_t round();
+
+    //handle PushKey and PullKey messages
+    void receive(const pollux::PolluxMessage* message);
+
+    Record getBest() const;
+    //true if a record is still being pushed
+    bool isHot() const;
+
+    size_t getNbSentMessages() const { return nbSentMessages_; }
+    size_t getNbReceivedMessages() const { return nbReceivedMessages_; }
+    size_t getNbDuplicates() const { return nbDuplicates_; }
+
+    static size_t getDefaultRounds(size_t nbPayloads, size_t fanout);
+
+  private:
+    //returns true if record improves the best one
+    bool merge(const Record& record);
+    void send(int destination, const char* key, const Record& record);
+
+    int                                 localID_            {-1};
+    std::vector<int>                    peers_              {};
+    size_t                              fanout_             {1};
+    size_t                              rounds_             {0};
+    ZebulonPayloadClient::MessageSender sender_             {};
+    mutable std::mutex                  mutex_;
+    Record                              best_               {};
+    uint64_t                            localVersion_       {0};
+    std::map<int, uint64_t>             seenVersions_       {};
+    size_t                              hotRounds_          {0};
+    std::mt19937                        generator_;
+    std::atomic<size_t>                 nbSentMessages_     {0};
+    std::atomic<size_t>                 nbReceivedMessages_ {0};
+    std::atomic<size_t>                 nbDuplicates_       {0};
+    PolluxPayload::Registrations        registrations_      {};
+};
+
+#endif /* __POLLUX_GOSSIP_H_ */
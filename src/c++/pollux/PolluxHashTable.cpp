@@ -0,0 +1,119 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxHashTable.h"
+
+namespace {
+
+size_t roundUpToPowerOfTwo(size_t value) {
+  size_t power = 16;
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+}
+
+PolluxHashTable::PolluxHashTable(size_t capacity) {
+  rehash(roundUpToPowerOfTwo(capacity));
+}
+
+uint64_t PolluxHashTable::hash(Key key) {
+  //splitmix64 finalizer: user keys are often sequential or structured
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
+}
+
+size_t PolluxHashTable::findIndex(Key key) const {
+  uint64_t keyHash = hash(key);
+  uint8_t tag = getTag(keyHash);
+  for (size_t index = keyHash & mask_; controls_[index] != Empty; index = (index + 1) & mask_) {
+    if (controls_[index] == tag and slots_[index].key == key) {
+      return index;
+    }
+  }
+  return capacity();
+}
+
+std::optional<PolluxHashTable::Value> PolluxHashTable::insert(Key key, Value value) {
+  if ((size_ + 1) * MaxLoadDenominator > capacity() * MaxLoadNumerator) {
+    rehash(capacity() * 2);
+  }
+  uint64_t keyHash = hash(key);
+  uint8_t tag = getTag(keyHash);
+  size_t index = keyHash & mask_;
+  for (; controls_[index] != Empty; index = (index + 1) & mask_) {
+    if (controls_[index] == tag and slots_[index].key == key) {
+      Value previous = slots_[index].value;
+      slots_[index].value = value;
+      return previous;
+    }
+  }
+  controls_[index] = tag;
+  slots_[index] = Slot{key, value};
+  ++size_;
+  return std::nullopt;
+}
+
+std::optional<PolluxHashTable::Value> PolluxHashTable::find(Key key) const {
+  size_t index = findIndex(key);
+  if (index == capacity()) {
+    return std::nullopt;
+  }
+  return slots_[index].value;
+}
+
+std::optional<PolluxHashTable::Value> PolluxHashTable::erase(Key key) {
+  size_t index = findIndex(key);
+  if (index == capacity()) {
+    return std::nullopt;
+  }
+  Value erased = slots_[index].value;
+  //backward shift: move back following entries whose home slot
+  //is not cyclically in (index, next]
+  for (size_t next = (index + 1) & mask_; controls_[next] != Empty; next = (next + 1) & mask_) {
+    size_t home = hash(slots_[next].key) & mask_;
+    bool inPlace = index <= next ? (index < home and home <= next) : (index < home or home <= next);
+    if (inPlace) {
+      continue;
+    }
+    controls_[index] = controls_[next];
+    slots_[index] = slots_[next];
+    index = next;
+  }
+  controls_[index] = Empty;
+  --size_;
+  return erased;
+}
+
+void PolluxHashTable::reserve(size_t size) {
+  size_t capacity = roundUpToPowerOfTwo((size * MaxLoadDenominator + MaxLoadNumerator - 1) / MaxLoadNumerator);
+  if (capacity > this->capacity()) {
+    rehash(capacity);
+  }
+}
+
+void PolluxHashTable::rehash(size_t capacity) {
+  std::vector<uint8_t> controls(capacity, Empty);
+  std::vector<Slot> slots(capacity);
+  controls_.swap(controls);
+  slots_.swap(slots);
+  mask_ = capacity - 1;
+  for (size_t index = 0; index < controls.size(); index++) {
+    if (controls[index] == Empty) {
+      continue;
+    }
+    uint64_t keyHash = hash(slots[index].key);
+    size_t target = keyHash & mask_;
+    while (controls_[target] != Empty) {
+      target = (target + 1) & mask_;
+    }
+    controls_[target] = controls[index];
+    slots_[target] = slots[index];
+  }
+}
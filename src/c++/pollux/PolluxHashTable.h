@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_HASH_TABLE_H_
+#define __POLLUX_HASH_TABLE_H_
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//Open addressing (linear probing) hash table from 64 bits keys to 64 bits values.
+//One control byte per slot holds an occupied bit and 7 bits of the key hash:
+//probing scans the packed control bytes and only reads a slot on a tag match.
+//Erase shifts the following entries back, no tombstones are left behind.
+class PolluxHashTable {
+  public:
+    using Key = uint64_t;
+    using Value = int64_t;
+
+    explicit PolluxHashTable(size_t capacity = 16);
+
+    //insert or assign, returns the previous value if key was present
+    std::optional<Value> insert(Key key, Value value);
+    std::optional<Value> find(Key key) const;
+    //returns the erased value if key was present
+    std::optional<Value> erase(Key key);
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return slots_.size(); }
+    //make room for size entries without rehashing
+    void reserve(size_t size);
+
+    static uint64_t hash(Key key);
+
+  private:
+    static constexpr uint8_t Empty = 0;
+    //load factor above which the table grows: MaxLoadNumerator/MaxLoadDenominator
+    static constexpr size_t MaxLoadNumerator = 7;
+    static constexpr size_t MaxLoadDenominator = 8;
+
+    struct Slot {
+      Key   key   {0};
+      Value value {0};
+    };
+
+    static uint8_t getTag(uint64_t hash) { return 0x80 | uint8_t(hash >> 57); }
+    //index of key slot or capacity() if not present
+    size_t findIndex(Key key) const;
+    void rehash(size_t capacity);
+
+    std::vector<uint8_t>  controls_ {};
+    std::vector<Slot>     slots_    {};
+    size_t                mask_     {0};
+    size_t                size_     {0};
+};
+
+#endif /* __POLLUX_HASH_TABLE_H_ */
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxMessageArena.h"
+
+#include <memory>
+
+namespace {
+
+thread_local bool threadBlockInUse = false;
+
+google::protobuf::ArenaOptions getOptions(bool ownsThreadBlock) {
+  google::protobuf::ArenaOptions options;
+  if (ownsThreadBlock) {
+    thread_local std::unique_ptr<char[]> threadBlock(new char[PolluxMessageArena::BlockSize]);
+    options.initial_block = threadBlock.get();
+    options.initial_block_size = PolluxMessageArena::BlockSize;
+  }
+  return options;
+}
+
+}
+
+PolluxMessageArena::PolluxMessageArena():
+  ownsThreadBlock_(not threadBlockInUse),
+  arena_(getOptions(ownsThreadBlock_)) {
+  if (ownsThreadBlock_) {
+    threadBlockInUse = true;
+  }
+}
+
+PolluxMessageArena::~PolluxMessageArena() {
+  //arena_ is destroyed right after: nothing can use the block in between
+  if (ownsThreadBlock_) {
+    threadBlockInUse = false;
+  }
+}
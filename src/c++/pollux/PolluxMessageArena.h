@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_MESSAGE_ARENA_H_
+#define __POLLUX_MESSAGE_ARENA_H_
+
+#include <google/protobuf/arena.h>
+
+//Protobuf arena for short lived messages (outgoing transmits, responses).
+//Its first block belongs to the calling thread and is reused by every arena
+//the thread creates: messages fitting in it are built without any heap
+//allocation. An arena created while another one is alive on the same thread
+//uses the heap.
+class PolluxMessageArena {
+  public:
+    static constexpr size_t BlockSize = 64*1024;
+
+    PolluxMessageArena();
+    ~PolluxMessageArena();
+    PolluxMessageArena(const PolluxMessageArena&) = delete;
+
+    template <typename Message>
+    Message* create() { return google::protobuf::Arena::CreateMessage<Message>(&arena_); }
+
+    bool ownsThreadBlock() const { return ownsThreadBlock_; }
+
+  private:
+    bool                    ownsThreadBlock_  {false};
+    google::protobuf::Arena arena_;
+};
+
+#endif /* __POLLUX_MESSAGE_ARENA_H_ */
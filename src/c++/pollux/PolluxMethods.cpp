@@ -4,6 +4,9 @@
 #include "PolluxMethods.h"
 
 #include <future>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
 
 #include <argparse/argparse.hpp>
 #include <spdlog/spdlog.h>
@@ -14,11 +17,74 @@
 #include "ZebulonPayloadClient.h"
 #include "PolluxPayload.h"
 #include "PolluxPayloadException.h"
+#include "PolluxReplayLog.h"
+#include "PolluxTransportProfile.h"
 
 namespace {
 
 std::promise<void> shutdownRequested;
 
+//Phases of Pollux::Main from its start, in milliseconds, logged and sent to
+//zebulon (startup_timeline report) once the payload is ready.
+class StartupTimeline {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    //sequential phase: from the previous mark to now
+    void mark(const std::string& name) {
+      const auto now{Clock::now()};
+      std::lock_guard<std::mutex> lock(mutex_);
+      phases_.push_back(Phase{name, last_, now});
+      last_ = now;
+    }
+    //concurrent phase
+    void add(const std::string& name, Clock::time_point start) {
+      const auto now{Clock::now()};
+      std::lock_guard<std::mutex> lock(mutex_);
+      phases_.push_back(Phase{name, start, now});
+    }
+    //"name start+duration" entries, then the total
+    std::string getString() const {
+      auto milliseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+      };
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::ostringstream stream;
+      stream << std::fixed << std::setprecision(3);
+      for (const auto& phase: phases_) {
+        stream << phase.name << " " << milliseconds(phase.start - origin_)
+          << "+" << milliseconds(phase.end - phase.start) << ", ";
+      }
+      stream << "total " << milliseconds(last_ - origin_);
+      return stream.str();
+    }
+
+  private:
+    struct Phase {
+      std::string       name  {};
+      Clock::time_point start {};
+      Clock::time_point end   {};
+    };
+
+    const Clock::time_point origin_ {Clock::now()};
+    mutable std::mutex      mutex_;
+    Clock::time_point       last_   {origin_};
+    std::vector<Phase>      phases_ {};
+};
+
+void reportConnectionSetup(
+  ZebulonPayloadClient* client,
+  const PolluxTransportProfile& profile,
+  std::chrono::microseconds setupTime) {
+  if (not profile.warmsUp()) {
+    spdlog::info("Transport profile {}: connections opened by first calls", profile.getName());
+    return;
+  }
+  const double milliseconds = setupTime.count() / 1000.;
+  spdlog::info("Transport profile {}: connected to zebulon in {:.3f} ms", profile.getName(), milliseconds);
+  client->polluxReport("connection_setup_ms", std::to_string(milliseconds));
+}
+
 class PolluxPayloadService final : public pollux::PolluxPayload::Service {
   public:
     PolluxPayloadService() = delete;
@@ -41,14 +107,20 @@ class PolluxPayloadService final : public pollux::PolluxPayload::Service {
       pollux::PolluxControlResponse* response) override {
       spdlog::info("Start payload received");
       try {
+        //older zebulon versions negotiate nothing: other payloads may be
+        //older too, only the baseline is safe (no fragments, sequence
+        //numbers, hedges nor one way stream, no compression)
+        zebulonClient_->setCapabilities(message->has_capabilities()
+          ? message->capabilities() : pollux::PolluxCapabilities());
         polluxPayLoad_->setControl(message->control());
+        setTransportProfile();
         polluxPayLoad_->init(zebulonClient_);
-        std::thread mainLoopThread(&PolluxPayload::loop, polluxPayLoad_, zebulonClient_);
-        mainLoopThread.detach();
+        runLoop(0);
       } catch (const PolluxPayloadException& e) {
         response->set_error(e.getReason());
         return grpc::Status::OK;
       }
+      *response->mutable_capabilities() = zebulonClient_->getCapabilities();
       response->set_info("Payload has been started");
       return grpc::Status::OK;
     }
@@ -59,8 +131,7 @@ class PolluxPayloadService final : public pollux::PolluxPayload::Service {
       pollux::PolluxControlResponse* response) override {
       spdlog::info("Iterate payload received, iteration: {}", message->iteration());
       try {
-        std::thread mainLoopThread(&PolluxPayload::loop, polluxPayLoad_, zebulonClient_);
-        mainLoopThread.detach();
+        runLoop(message->iteration());
       } catch (const PolluxPayloadException& e) {
         response->set_error(e.getReason());
         return grpc::Status::OK;
@@ -74,14 +145,105 @@ class PolluxPayloadService final : public pollux::PolluxPayload::Service {
       const pollux::PolluxMessage* message,
       pollux::PolluxMessageResponse* response) override {
       spdlog::debug("Pollux Transmission received from zebulon");
-      polluxPayLoad_->transmit(message);
+      try {
+        polluxPayLoad_->receive(message);
+      } catch (const std::exception& e) {
+        return getReceiveError(e);
+      }
       response->set_info("Transmit understood");
       return grpc::Status::OK;
     }
+    grpc::Status TransmitBatch(
+      grpc::ServerContext* context,
+      const pollux::PolluxMessageBatch* batch,
+      pollux::PolluxMessageResponse* response) override {
+      spdlog::debug("Pollux Transmission batch of {} messages received from zebulon", batch->messages_size());
+      try {
+        for (const auto& message: batch->messages()) {
+          polluxPayLoad_->receive(&message);
+        }
+      } catch (const std::exception& e) {
+        return getReceiveError(e);
+      }
+      response->set_info("Transmit batch understood");
+      return grpc::Status::OK;
+    }
+    grpc::Status TransmitStream(
+      grpc::ServerContext* context,
+      grpc::ServerReader<pollux::PolluxMessage>* reader,
+      pollux::PolluxMessageResponse* response) override {
+      pollux::PolluxMessage message;
+      size_t nbMessages = 0;
+      try {
+        while (reader->Read(&message)) {
+          polluxPayLoad_->receive(&message);
+          ++nbMessages;
+        }
+      } catch (const std::exception& e) {
+        return getReceiveError(e);
+      }
+      spdlog::debug("Pollux Transmission stream of {} messages received from zebulon", nbMessages);
+      response->set_info("Transmit stream understood");
+      return grpc::Status::OK;
+    }
     void setServer(grpc::Server* server) {
       server_ = server;
     }
   private:
+    //handler errors are rejected by the payload, anything else escaping
+    //a receive fails the call instead of the process
+    static grpc::Status getReceiveError(const std::exception& e) {
+      spdlog::error("Message reception failed: {}", e.what());
+      return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
+    }
+    //Only one loop runs at a time: with a quorum barrier, zebulon may release
+    //the next iteration before a late payload is done with its loop.
+    //Iterations released meanwhile are coalesced into one more loop run
+    //and the payload can catch up using getIteration().
+    void runLoop(uint32_t iteration) {
+      polluxPayLoad_->setIteration(iteration);
+      {
+        std::lock_guard<std::mutex> lock(loopMutex_);
+        if (loopRunning_) {
+          spdlog::info("Loop still running, iteration {} postponed", iteration);
+          loopPending_ = true;
+          return;
+        }
+        loopRunning_ = true;
+      }
+      std::thread mainLoopThread([this]() {
+        while (true) {
+          polluxPayLoad_->loop(zebulonClient_);
+          std::lock_guard<std::mutex> lock(loopMutex_);
+          if (not loopPending_) {
+            loopRunning_ = false;
+            return;
+          }
+          loopPending_ = false;
+        }
+      });
+      mainLoopThread.detach();
+    }
+
+    //user option profile, before the payload first transmits
+    void setTransportProfile() {
+      auto option = polluxPayLoad_->getUserOptionValue(PolluxTransportProfile::OptionName);
+      if (not option) {
+        return;
+      }
+      if (not std::holds_alternative<std::string>(*option)) {
+        throw PolluxPayloadException("user option " + std::string(PolluxTransportProfile::OptionName) + " is not a string");
+      }
+      PolluxTransportProfile profile(std::get<std::string>(*option));
+      if (profile.getName() == zebulonClient_->getTransportProfile()) {
+        return;
+      }
+      reportConnectionSetup(zebulonClient_, profile, zebulonClient_->setTransportProfile(profile));
+    }
+
+    std::mutex            loopMutex_;
+    bool                  loopRunning_    {false};
+    bool                  loopPending_    {false};
     ZebulonPayloadClient* zebulonClient_  {nullptr};
     grpc::Server*         server_         {nullptr};
     PolluxPayload*        polluxPayLoad_;
@@ -90,7 +252,9 @@ class PolluxPayloadService final : public pollux::PolluxPayload::Service {
 }
 
 int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
+  StartupTimeline timeline;
   GOOGLE_PROTOBUF_VERIFY_VERSION;
+  timeline.mark("protobuf");
 
   argparse::ArgumentParser program("polluxapp");
 
@@ -108,6 +272,21 @@ int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
     .default_value(std::string("info"));
   program.add_argument("-t", "--zebulon_ip")
     .help("impose zebulon ip");
+  program.add_argument("--data_channels")
+    .scan<'d', int>()
+    .default_value(1)
+    .help("number of connections large messages are streamed over (default:1)");
+  program.add_argument("--one_way")
+    .default_value(false)
+    .implicit_value(true)
+    .help("small messages are sent without waiting for a response, acknowledged by batches");
+  program.add_argument("--transport_profile")
+    .default_value(std::string("lan"))
+    .help("connections settings: lan/wan/lazy, lazy connecting on first call (default:lan)");
+  program.add_argument("--replay_log")
+    .scan<'d', int>()
+    .default_value(0)
+    .help("MiB of unacknowledged messages kept in memory for restarted payloads, 16 times more spilled to disk (default:0, no replay)");
 
   try {
     program.parse_args(argc, argv);
@@ -124,6 +303,8 @@ int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
     zebulonIP = *zebulonIPOption;
   }
 
+  timeline.mark("arguments");
+
   std::string logFileName(polluxPayload->getName() + "-" + std::to_string(id) + ".log");
   auto myLogger = spdlog::basic_logger_mt("pollux_logger", logFileName.c_str());
   spdlog::flush_on(spdlog::level::info);
@@ -156,8 +337,10 @@ int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
     }
     spdlog::info("Command line: {}", stream.str());
   }
+  timeline.mark("logger");
 
 
+  int status = 0;
   try {
     int localID = id;
 
@@ -175,11 +358,42 @@ int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
     }
     zebulonAddress += ":" + std::to_string(zebulonPort);
 
+    PolluxTransportProfile transportProfile(program.get<std::string>("--transport_profile"));
+
     spdlog::info("creating local client");
     zebulonClient = new ZebulonPayloadClient(
-      grpc::CreateChannel(zebulonAddress, grpc::InsecureChannelCredentials()),
+      ZebulonPayloadClient::createLaneChannel(zebulonAddress),
       localID
     );
+    int nbDataChannels = program.get<int>("--data_channels");
+    if (nbDataChannels > 1) {
+      std::vector<std::shared_ptr<grpc::Channel>> dataChannels;
+      for (int i = 0; i < nbDataChannels; i++) {
+        dataChannels.push_back(ZebulonPayloadClient::createLaneChannel(zebulonAddress));
+      }
+      zebulonClient->setDataChannels(dataChannels);
+    }
+    zebulonClient->setOneWay(program.get<bool>("--one_way"));
+    size_t replayLogSize = std::max(program.get<int>("--replay_log"), 0);
+    if (replayLogSize > 0) {
+      zebulonClient->setReplayLog(std::make_unique<PolluxReplayLog>(replayLogSize*1024*1024, 16*replayLogSize*1024*1024));
+    }
+
+    zebulonClient->setZebulonAddress(zebulonAddress);
+    if (transportProfile.getMaxMessageSize() > 0) {
+      zebulonClient->setMaxMessageSize(transportProfile.getMaxMessageSize());
+    }
+    polluxPayload->setClient(zebulonClient);
+    timeline.mark("client");
+
+    //connections to zebulon are opened while the server starts,
+    //every lane and data channel gets its own connection
+    auto connected = std::async(std::launch::async, [&]() {
+      const auto start{StartupTimeline::Clock::now()};
+      const auto setupTime = zebulonClient->setTransportProfile(transportProfile);
+      timeline.add("connect", start);
+      return setupTime;
+    });
 
     spdlog::info("starting server on " + localServerAddress);
     polluxPayload->setLocalID(localID);
@@ -190,11 +404,7 @@ int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
     //AddListeningPort does not modify this pointer.
     int serverPort = 0;
     builder.AddListeningPort(localServerAddress, grpc::InsecureServerCredentials(), &serverPort);
-    //Explore the following later
-    //builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, 2000);
-    //builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, 1000);
-    //builder.AddChannelArgument(GRPC_ARG_HTTP2_BDP_PROBE, 1);
-    //builder.AddChannelArgument(GRPC_ARG_MAX_CONNECTION_IDLE_MS , 1000);
+    transportProfile.apply(builder);
     builder.RegisterService(&service);
     std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
     service.setServer(server.get());
@@ -204,10 +414,17 @@ int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
       message << "GRPC Server could not be started on " << std::to_string(serverPort);
       throw PolluxPayloadException(message.str());
     }
+    timeline.mark("server");
+    const auto connectionSetupTime = connected.get();
+    timeline.mark("connected");
 
     spdlog::info("contacting zebulon on {} and sending ready message", zebulonAddress);
     //I'm alive send message
     zebulonClient->sendPayloadReady(serverPort);
+    timeline.mark("ready");
+    spdlog::info("Startup timeline (ms): {}", timeline.getString());
+    zebulonClient->polluxReport("startup_timeline", timeline.getString());
+    reportConnectionSetup(zebulonClient, transportProfile, connectionSetupTime);
 
     auto serverWait = [&]() {
       //create and run local server
@@ -230,10 +447,13 @@ int Pollux::Main(int argc, char** argv, PolluxPayload* polluxPayload) {
     // Optional:  Delete all global objects allocated by libprotobuf.
     google::protobuf::ShutdownProtobufLibrary();
   } catch (PolluxPayloadException& e) {
+    //zebulon not reachable, ...: exit status of a failed zebulon call
     spdlog::error("PolluxPayloadException: {}", e.getReason());
+    status = -54;
   } catch (std::exception& e) {
     spdlog::error(e.what());
+    status = -54;
   }
   spdlog::info("End of {}", logFileName);
-  return 0;
+  return status;
 }
@@ -0,0 +1,589 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxNodeAggregator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+namespace {
+
+bool writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (written <= 0) {
+      if (written < 0 and errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool readAll(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t nbRead = ::recv(fd, data, size, 0);
+    if (nbRead <= 0) {
+      if (nbRead < 0 and errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += nbRead;
+    size -= nbRead;
+  }
+  return true;
+}
+
+//frames are length prefixed serialized PolluxNodeFrame
+bool readFrame(int fd, pollux::PolluxNodeFrame& frame) {
+  uint32_t size = 0;
+  if (not readAll(fd, reinterpret_cast<char*>(&size), sizeof(size))) {
+    return false;
+  }
+  std::string buffer(size, '\0');
+  if (not readAll(fd, buffer.data(), size)) {
+    return false;
+  }
+  return frame.ParseFromString(buffer);
+}
+
+void combine(
+  pollux::PolluxMessageDoubleArrayValue* result,
+  const pollux::PolluxMessageDoubleArrayValue& values,
+  PolluxNodeAggregator::ReduceOperation operation) {
+  if (result->values_size() != values.values_size()) {
+    throw PolluxPayloadException("node reduction contributions of different sizes");
+  }
+  for (int i=0; i<values.values_size(); i++) {
+    double value = values.values(i);
+    double& current = *result->mutable_values()->Mutable(i);
+    switch (operation) {
+      case PolluxNodeAggregator::Sum: current += value; break;
+      case PolluxNodeAggregator::Min: current = std::min(current, value); break;
+      case PolluxNodeAggregator::Max: current = std::max(current, value); break;
+    }
+  }
+}
+
+}
+
+PolluxNodeAggregator::Connection::~Connection() {
+  ::close(fd);
+}
+
+PolluxNodeAggregator::PolluxNodeAggregator(
+  const std::string& nodeKey,
+  size_t nbNodePayloads,
+  int localID,
+  const std::vector<int>& partIDs,
+  ZebulonPayloadClient* client,
+  Receiver receiver,
+  std::chrono::milliseconds flushInterval,
+  size_t maxBatchSize):
+  nbNodePayloads_(std::max(nbNodePayloads, size_t(1))),
+  localID_(localID),
+  partIDs_(partIDs),
+  client_(client),
+  receiver_(receiver),
+  flushInterval_(flushInterval),
+  maxBatchSize_(std::max(maxBatchSize, size_t(1))) {
+  socket_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket_ < 0) {
+    throw PolluxPayloadException("node aggregator socket creation failed: " + std::string(strerror(errno)));
+  }
+  //abstract namespace: no file to clean, released when leader exits
+  std::string name = "pollux-node-" + nodeKey;
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  size_t nameSize = std::min(name.size(), sizeof(address.sun_path)-1);
+  std::memcpy(address.sun_path+1, name.data(), nameSize);
+  socklen_t addressSize = offsetof(sockaddr_un, sun_path) + 1 + nameSize;
+
+  if (::bind(socket_, reinterpret_cast<sockaddr*>(&address), addressSize) == 0) {
+    if (::listen(socket_, SOMAXCONN) != 0) {
+      ::close(socket_);
+      throw PolluxPayloadException("node aggregator listen failed: " + std::string(strerror(errno)));
+    }
+    leader_ = true;
+    members_[localID_] = nullptr;
+    acceptThread_ = std::thread(&PolluxNodeAggregator::acceptMembers, this);
+    flushThread_ = std::thread(&PolluxNodeAggregator::flushLoop, this);
+    spdlog::info("Node aggregator: {} is leader of node {}", localID_, nodeKey);
+    return;
+  }
+  if (errno != EADDRINUSE
+    or ::connect(socket_, reinterpret_cast<sockaddr*>(&address), addressSize) != 0) {
+    ::close(socket_);
+    throw PolluxPayloadException("node aggregator could not join node " + nodeKey + ": " + strerror(errno));
+  }
+  leaderConnection_ = std::make_shared<Connection>(socket_);
+  socket_ = -1;
+  pollux::PolluxNodeFrame frame;
+  frame.set_kind(pollux::PolluxNodeFrame::REGISTER);
+  frame.mutable_message()->set_origin(localID_);
+  sendFrame(*leaderConnection_, frame);
+  threads_.emplace_back(&PolluxNodeAggregator::readLeader, this);
+  spdlog::info("Node aggregator: {} is member of node {}", localID_, nodeKey);
+}
+
+PolluxNodeAggregator::PolluxNodeAggregator(PolluxPayload& payload, ZebulonPayloadClient* client, size_t nbNodePayloads):
+  PolluxNodeAggregator(
+    client->getZebulonAddress(),
+    nbNodePayloads,
+    payload.getLocalID(),
+    [&payload]() {
+      auto ids = payload.getOtherIDs();
+      ids.push_back(payload.getLocalID());
+      return ids;
+    }(),
+    client,
+    [&payload](const pollux::PolluxMessage* message) { payload.receive(message); })
+{}
+
+PolluxNodeAggregator::~PolluxNodeAggregator() {
+  if (leader_) {
+    flush();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    for (const auto& [id, connection]: members_) {
+      if (connection) {
+        ::shutdown(connection->fd, SHUT_RDWR);
+      }
+    }
+  }
+  ::shutdown(leader_ ? socket_ : leaderConnection_->fd, SHUT_RDWR);
+  released_.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(batchMutex_);
+    batchReady_.notify_all();
+  }
+  if (acceptThread_.joinable()) {
+    acceptThread_.join();
+  }
+  if (flushThread_.joinable()) {
+    flushThread_.join();
+  }
+  for (auto& thread: threads_) {
+    thread.join();
+  }
+  if (leader_) {
+    ::close(socket_);
+  }
+}
+
+std::vector<int> PolluxNodeAggregator::getLocalIDs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<int> ids;
+  for (const auto& [id, connection]: members_) {
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+void PolluxNodeAggregator::sendFrame(Connection& connection, const pollux::PolluxNodeFrame& frame) {
+  std::string buffer;
+  frame.SerializeToString(&buffer);
+  uint32_t size = buffer.size();
+  std::lock_guard<std::mutex> lock(connection.writeMutex);
+  if (not writeAll(connection.fd, reinterpret_cast<const char*>(&size), sizeof(size))
+    or not writeAll(connection.fd, buffer.data(), buffer.size())) {
+    spdlog::error("Node aggregator: could not write frame: {}", strerror(errno));
+  }
+}
+
+uint32_t PolluxNodeAggregator::sendPayloadLoopReadyForNextIteration(uint32_t iteration) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (stopped_) {
+    lock.unlock();
+    return client_->sendPayloadLoopReadyForNextIteration(iteration);
+  }
+  uint64_t generation = generation_;
+  if (leader_) {
+    if (ready_.empty()) {
+      readyIteration_ = iteration;
+    }
+    ready_.insert(localID_);
+    checkReadyLocked(lock);
+  } else {
+    lock.unlock();
+    //reported by the leader: what the barrier hooks send goes first
+    if (client_->getCapabilities().nodebarrier()) {
+      client_->prepareBarrier();
+    }
+    pollux::PolluxNodeFrame frame;
+    frame.set_kind(pollux::PolluxNodeFrame::READY);
+    frame.set_iteration(iteration);
+    sendFrame(*leaderConnection_, frame);
+    lock.lock();
+  }
+  released_.wait(lock, [&]() { return generation_ != generation or stopped_; });
+  //leader is gone or zebulon takes no node barrier: report alone
+  if (generation_ == generation or reportGeneration_ == generation_) {
+    lock.unlock();
+    return client_->sendPayloadLoopReadyForNextIteration(iteration);
+  }
+  return releasedIteration_;
+}
+
+void PolluxNodeAggregator::arrive(int id, uint32_t iteration) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (ready_.empty()) {
+    readyIteration_ = iteration;
+  }
+  ready_.insert(id);
+  checkReadyLocked(lock);
+}
+
+void PolluxNodeAggregator::checkReadyLocked(std::unique_lock<std::mutex>& lock) {
+  if (ready_.empty() or not isCompleteLocked()) {
+    return;
+  }
+  for (const auto& [id, connection]: members_) {
+    if (not ready_.count(id)) {
+      return;
+    }
+  }
+  ZebulonPayloadClient::Destinations ids(ready_.begin(), ready_.end());
+  uint32_t iteration = readyIteration_;
+  ready_.clear();
+  lock.unlock();
+  //data sent during the iteration goes before the barrier
+  flush();
+  pollux::PolluxNodeFrame frame;
+  if (client_->getCapabilities().nodebarrier()) {
+    uint32_t released = client_->sendPayloadLoopReadyForNextIteration(iteration, ids);
+    spdlog::debug("Node aggregator: {} payloads ready for iteration {}, released: {}", ids.size(), iteration, released);
+    frame.set_kind(pollux::PolluxNodeFrame::RELEASED);
+    frame.set_iteration(released);
+    lock.lock();
+    releasedIteration_ = released;
+    ++generation_;
+  } else {
+    frame.set_kind(pollux::PolluxNodeFrame::REPORT);
+    lock.lock();
+    reportGeneration_ = ++generation_;
+  }
+  released_.notify_all();
+  std::vector<std::shared_ptr<Connection>> connections;
+  for (auto id: ids) {
+    auto mit = members_.find(id);
+    if (mit != members_.end() and mit->second) {
+      connections.push_back(mit->second);
+    }
+  }
+  lock.unlock();
+  for (const auto& connection: connections) {
+    sendFrame(*connection, frame);
+  }
+  lock.lock();
+}
+
+void PolluxNodeAggregator::transmit(
+  const ZebulonPayloadClient::Destinations& destinations,
+  pollux::PolluxMessage& message) {
+  message.set_origin(localID_);
+  message.clear_destinations();
+  for (auto destination: destinations) {
+    message.add_destinations(destination);
+  }
+  bool direct = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    direct = stopped_;
+  }
+  if (direct) {
+    client_->transmit(destinations, message);
+  } else if (leader_) {
+    route(message);
+  } else {
+    pollux::PolluxNodeFrame frame;
+    frame.set_kind(pollux::PolluxNodeFrame::TRANSMIT);
+    frame.mutable_message()->Swap(&message);
+    sendFrame(*leaderConnection_, frame);
+    message.Swap(frame.mutable_message());
+  }
+}
+
+ZebulonPayloadClient::MessageSender PolluxNodeAggregator::getMessageSender() {
+  return [this](const ZebulonPayloadClient::Destinations& destinations, pollux::PolluxMessage& message) {
+    transmit(destinations, message);
+  };
+}
+
+void PolluxNodeAggregator::route(pollux::PolluxMessage& message) {
+  std::vector<int> targets;
+  if (message.destinations().empty()) {
+    for (auto id: partIDs_) {
+      if (id != int(message.origin())) {
+        targets.push_back(id);
+      }
+    }
+  } else {
+    targets.assign(message.destinations().begin(), message.destinations().end());
+  }
+  std::vector<std::shared_ptr<Connection>> localConnections;
+  bool toLeader = false;
+  ZebulonPayloadClient::Destinations remoteDestinations;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto target: targets) {
+      auto mit = members_.find(target);
+      if (mit == members_.end()) {
+        remoteDestinations.push_back(target);
+      } else if (not mit->second) {
+        toLeader = true;
+      } else {
+        localConnections.push_back(mit->second);
+      }
+    }
+  }
+  if (not localConnections.empty()) {
+    pollux::PolluxNodeFrame frame;
+    frame.set_kind(pollux::PolluxNodeFrame::DELIVER);
+    *frame.mutable_message() = message;
+    for (const auto& connection: localConnections) {
+      sendFrame(*connection, frame);
+    }
+  }
+  if (toLeader) {
+    receiver_(&message);
+  }
+  if (remoteDestinations.empty()) {
+    return;
+  }
+  //remote side gets an explicit destination list: local payloads are served
+  pollux::PolluxMessage remote(message);
+  remote.clear_destinations();
+  for (auto destination: remoteDestinations) {
+    remote.add_destinations(destination);
+  }
+  bool full = false;
+  {
+    std::lock_guard<std::mutex> lock(batchMutex_);
+    batch_.add_messages()->Swap(&remote);
+    full = size_t(batch_.messages_size()) >= maxBatchSize_;
+  }
+  if (full) {
+    flush();
+  }
+}
+
+void PolluxNodeAggregator::flush() {
+  std::lock_guard<std::mutex> flushLock(flushMutex_);
+  pollux::PolluxMessageBatch batch;
+  {
+    std::lock_guard<std::mutex> lock(batchMutex_);
+    if (batch_.messages().empty()) {
+      return;
+    }
+    batch.Swap(&batch_);
+  }
+  client_->transmitBatch(batch);
+}
+
+void PolluxNodeAggregator::flushLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(batchMutex_);
+      batchReady_.wait_for(lock, flushInterval_);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopped_) {
+        return;
+      }
+    }
+    flush();
+  }
+}
+
+void PolluxNodeAggregator::reduce(
+  const ZebulonPayloadClient::Destinations& destinations,
+  const std::string& key,
+  const ZebulonPayloadClient::DoubleArray& values,
+  ReduceOperation operation) {
+  pollux::PolluxMessage message;
+  message.set_key(key);
+  for (auto destination: destinations) {
+    message.add_destinations(destination);
+  }
+  auto doubleArray = message.mutable_doublearrayvalue();
+  for (auto value: values) {
+    doubleArray->add_values(value);
+  }
+  if (leader_) {
+    contribute(localID_, message, operation);
+    return;
+  }
+  pollux::PolluxNodeFrame frame;
+  frame.set_kind(pollux::PolluxNodeFrame::REDUCE);
+  frame.mutable_message()->Swap(&message);
+  frame.set_reduceoperation(static_cast<pollux::PolluxNodeFrame::ReduceOperation>(operation));
+  sendFrame(*leaderConnection_, frame);
+}
+
+void PolluxNodeAggregator::contribute(int id, const pollux::PolluxMessage& message, ReduceOperation operation) {
+  std::vector<pollux::PolluxMessage> completed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& reduction = reductions_[message.key()];
+    if (reduction.contributors.empty()) {
+      reduction.message = message;
+      reduction.message.set_origin(localID_);
+      reduction.operation = operation;
+    } else {
+      combine(reduction.message.mutable_doublearrayvalue(), message.doublearrayvalue(), reduction.operation);
+    }
+    reduction.contributors.insert(id);
+    checkReductionsLocked(completed);
+  }
+  for (auto& reduced: completed) {
+    route(reduced);
+  }
+}
+
+void PolluxNodeAggregator::checkReductionsLocked(std::vector<pollux::PolluxMessage>& completed) {
+  if (not isCompleteLocked()) {
+    return;
+  }
+  for (auto rit = reductions_.begin(); rit != reductions_.end(); ) {
+    const auto& contributors = rit->second.contributors;
+    bool done = std::all_of(members_.begin(), members_.end(),
+      [&contributors](const auto& member) { return contributors.count(member.first) > 0; });
+    if (done) {
+      completed.push_back(std::move(rit->second.message));
+      rit = reductions_.erase(rit);
+    } else {
+      ++rit;
+    }
+  }
+}
+
+void PolluxNodeAggregator::acceptMembers() {
+  while (true) {
+    int fd = ::accept4(socket_, nullptr, nullptr, SOCK_CLOEXEC);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      return;
+    }
+    if (fd < 0) {
+      if (errno == EINTR or errno == ECONNABORTED) {
+        continue;
+      }
+      spdlog::error("Node aggregator: accept failed: {}", strerror(errno));
+      return;
+    }
+    threads_.emplace_back(&PolluxNodeAggregator::readMember, this, std::make_shared<Connection>(fd));
+  }
+}
+
+void PolluxNodeAggregator::readMember(std::shared_ptr<Connection> connection) {
+  int id = -1;
+  pollux::PolluxNodeFrame frame;
+  while (readFrame(connection->fd, frame)) {
+    //frames are attributed to the registered member only
+    if ((id < 0) != (frame.kind() == pollux::PolluxNodeFrame::REGISTER)) {
+      spdlog::error("Node aggregator: unexpected frame {} from {}, connection closed", int(frame.kind()), id);
+      break;
+    }
+    if (frame.kind() == pollux::PolluxNodeFrame::REGISTER) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (members_.count(frame.message().origin())) {
+        spdlog::error("Node aggregator: {} registered twice, connection closed", frame.message().origin());
+        break;
+      }
+      id = frame.message().origin();
+      members_[id] = connection;
+      continue;
+    }
+    try {
+      switch (frame.kind()) {
+        case pollux::PolluxNodeFrame::READY:
+          arrive(id, frame.iteration());
+          break;
+        case pollux::PolluxNodeFrame::TRANSMIT:
+          frame.mutable_message()->set_origin(id);
+          route(*frame.mutable_message());
+          break;
+        case pollux::PolluxNodeFrame::REDUCE:
+          contribute(id, frame.message(), static_cast<ReduceOperation>(frame.reduceoperation()));
+          break;
+        default:
+          spdlog::error("Node aggregator: unexpected frame {} from {}", int(frame.kind()), id);
+          break;
+      }
+    } catch (const PolluxPayloadException& e) {
+      spdlog::error("Node aggregator: {}", e.getReason());
+    }
+  }
+  //member is gone: it must not block the others
+  std::vector<pollux::PolluxMessage> completed;
+  if (id >= 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    members_.erase(id);
+    ready_.erase(id);
+    ++nbDeparted_;
+    if (not stopped_) {
+      checkReductionsLocked(completed);
+      checkReadyLocked(lock);
+    }
+  }
+  for (auto& reduced: completed) {
+    route(reduced);
+  }
+  //the connection closes once the last writer released it
+}
+
+void PolluxNodeAggregator::readLeader() {
+  pollux::PolluxNodeFrame frame;
+  while (readFrame(leaderConnection_->fd, frame)) {
+    switch (frame.kind()) {
+      case pollux::PolluxNodeFrame::DELIVER:
+        receiver_(&frame.message());
+        break;
+      case pollux::PolluxNodeFrame::RELEASED:
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          releasedIteration_ = frame.iteration();
+          ++generation_;
+        }
+        released_.notify_all();
+        break;
+      case pollux::PolluxNodeFrame::REPORT:
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          reportGeneration_ = ++generation_;
+        }
+        released_.notify_all();
+        break;
+      default:
+        spdlog::error("Node aggregator: unexpected frame {} from leader", int(frame.kind()));
+        break;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (not stopped_) {
+    spdlog::warn("Node aggregator: leader is gone, {} now talks directly to zebulon", localID_);
+    stopped_ = true;
+  }
+  released_.notify_all();
+}
@@ -0,0 +1,146 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_NODE_AGGREGATOR_H_
+#define __POLLUX_NODE_AGGREGATOR_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "ZebulonPayloadClient.h"
+
+class PolluxPayload;
+
+//Two level synchronization for many payloads per node.
+//Co-located payloads elect a node leader: the first one binding the node
+//Unix socket (abstract namespace, keyed by the zebulon address).
+//Other payloads (members) connect to it and send it their barrier arrivals,
+//reduction contributions and outgoing messages.
+//The leader:
+// - reports all local arrivals to zebulon with one
+//   PayloadLoopReadyForNextIteration call (without the nodeBarrier
+//   capability, once the node data was sent every payload reports alone),
+// - combines local reductions into one message,
+// - delivers messages between co-located payloads locally and batches
+//   the others in TransmitBatch calls.
+//Cross node RPCs are divided by the number of payloads per node.
+class PolluxNodeAggregator {
+  public:
+    enum ReduceOperation { Sum, Min, Max };
+    using Receiver = std::function<void(const pollux::PolluxMessage* message)>;
+
+    //nodeKey: co-located payloads sharing the same key are aggregated
+    //nbNodePayloads: co-located payloads, leader included. Barriers and
+    //reductions wait for all of them to register (or leave).
+    //partIDs: all payloads IDs (broadcast expansion)
+    //receiver: called for messages delivered locally
+    PolluxNodeAggregator(
+      const std::string& nodeKey,
+      size_t nbNodePayloads,
+      int localID,
+      const std::vector<int>& partIDs,
+      ZebulonPayloadClient* client,
+      Receiver receiver,
+      std::chrono::milliseconds flushInterval = std::chrono::milliseconds(2),
+      size_t maxBatchSize = 256);
+    //convenience constructor: node key is the zebulon address,
+    //locally delivered messages reach payload receive
+    PolluxNodeAggregator(PolluxPayload& payload, ZebulonPayloadClient* client, size_t nbNodePayloads);
+    PolluxNodeAggregator(const PolluxNodeAggregator&) = delete;
+    ~PolluxNodeAggregator();
+
+    bool isLeader() const { return leader_; }
+    //payloads aggregated by the leader (leader only)
+    std::vector<int> getLocalIDs() const;
+
+    //replaces ZebulonPayloadClient::sendPayloadLoopReadyForNextIteration:
+    //blocks until all co-located payloads are ready and zebulon answered
+    uint32_t sendPayloadLoopReadyForNextIteration(uint32_t iteration);
+
+    //replaces ZebulonPayloadClient::transmit, empty destinations is broadcast
+    void transmit(const ZebulonPayloadClient::Destinations& destinations, pollux::PolluxMessage& message);
+    ZebulonPayloadClient::MessageSender getMessageSender();
+
+    //node level reduction: once every co-located payload contributed to key,
+    //the leader sends one message with the element wise combined values
+    void reduce(
+      const ZebulonPayloadClient::Destinations& destinations,
+      const std::string& key,
+      const ZebulonPayloadClient::DoubleArray& values,
+      ReduceOperation operation);
+
+    //leader: send batched remote messages now
+    void flush();
+
+  private:
+    //member connection, closed once its reader and every writer released it
+    struct Connection {
+      explicit Connection(int fd): fd(fd) {}
+      Connection(const Connection&) = delete;
+      ~Connection();
+      const int   fd;
+      //frames of concurrent writers are not interleaved
+      std::mutex  writeMutex;
+    };
+    struct Reduction {
+      pollux::PolluxMessage message     {};
+      ReduceOperation       operation   {Sum};
+      std::set<int>         contributors {};
+    };
+
+    //leader side
+    void acceptMembers();
+    void readMember(std::shared_ptr<Connection> connection);
+    void arrive(int id, uint32_t iteration);
+    void route(pollux::PolluxMessage& message);
+    void contribute(int id, const pollux::PolluxMessage& message, ReduceOperation operation);
+    //lock must be held
+    //all expected co-located payloads registered or left
+    bool isCompleteLocked() const { return members_.size() + nbDeparted_ >= nbNodePayloads_; }
+    void checkReadyLocked(std::unique_lock<std::mutex>& lock);
+    void checkReductionsLocked(std::vector<pollux::PolluxMessage>& completed);
+    void flushLoop();
+    //member side
+    void readLeader();
+    void sendFrame(Connection& connection, const pollux::PolluxNodeFrame& frame);
+
+    size_t                              nbNodePayloads_   {1};
+    int                                 localID_          {-1};
+    std::vector<int>                    partIDs_          {};
+    ZebulonPayloadClient*               client_           {nullptr};
+    Receiver                            receiver_         {};
+    std::chrono::milliseconds           flushInterval_    {2};
+    size_t                              maxBatchSize_     {256};
+    bool                                leader_           {false};
+    //leader: listening socket
+    int                                 socket_           {-1};
+    //member: connection to the leader
+    std::shared_ptr<Connection>         leaderConnection_ {};
+    bool                                stopped_          {false};
+    mutable std::mutex                  mutex_;
+    std::condition_variable             released_;
+    //leader: co-located payload id -> connection (none for leader itself)
+    std::map<int, std::shared_ptr<Connection>> members_   {};
+    //registered members that left
+    size_t                              nbDeparted_       {0};
+    std::set<int>                       ready_            {};
+    uint32_t                            readyIteration_   {0};
+    std::map<std::string, Reduction>    reductions_       {};
+    //released iteration and its generation, used by waiting payload
+    uint32_t                            releasedIteration_ {0};
+    uint64_t                            generation_       {0};
+    //released generation without node barrier: the waiting payload reports
+    uint64_t                            reportGeneration_ {0};
+    std::mutex                          flushMutex_;
+    std::mutex                          batchMutex_;
+    std::condition_variable             batchReady_;
+    pollux::PolluxMessageBatch          batch_            {};
+    std::thread                         acceptThread_     {};
+    std::thread                         flushThread_      {};
+    std::vector<std::thread>            threads_          {};
+};
+
+#endif /* __POLLUX_NODE_AGGREGATOR_H_ */
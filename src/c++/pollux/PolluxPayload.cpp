@@ -3,8 +3,39 @@
 
 #include "PolluxPayload.h"
 
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
 #include "PolluxPayloadException.h"
 
+namespace {
+
+//routes called up the stack of this thread: their removal from one of their
+//own calls does not wait for it
+thread_local std::vector<const void*> runningRoutes;
+
+}
+
+class PolluxPayload::RouteCall {
+  public:
+    RouteCall(PolluxPayload& payload, Route& route): payload_(payload), route_(route) {
+      route_.nbRunning++;
+      runningRoutes.push_back(&route_);
+    }
+    ~RouteCall() {
+      runningRoutes.pop_back();
+      route_.nbRunning--;
+      if (payload_.nbRemovals_ > 0) {
+        std::lock_guard<std::mutex> lock(payload_.handlersMutex_);
+        payload_.routesReleased_.notify_all();
+      }
+    }
+  private:
+    PolluxPayload&  payload_;
+    Route&          route_;
+};
+
 void PolluxPayload::setControl(const pollux::PolluxControl& control) {
   control_ = control;
   for (auto id: control_.partids()) {
@@ -28,6 +59,130 @@ void PolluxPayload::setControl(const pollux::PolluxControl& control) {
         throw PolluxPayloadException("Unset user option value");
     }
   }
+  if (client_) {
+    client_->setPeers(otherIDs_);
+    client_->setTransmissionTimeout(std::chrono::milliseconds(control_.transmissiontimeout()));
+    //subscriptions made before peers were known
+    std::set<std::string> subscriptions = getSubscriptions();
+    if (not subscriptions.empty()) {
+      client_->publishSubscriptions(subscriptions);
+    }
+  }
+}
+
+void PolluxPayload::setClient(ZebulonPayloadClient* client) {
+  if (client_) {
+    client_->removeBarrierHook(acknowledgeHookID_);
+  }
+  client_ = client;
+  //acknowledgements short of an AckInterval go out at the barrier
+  acknowledgeHookID_ = client_->addBarrierHook([this]() { acknowledgeDelivered(); });
+  for (const auto& key: unorderedKeys_) {
+    client_->setUnordered(key);
+  }
+  registerMessageHandler(ZebulonPayloadClient::SubscriptionsKey,
+    [client](const pollux::PolluxMessage* message) {
+      pollux::PolluxSubscriptions subscriptions;
+      if (message->value_case() != pollux::PolluxMessage::kBytesValue
+        or not subscriptions.ParseFromString(message->bytesvalue())) {
+        throw PolluxPayloadException("malformed subscriptions from: " + std::to_string(message->origin()));
+      }
+      client->setSubscriptions(message->origin(), subscriptions);
+    });
+  registerMessageHandler(ZebulonPayloadClient::AckKey,
+    [client](const pollux::PolluxMessage* message) {
+      client->acknowledge(message->origin(), message->int64value());
+    });
+  //the restarted origin sequences start over, then it gets what it missed
+  registerMessageHandler(ZebulonPayloadClient::ReplayKey,
+    [this, client](const pollux::PolluxMessage* message) {
+      restartOrder(message->origin(), message->incarnation());
+      client->replay(message->origin());
+    });
+  registerMessageHandler(ZebulonPayloadClient::ReplayStartKey,
+    [this](const pollux::PolluxMessage* message) {
+      resetOrder(message->origin(), message->int64value());
+      {
+        std::lock_guard<std::mutex> lock(replayMutex_);
+        replayStarts_.insert(message->origin());
+      }
+      replayStarted_.notify_all();
+    });
+  registerMessageHandler(ZebulonPayloadClient::FragmentKey,
+    [this, client](const pollux::PolluxMessage* fragment) {
+      pollux::PolluxMessage message;
+      if (client->addFragment(*fragment, message)) {
+        receive(&message);
+      }
+    });
+}
+
+void PolluxPayload::subscribe(const std::string& key) {
+  std::set<std::string> subscriptions;
+  {
+    std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+    if (not subscriptions_.insert(key).second) {
+      return;
+    }
+    subscriptions = subscriptions_;
+  }
+  if (client_) {
+    client_->publishSubscriptions(subscriptions);
+  }
+}
+
+void PolluxPayload::unsubscribe(const std::string& key) {
+  std::set<std::string> subscriptions;
+  {
+    std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+    if (subscriptions_.erase(key) == 0) {
+      return;
+    }
+    subscriptions = subscriptions_;
+  }
+  if (client_) {
+    client_->publishSubscriptions(subscriptions);
+  }
+}
+
+void PolluxPayload::requestReplay(std::chrono::milliseconds timeout) {
+  if (not client_) {
+    throw PolluxPayloadException("replay requested without client");
+  }
+  {
+    std::lock_guard<std::mutex> lock(replayMutex_);
+    replayStarts_.clear();
+  }
+  client_->transmit(ZebulonPayloadClient::ReplayKey, int64_t(0));
+  //the first messages sent after init() must not reach a payload that did
+  //not start this origin sequences over yet
+  std::unique_lock<std::mutex> lock(replayMutex_);
+  auto answered = [this]() {
+    return std::all_of(otherIDs_.begin(), otherIDs_.end(),
+      [this](int id) { return replayStarts_.find(id) != replayStarts_.end(); });
+  };
+  if (replayStarted_.wait_for(lock, timeout, answered)) {
+    return;
+  }
+  std::string silent;
+  for (auto id: otherIDs_) {
+    if (replayStarts_.find(id) == replayStarts_.end()) {
+      silent += (silent.empty() ? "" : ", ") + std::to_string(id);
+    }
+  }
+  throw PolluxPayloadException("replay not started by: " + silent);
+}
+
+void PolluxPayload::setUnordered(const std::string& key) {
+  unorderedKeys_.insert(key);
+  if (client_) {
+    client_->setUnordered(key);
+  }
+}
+
+std::set<std::string> PolluxPayload::getSubscriptions() const {
+  std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+  return subscriptions_;
 }
 
 PolluxPayload::UserOptionValue* PolluxPayload::getUserOptionValue(const std::string& name) {
@@ -37,3 +192,380 @@ PolluxPayload::UserOptionValue* PolluxPayload::getUserOptionValue(const std::str
   }
   return nullptr;
 }
+
+uint32_t PolluxPayload::getStaleness() const {
+  if (control_.staleness() > 0) {
+    return control_.staleness();
+  }
+  auto uoit = userOptions_.find("staleness");
+  if (uoit != userOptions_.end() and uoit->second.index() == UserOptionType::LONG) {
+    return static_cast<uint32_t>(std::max(std::get<UserOptionType::LONG>(uoit->second), long(0)));
+  }
+  return 0;
+}
+
+void PolluxPayload::registerMessageHandler(const std::string& key, MessageHandler handler) {
+  setRoute(&Routing::handlers, key, std::move(handler));
+}
+
+void PolluxPayload::unregisterMessageHandler(const std::string& key) {
+  eraseRoute(&Routing::handlers, key);
+}
+
+void PolluxPayload::registerPrefixHandler(const std::string& prefix, MessageHandler handler) {
+  setRoute(&Routing::prefixHandlers, prefix, std::move(handler));
+}
+
+void PolluxPayload::unregisterPrefixHandler(const std::string& prefix) {
+  eraseRoute(&Routing::prefixHandlers, prefix);
+}
+
+void PolluxPayload::setRoute(Routes Routing::* routes, const std::string& key, MessageHandler handler) {
+  std::unique_lock<std::mutex> lock(handlersMutex_);
+  auto routing = std::make_shared<Routing>(*routing_);
+  auto route = std::make_shared<Route>(std::move(handler));
+  std::swap(((*routing).*routes)[key], route);
+  routing_ = std::move(routing);
+  if (route) {
+    removeRoute(lock, *route);
+  }
+}
+
+void PolluxPayload::eraseRoute(Routes Routing::* routes, const std::string& key) {
+  std::unique_lock<std::mutex> lock(handlersMutex_);
+  if (((*routing_).*routes).count(key) == 0) {
+    return;
+  }
+  auto routing = std::make_shared<Routing>(*routing_);
+  auto rit = ((*routing).*routes).find(key);
+  auto route = rit->second;
+  ((*routing).*routes).erase(rit);
+  routing_ = std::move(routing);
+  removeRoute(lock, *route);
+}
+
+std::shared_ptr<const PolluxPayload::Routing> PolluxPayload::getRouting() {
+  std::lock_guard<std::mutex> lock(handlersMutex_);
+  return routing_;
+}
+
+size_t PolluxPayload::addMessageObserver(MessageHandler observer) {
+  return addObserver(&Routing::observers, std::move(observer));
+}
+
+void PolluxPayload::removeMessageObserver(size_t observerID) {
+  removeObserver(&Routing::observers, observerID);
+}
+
+size_t PolluxPayload::addSkipObserver(SkipObserver observer) {
+  //the message only carries the origin and count to the observer
+  return addObserver(&Routing::skipObservers, [observer](const pollux::PolluxMessage* message) {
+    observer(message->origin(), size_t(message->int64value()));
+  });
+}
+
+void PolluxPayload::removeSkipObserver(size_t observerID) {
+  removeObserver(&Routing::skipObservers, observerID);
+}
+
+size_t PolluxPayload::addObserver(Observers Routing::* observers, MessageHandler observer) {
+  std::lock_guard<std::mutex> lock(handlersMutex_);
+  auto routing = std::make_shared<Routing>(*routing_);
+  ((*routing).*observers).emplace_back(nextObserverID_, std::make_shared<Route>(std::move(observer)));
+  routing_ = std::move(routing);
+  return nextObserverID_++;
+}
+
+void PolluxPayload::removeObserver(Observers Routing::* observers, size_t observerID) {
+  std::unique_lock<std::mutex> lock(handlersMutex_);
+  auto isRemoved = [observerID](const auto& observer) { return observer.first == observerID; };
+  if (std::none_of(((*routing_).*observers).begin(), ((*routing_).*observers).end(), isRemoved)) {
+    return;
+  }
+  auto routing = std::make_shared<Routing>(*routing_);
+  auto& routes = (*routing).*observers;
+  auto oit = std::find_if(routes.begin(), routes.end(), isRemoved);
+  auto route = oit->second;
+  routes.erase(oit);
+  routing_ = std::move(routing);
+  removeRoute(lock, *route);
+}
+
+void PolluxPayload::notifySkipped(int origin, size_t nbSkipped) {
+  auto routing = getRouting();
+  if (routing->skipObservers.empty()) {
+    return;
+  }
+  pollux::PolluxMessage message;
+  message.set_origin(origin);
+  message.set_int64value(int64_t(nbSkipped));
+  for (const auto& [observerID, observer]: routing->skipObservers) {
+    call(*observer, &message);
+  }
+}
+
+void PolluxPayload::removeRoute(std::unique_lock<std::mutex>& lock, Route& route) {
+  //both sides count themselves first: either the call sees the removal or
+  //the removal sees the call running
+  nbRemovals_++;
+  route.removed = true;
+  size_t nbOwn = std::count(runningRoutes.begin(), runningRoutes.end(), &route);
+  routesReleased_.wait(lock, [&route, nbOwn]() { return route.nbRunning <= nbOwn; });
+  nbRemovals_--;
+}
+
+void PolluxPayload::call(Route& route, const pollux::PolluxMessage* message) {
+  RouteCall call(*this, route);
+  if (not route.removed) {
+    route.handler(message);
+  }
+}
+
+void PolluxPayload::Registrations::registerMessageHandler(
+  PolluxPayload& payload,
+  const std::string& key,
+  MessageHandler handler) {
+  payload_ = &payload;
+  payload.registerMessageHandler(key, handler);
+  keys_.push_back(key);
+}
+
+void PolluxPayload::Registrations::registerPrefixHandler(
+  PolluxPayload& payload,
+  const std::string& prefix,
+  MessageHandler handler) {
+  payload_ = &payload;
+  payload.registerPrefixHandler(prefix, handler);
+  prefixes_.push_back(prefix);
+}
+
+void PolluxPayload::Registrations::addMessageObserver(PolluxPayload& payload, MessageHandler observer) {
+  payload_ = &payload;
+  observerIDs_.push_back(payload.addMessageObserver(observer));
+}
+
+void PolluxPayload::Registrations::addSkipObserver(PolluxPayload& payload, SkipObserver observer) {
+  payload_ = &payload;
+  skipObserverIDs_.push_back(payload.addSkipObserver(observer));
+}
+
+void PolluxPayload::Registrations::clear() {
+  if (not payload_) {
+    return;
+  }
+  for (const auto& key: keys_) {
+    payload_->unregisterMessageHandler(key);
+  }
+  for (const auto& prefix: prefixes_) {
+    payload_->unregisterPrefixHandler(prefix);
+  }
+  for (auto observerID: observerIDs_) {
+    payload_->removeMessageObserver(observerID);
+  }
+  for (auto observerID: skipObserverIDs_) {
+    payload_->removeSkipObserver(observerID);
+  }
+  keys_.clear();
+  prefixes_.clear();
+  observerIDs_.clear();
+  skipObserverIDs_.clear();
+}
+
+uint64_t PolluxPayload::getSequence(const pollux::PolluxMessage* message) const {
+  const auto& destinations = message->destinations();
+  auto dit = std::find(destinations.begin(), destinations.end(), uint32_t(localID_));
+  size_t index = std::distance(destinations.begin(), dit);
+  return index < size_t(message->sequences_size()) ? message->sequences(index) : 0;
+}
+
+void PolluxPayload::receive(const pollux::PolluxMessage* message) {
+  uint64_t sequence = getSequence(message);
+  if (sequence == 0) {
+    dispatch(message);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(orderMutex_);
+  auto& order = orders_[message->origin()];
+  if (not checkIncarnationLocked(order, message->origin(), message->incarnation())) {
+    return;
+  }
+  if (sequence < order.expected or order.pending.find(sequence) != order.pending.end()) {
+    //duplicate
+    return;
+  }
+  if (sequence != order.expected or order.delivering) {
+    //the delivering thread will pick it up
+    if (sequence != order.expected) {
+      ++nbReordered_;
+    }
+    if (order.pending.empty()) {
+      order.progress = std::chrono::steady_clock::now();
+    }
+    order.pending.emplace(sequence, *message);
+    if (order.delivering or not isGapExpiredLocked(order)) {
+      return;
+    }
+    uint64_t next = order.pending.begin()->first;
+    spdlog::warn("Messages {} to {} from {} missing since {} ms: skipped", order.expected, next - 1,
+      message->origin(), std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - order.progress).count());
+    size_t nbSkipped = next - order.expected;
+    nbSkipped_ += nbSkipped;
+    order.expected = next;
+    deliverLocked(lock, message->origin(), order, nullptr);
+    lock.unlock();
+    notifySkipped(message->origin(), nbSkipped);
+    return;
+  }
+  deliverLocked(lock, message->origin(), order, message);
+}
+
+void PolluxPayload::setReorderLimits(size_t maxPending, std::chrono::milliseconds timeout) {
+  std::lock_guard<std::mutex> lock(orderMutex_);
+  maxPending_ = std::max(maxPending, size_t(1));
+  reorderTimeout_ = timeout;
+}
+
+bool PolluxPayload::isGapExpiredLocked(const OriginOrder& order) const {
+  return order.pending.size() > maxPending_ or (reorderTimeout_.count() > 0
+    and std::chrono::steady_clock::now() - order.progress > reorderTimeout_);
+}
+
+bool PolluxPayload::checkIncarnationLocked(OriginOrder& order, int origin, uint64_t incarnation) {
+  //0: sender not telling its incarnation
+  if (incarnation == 0 or incarnation == order.incarnation) {
+    return true;
+  }
+  if (order.retired.find(incarnation) != order.retired.end()) {
+    return false;
+  }
+  if (order.incarnation == 0) {
+    order.incarnation = incarnation;
+    return true;
+  }
+  restartOrderLocked(order, origin, incarnation);
+  return true;
+}
+
+void PolluxPayload::restartOrder(int origin, uint64_t incarnation) {
+  std::lock_guard<std::mutex> lock(orderMutex_);
+  auto& order = orders_[origin];
+  if (incarnation == 0 or incarnation != order.incarnation) {
+    restartOrderLocked(order, origin, incarnation);
+  }
+}
+
+void PolluxPayload::restartOrderLocked(OriginOrder& order, int origin, uint64_t incarnation) {
+  spdlog::info("Payload {} restarted: {} held messages dropped, sequences start over",
+    origin, order.pending.size());
+  if (order.incarnation != 0) {
+    order.retired.insert(order.incarnation);
+  }
+  order.incarnation = incarnation;
+  order.expected = 1;
+  order.acknowledged = 0;
+  order.pending.clear();
+}
+
+void PolluxPayload::acknowledgeDelivered() {
+  if (not client_->needsAcknowledgements()) {
+    return;
+  }
+  std::vector<std::pair<int, uint64_t>> acknowledgements;
+  {
+    std::lock_guard<std::mutex> lock(orderMutex_);
+    for (auto& [origin, order]: orders_) {
+      //the message being delivered is not acknowledged before it is done
+      uint64_t delivered = order.expected - (order.delivering ? 2 : 1);
+      if (order.expected > 1 and delivered > order.acknowledged) {
+        order.acknowledged = delivered;
+        acknowledgements.emplace_back(origin, delivered);
+      }
+    }
+  }
+  for (auto [origin, sequence]: acknowledgements) {
+    client_->transmit(origin, ZebulonPayloadClient::AckKey, int64_t(sequence));
+  }
+}
+
+void PolluxPayload::resetOrder(int origin, uint64_t expected) {
+  std::unique_lock<std::mutex> lock(orderMutex_);
+  auto& order = orders_[origin];
+  order.expected = expected;
+  //known to the origin: it starts after them
+  order.acknowledged = expected - 1;
+  order.pending.erase(order.pending.begin(), order.pending.lower_bound(expected));
+  if (not order.delivering) {
+    deliverLocked(lock, origin, order, nullptr);
+  }
+}
+
+void PolluxPayload::deliverLocked(
+  std::unique_lock<std::mutex>& lock,
+  int origin,
+  OriginOrder& order,
+  const pollux::PolluxMessage* first) {
+  order.delivering = true;
+  auto deliver = [&](const pollux::PolluxMessage* message) {
+    uint64_t sequence = order.expected++;
+    lock.unlock();
+    dispatch(message);
+    bool acknowledge = sequence % ZebulonPayloadClient::AckInterval == 0
+      and client_ and client_->needsAcknowledgements();
+    if (acknowledge) {
+      client_->transmit(origin, ZebulonPayloadClient::AckKey, int64_t(sequence));
+    }
+    lock.lock();
+    if (acknowledge) {
+      order.acknowledged = std::max(order.acknowledged, sequence);
+    }
+  };
+  try {
+    if (first) {
+      deliver(first);
+    }
+    while (not order.pending.empty() and order.pending.begin()->first == order.expected) {
+      auto next = order.pending.extract(order.pending.begin());
+      deliver(&next.mapped());
+    }
+    order.progress = std::chrono::steady_clock::now();
+  } catch (...) {
+    if (not lock.owns_lock()) {
+      lock.lock();
+    }
+    order.delivering = false;
+    throw;
+  }
+  order.delivering = false;
+}
+
+void PolluxPayload::dispatch(const pollux::PolluxMessage* message) {
+  //the snapshot keeps its routes alive: nothing copied per message
+  auto routing = getRouting();
+  Route* handler = nullptr;
+  auto hit = routing->handlers.find(message->key());
+  if (hit != routing->handlers.end()) {
+    handler = hit->second.get();
+  } else {
+    //longest matching prefix comes last
+    for (const auto& [prefix, route]: routing->prefixHandlers) {
+      if (message->key().starts_with(prefix)) {
+        handler = route.get();
+      }
+    }
+  }
+  //a bad message from a peer must not take the payload down
+  try {
+    for (const auto& [observerID, observer]: routing->observers) {
+      call(*observer, message);
+    }
+    if (handler) {
+      call(*handler, message);
+    } else {
+      transmit(message);
+    }
+  } catch (const PolluxPayloadException& e) {
+    ++nbRejected_;
+    spdlog::error("Message from {} on key {} rejected: {}", message->origin(), message->key(), e.getReason());
+  }
+}
@@ -4,6 +4,13 @@
 #ifndef __POLLUX_PAYLOAD_H_
 #define __POLLUX_PAYLOAD_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <variant>
 
 #include "ZebulonPayloadClient.h"
@@ -32,20 +39,222 @@ class PolluxPayload {
     UserOptionValue* getUserOptionValue(const std::string& name);
 
     bool isSynchronized() const { return control_.synchronized(); } 
+    //latest iteration released by zebulon (Start is iteration 0)
+    //with a quorum barrier, a late payload may be behind it
+    void setIteration(uint32_t iteration) { iteration_ = iteration; }
+    uint32_t getIteration() const { return iteration_; }
+    //stale synchronous parallel bound, 0 if not set
+    //read from control or from "staleness" user option
+    uint32_t getStaleness() const;
 
     void setControl(const pollux::PolluxControl& control);
 
+    //Library modules (gossip, ...) exchange messages using reserved keys.
+    //Messages with a registered key (or key prefix) are routed to their
+    //handler, all others reach the user transmit method.
+    //Handlers throwing PolluxPayloadException (malformed or unexpected input)
+    //have the message dropped and logged, see getNbRejected.
+    using MessageHandler = std::function<void(const pollux::PolluxMessage* message)>;
+    void registerMessageHandler(const std::string& key, MessageHandler handler);
+    void unregisterMessageHandler(const std::string& key);
+    //messages whose key starts with prefix and has no handler of its own
+    //(longest registered prefix)
+    void registerPrefixHandler(const std::string& prefix, MessageHandler handler);
+    void unregisterPrefixHandler(const std::string& prefix);
+    //typed values sent by ZebulonPayloadClient transmit of plain structs
+    //a message holding another type throws PolluxPayloadException
+    template<PolluxTrivialValue T>
+    using ValueHandler = std::function<void(const pollux::PolluxMessage* message, std::span<const T> values)>;
+    template<PolluxTrivialValue T>
+    void registerValueHandler(const std::string& key, ValueHandler<T> handler) {
+      registerMessageHandler(key, [handler](const pollux::PolluxMessage* message) {
+        const auto values = PolluxTypedValue::getArray<T>(*message);
+        handler(message, values);
+      });
+    }
+    //observers are called on every received message before routing
+    //returns the observer ID, for removal
+    size_t addMessageObserver(MessageHandler observer);
+    //Removals return once the calls already running the handler or observer
+    //returned (except the ones up the calling thread stack, a handler can
+    //remove itself), dispatches started before then skip it.
+    void removeMessageObserver(size_t observerID);
+    //sequence numbers given up by a gap skip (see setReorderLimits): called
+    //with their origin and how many messages will never be delivered, once
+    //the messages following the gap were delivered
+    using SkipObserver = std::function<void(int origin, size_t nbSkipped)>;
+    size_t addSkipObserver(SkipObserver observer);
+    void removeSkipObserver(size_t observerID);
+    //messages dropped because their handler threw
+    size_t getNbRejected() const { return nbRejected_; }
+
+    //Handlers and observers registered on behalf of a library module,
+    //removed when the module is destroyed: to be declared as the last member
+    //of the module so that they go, and their running calls return, before
+    //any member they use.
+    class Registrations {
+      public:
+        Registrations() = default;
+        Registrations(const Registrations&) = delete;
+        ~Registrations() { clear(); }
+        void registerMessageHandler(PolluxPayload& payload, const std::string& key, MessageHandler handler);
+        void registerPrefixHandler(PolluxPayload& payload, const std::string& prefix, MessageHandler handler);
+        void addMessageObserver(PolluxPayload& payload, MessageHandler observer);
+        void addSkipObserver(PolluxPayload& payload, SkipObserver observer);
+        void clear();
+      private:
+        PolluxPayload*            payload_      {nullptr};
+        std::vector<std::string>  keys_         {};
+        std::vector<std::string>  prefixes_     {};
+        std::vector<size_t>       observerIDs_  {};
+        std::vector<size_t>       skipObserverIDs_ {};
+    };
+    //entry point for every received message
+    //sequenced messages (see ZebulonPayloadClient ordered delivery) are held
+    //until all previous ones from their origin were delivered. A new origin
+    //incarnation (restarted payload numbering from 1) starts its order over,
+    //messages from the previous one are dropped.
+    void receive(const pollux::PolluxMessage* message);
+    //key delivered on arrival: the declaration matters on sending payloads,
+    //typically called in init() by all of them
+    void setUnordered(const std::string& key);
+    //messages that arrived before one of their predecessors
+    size_t getNbReordered() const { return nbReordered_; }
+    //A missing message holds the later ones from its origin until more than
+    //maxPending are held or none was delivered for timeout (0: no timeout),
+    //checked when messages from the origin arrive: the gap is then skipped
+    //and the message is dropped if it comes after all.
+    void setReorderLimits(size_t maxPending, std::chrono::milliseconds timeout);
+    //sequence numbers given up by gap skips
+    size_t getNbSkipped() const { return nbSkipped_; }
+    //Restarted payload: other payloads start its sequence numbers over and
+    //send again the messages it did not acknowledge (needs their replay log,
+    //see ZebulonPayloadClient), to be called in init() before any transmit.
+    //Returns once every other payload answered with its replay start, throws
+    //PolluxPayloadException naming the silent ones after timeout.
+    void requestReplay(std::chrono::milliseconds timeout = std::chrono::milliseconds(30000));
+
+    //Client used to propagate subscriptions, to record other payloads ones and
+    //to put streamed messages back together,
+    //set by Pollux::Main before the payload can receive any message.
+    void setClient(ZebulonPayloadClient* client);
+    //Key interest: once a payload subscribed, broadcasts from other payloads
+    //only reach it for subscribed keys (see ZebulonPayloadClient).
+    //A key ending with '*' subscribes to every key starting with its prefix.
+    //Once the last key is unsubscribed, every broadcast reaches it again.
+    //Changes are sent to other payloads, typically called in init().
+    void subscribe(const std::string& key);
+    void unsubscribe(const std::string& key);
+    std::set<std::string> getSubscriptions() const;
+
     //Following methods are accesible and can be overrided by final user
     virtual void init(ZebulonPayloadClient* client) {}
     virtual void loop(ZebulonPayloadClient* client) {}
     virtual void transmit(const pollux::PolluxMessage* message) {}
 
   private:
+    struct OriginOrder {
+      //next sequence number to deliver
+      uint64_t                                  expected    {1};
+      std::map<uint64_t, pollux::PolluxMessage> pending     {};
+      //a thread is delivering messages from this origin
+      bool                                      delivering  {false};
+      //last sequence number acknowledged to the origin
+      uint64_t                                  acknowledged {0};
+      //origin process, 0 until a message tells it
+      uint64_t                                  incarnation {0};
+      std::set<uint64_t>                        retired     {};
+      //last delivery or first message held since
+      std::chrono::steady_clock::time_point     progress    {};
+    };
+
+    //observers, then handler or user transmit method
+    void dispatch(const pollux::PolluxMessage* message);
+    //next sequence number expected from origin, held later ones are delivered
+    void resetOrder(int origin, uint64_t expected);
+    //restarted origin: its sequence numbers start over, unless incarnation
+    //is already the known one
+    void restartOrder(int origin, uint64_t incarnation);
+    //orderMutex_ must be held
+    //false for a message from a retired incarnation, starts the order over
+    //for a new one
+    bool checkIncarnationLocked(OriginOrder& order, int origin, uint64_t incarnation);
+    //orderMutex_ must be held
+    void restartOrderLocked(OriginOrder& order, int origin, uint64_t incarnation);
+    //orderMutex_ must be held
+    //true when the gap before held messages is to be skipped
+    bool isGapExpiredLocked(const OriginOrder& order) const;
+    //orderMutex_ held by lock: delivers first, then held messages that follow
+    //acknowledges every AckInterval deliveries when the client needs it
+    void deliverLocked(
+      std::unique_lock<std::mutex>& lock,
+      int origin,
+      OriginOrder& order,
+      const pollux::PolluxMessage* first);
+    //barrier hook: cumulative acknowledgement of what was delivered since the
+    //last one, so that senders release their replay log without waiting for
+    //AckInterval more deliveries
+    void acknowledgeDelivered();
+    //registered handler or observer, counts its running calls so that its
+    //removal can wait for them
+    struct Route {
+      Route(MessageHandler handler): handler(std::move(handler)) {}
+      MessageHandler      handler;
+      std::atomic<size_t> nbRunning {0};
+      std::atomic<bool>   removed   {false};
+    };
+    class RouteCall;
+    using Routes = std::map<std::string, std::shared_ptr<Route>>;
+    using Observers = std::vector<std::pair<size_t, std::shared_ptr<Route>>>;
+    //copy on write: a dispatch takes the current snapshot, registrations
+    //publish a modified copy
+    struct Routing {
+      Routes    handlers        {};
+      Routes    prefixHandlers  {};
+      Observers observers       {};
+      Observers skipObservers   {};
+    };
+    void setRoute(Routes Routing::* routes, const std::string& key, MessageHandler handler);
+    void eraseRoute(Routes Routing::* routes, const std::string& key);
+    size_t addObserver(Observers Routing::* observers, MessageHandler observer);
+    void removeObserver(Observers Routing::* observers, size_t observerID);
+    //current snapshot, kept by the caller as long as it uses its routes
+    std::shared_ptr<const Routing> getRouting();
+    //skip observers called outside of orderMutex_
+    void notifySkipped(int origin, size_t nbSkipped);
+    void call(Route& route, const pollux::PolluxMessage* message);
+    //marks the route removed then waits for its running calls
+    void removeRoute(std::unique_lock<std::mutex>& lock, Route& route);
+    //0 for messages delivered on arrival
+    uint64_t getSequence(const pollux::PolluxMessage* message) const;
+
     std::string             name_         {};
     int                     localID_      {-1};
     std::vector<int>        otherIDs_     {};
     pollux::PolluxControl   control_      {};
     UserOptions             userOptions_  {};
+    std::atomic<uint32_t>   iteration_    {0};
+    std::mutex              handlersMutex_;
+    std::condition_variable routesReleased_;
+    std::atomic<size_t>     nbRemovals_   {0};
+    std::shared_ptr<const Routing> routing_ {std::make_shared<Routing>()};
+    size_t                  nextObserverID_ {1};
+    std::atomic<size_t>     nbRejected_   {0};
+    ZebulonPayloadClient*   client_       {nullptr};
+    size_t                  acknowledgeHookID_ {0};
+    mutable std::mutex      subscriptionsMutex_;
+    std::set<std::string>   subscriptions_ {};
+    std::set<std::string>   unorderedKeys_ {};
+    std::mutex              orderMutex_;
+    std::map<int, OriginOrder> orders_    {};
+    std::atomic<size_t>     nbReordered_  {0};
+    size_t                  maxPending_   {65536};
+    std::chrono::milliseconds reorderTimeout_ {30000};
+    std::atomic<size_t>     nbSkipped_    {0};
+    std::mutex              replayMutex_;
+    std::condition_variable replayStarted_;
+    //payloads that answered the last replay request
+    std::set<int>           replayStarts_ {};
 };
 
 #endif /* __POLLUX_PAYLOAD_H_ */
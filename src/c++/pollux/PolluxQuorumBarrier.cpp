@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxQuorumBarrier.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PolluxPayloadException.h"
+
+PolluxQuorumBarrier::PolluxQuorumBarrier(
+  const std::vector<int>& partIDs,
+  double quorumFraction,
+  std::chrono::milliseconds quorumTimeout):
+  nbPayloads_(partIDs.size()),
+  quorumTimeout_(quorumTimeout) {
+  if (partIDs.empty()) {
+    throw PolluxPayloadException("quorum barrier without payloads");
+  }
+  if (quorumFraction <= 0 or quorumFraction > 1) {
+    quorumFraction = 1;
+  }
+  quorum_ = std::clamp(size_t(std::ceil(quorumFraction * nbPayloads_)), size_t(1), nbPayloads_);
+}
+
+PolluxQuorumBarrier::PolluxQuorumBarrier(const pollux::PolluxControl& control):
+  PolluxQuorumBarrier(
+    std::vector<int>(control.partids().begin(), control.partids().end()),
+    control.quorumfraction(),
+    std::chrono::milliseconds(control.quorumtimeout()))
+{}
+
+uint32_t PolluxQuorumBarrier::arrive(int id, uint32_t iteration) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (iteration < iteration_) {
+    //late: catch up with current iteration
+    ++nbLateArrivals_;
+    return iteration_;
+  }
+  if (arrived_.empty()) {
+    firstArrival_ = std::chrono::steady_clock::now();
+  }
+  arrived_.insert(id);
+  if (arrived_.size() >= quorum_) {
+    release();
+  }
+  return iteration_;
+}
+
+uint32_t PolluxQuorumBarrier::wait(uint32_t iteration) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (iteration_ <= iteration) {
+    if (quorumTimeout_.count() > 0 and not arrived_.empty()) {
+      auto deadline = firstArrival_ + quorumTimeout_;
+      if (released_.wait_until(lock, deadline) == std::cv_status::timeout
+        and iteration_ <= iteration and not arrived_.empty()
+        and std::chrono::steady_clock::now() >= firstArrival_ + quorumTimeout_) {
+        ++nbTimeoutReleases_;
+        release();
+      }
+    } else {
+      released_.wait(lock);
+    }
+  }
+  return iteration_;
+}
+
+uint32_t PolluxQuorumBarrier::arriveAndWait(int id, uint32_t iteration) {
+  arrive(id, iteration);
+  return wait(iteration);
+}
+
+void PolluxQuorumBarrier::release() {
+  ++iteration_;
+  arrived_.clear();
+  released_.notify_all();
+}
+
+uint32_t PolluxQuorumBarrier::getIteration() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return iteration_;
+}
+
+size_t PolluxQuorumBarrier::getNbTimeoutReleases() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nbTimeoutReleases_;
+}
+
+size_t PolluxQuorumBarrier::getNbLateArrivals() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nbLateArrivals_;
+}
@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_QUORUM_BARRIER_H_
+#define __POLLUX_QUORUM_BARRIER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "pollux.pb.h"
+
+//Quorum barrier release policy for synchronized mode (zebulon side).
+//The next iteration is released once quorumFraction of the payloads have
+//arrived (called sendPayloadLoopReadyForNextIteration), or once quorumTimeout
+//has elapsed since the first arrival. A late payload arriving for an already
+//released iteration is not waited for: it directly gets the current iteration.
+//Used as local zebulon stand-in by benchmarks.
+class PolluxQuorumBarrier {
+  public:
+    PolluxQuorumBarrier(
+      const std::vector<int>& partIDs,
+      double quorumFraction = 1.0,
+      std::chrono::milliseconds quorumTimeout = std::chrono::milliseconds(0));
+    //from PolluxControl quorumFraction and quorumTimeout fields
+    explicit PolluxQuorumBarrier(const pollux::PolluxControl& control);
+    PolluxQuorumBarrier(const PolluxQuorumBarrier&) = delete;
+
+    //payload id is ready for next iteration after running iteration
+    //returns the current iteration: greater than iteration if released
+    uint32_t arrive(int id, uint32_t iteration);
+    //block until iteration has been released, returns current iteration
+    uint32_t wait(uint32_t iteration);
+    //arrive then wait
+    uint32_t arriveAndWait(int id, uint32_t iteration);
+
+    uint32_t getIteration() const;
+    size_t getQuorum() const { return quorum_; }
+    size_t getNbPayloads() const { return nbPayloads_; }
+    //number of iterations released by timeout
+    size_t getNbTimeoutReleases() const;
+    //number of arrivals for already released iterations
+    size_t getNbLateArrivals() const;
+
+  private:
+    //lock must be held
+    void release();
+
+    size_t                                  nbPayloads_         {0};
+    size_t                                  quorum_             {0};
+    std::chrono::milliseconds               quorumTimeout_      {0};
+    mutable std::mutex                      mutex_;
+    std::condition_variable                 released_;
+    uint32_t                                iteration_          {0};
+    std::set<int>                           arrived_            {};
+    std::chrono::steady_clock::time_point   firstArrival_       {};
+    size_t                                  nbTimeoutReleases_  {0};
+    size_t                                  nbLateArrivals_     {0};
+};
+
+#endif /* __POLLUX_QUORUM_BARRIER_H_ */
@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxReplayLog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "PolluxPayloadException.h"
+
+PolluxReplayLog::PolluxReplayLog(size_t memoryLimit, size_t fileSize, const std::string& path):
+  memoryLimit_(memoryLimit),
+  fileSize_(fileSize) {
+  if (fileSize_ == 0) {
+    return;
+  }
+  if (path.empty()) {
+    char temporary[] = "/tmp/pollux_replay_XXXXXX";
+    fd_ = mkstemp(temporary);
+    if (fd_ >= 0) {
+      unlink(temporary);
+    }
+  } else {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  }
+  if (fd_ < 0) {
+    throw PolluxPayloadException("replay log file creation failed: " + std::string(strerror(errno)));
+  }
+  if (ftruncate(fd_, fileSize_) != 0) {
+    close(fd_);
+    throw PolluxPayloadException("replay log file sizing failed: " + std::string(strerror(errno)));
+  }
+  void* file = mmap(nullptr, fileSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (file == MAP_FAILED) {
+    close(fd_);
+    throw PolluxPayloadException("replay log file mapping failed: " + std::string(strerror(errno)));
+  }
+  file_ = static_cast<char*>(file);
+}
+
+PolluxReplayLog::~PolluxReplayLog() {
+  if (file_) {
+    munmap(file_, fileSize_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void PolluxReplayLog::append(const std::vector<int>& destinations, const pollux::PolluxMessage& message) {
+  append(destinations, {message.sequences().data(), size_t(message.sequences_size())},
+    std::make_shared<const std::string>(message.SerializeAsString()));
+}
+
+void PolluxReplayLog::append(
+  const std::vector<int>& destinations,
+  std::span<const uint64_t> sequences,
+  std::shared_ptr<const std::string> data) {
+  if (sequences.size() != destinations.size()) {
+    throw PolluxPayloadException("replay log: message without one sequence number per destination");
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < destinations.size(); i++) {
+    memory_[destinations[i]].push_back(Entry{sequences[i], data});
+    appendOrder_.emplace_back(destinations[i], sequences[i]);
+  }
+  //a broadcast is counted once per destination: it is spilled that way
+  memoryBytes_ += data->size() * destinations.size();
+  spillLocked();
+}
+
+void PolluxReplayLog::spillLocked() {
+  while (memoryBytes_ > memoryLimit_ and not appendOrder_.empty()) {
+    auto [destination, sequence] = appendOrder_.front();
+    appendOrder_.pop_front();
+    auto& entries = memory_[destination];
+    if (entries.empty() or entries.front().sequence != sequence) {
+      //acknowledged meanwhile
+      continue;
+    }
+    Entry entry = std::move(entries.front());
+    entries.pop_front();
+    memoryBytes_ -= entry.data->size();
+    size_t size = entry.data->size();
+    if (size > fileSize_) {
+      ++nbLost_;
+      lost_[destination] = std::max(lost_[destination], sequence);
+      continue;
+    }
+    if (writeOffset_ + size > fileSize_) {
+      //end of the file is skipped, records there are older than the ring start
+      evictLocked(writeOffset_, fileSize_);
+      writeOffset_ = 0;
+    }
+    evictLocked(writeOffset_, writeOffset_ + size);
+    std::memcpy(file_ + writeOffset_, entry.data->data(), size);
+    spilled_.push_back(Record{destination, sequence, writeOffset_, size});
+    writeOffset_ += size;
+    ++nbSpilled_;
+  }
+}
+
+void PolluxReplayLog::evictLocked(size_t begin, size_t end) {
+  //ring: records overlapping the write range are the oldest ones
+  while (not spilled_.empty()
+    and spilled_.front().offset < end
+    and spilled_.front().offset + spilled_.front().size > begin) {
+    const auto& record = spilled_.front();
+    if (record.sequence > acknowledged_[record.destination]) {
+      ++nbLost_;
+      lost_[record.destination] = std::max(lost_[record.destination], record.sequence);
+    }
+    spilled_.pop_front();
+  }
+}
+
+void PolluxReplayLog::acknowledge(int destination, uint64_t sequence) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& acknowledged = acknowledged_[destination];
+  acknowledged = std::max(acknowledged, sequence);
+  //spilled records are skipped at replay and reclaimed when overwritten
+  auto& entries = memory_[destination];
+  while (not entries.empty() and entries.front().sequence <= acknowledged) {
+    memoryBytes_ -= entries.front().data->size();
+    entries.pop_front();
+  }
+  while (not appendOrder_.empty()
+    and appendOrder_.front().second <= acknowledged_[appendOrder_.front().first]) {
+    appendOrder_.pop_front();
+  }
+}
+
+uint64_t PolluxReplayLog::getAcknowledged(int destination) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto ait = acknowledged_.find(destination);
+  return ait == acknowledged_.end() ? 0 : ait->second;
+}
+
+bool PolluxReplayLog::replay(int destination, std::vector<pollux::PolluxMessage>& messages) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto ait = acknowledged_.find(destination);
+  uint64_t acknowledged = ait == acknowledged_.end() ? 0 : ait->second;
+  auto parse = [&messages, destination](const char* data, size_t size, uint64_t sequence) {
+    pollux::PolluxMessage message;
+    if (not message.ParseFromArray(data, size)) {
+      throw PolluxPayloadException("replay log: corrupted record");
+    }
+    message.clear_destinations();
+    message.add_destinations(destination);
+    message.clear_sequences();
+    message.add_sequences(sequence);
+    messages.push_back(std::move(message));
+  };
+  for (const auto& record: spilled_) {
+    if (record.destination == destination and record.sequence > acknowledged) {
+      parse(file_ + record.offset, record.size, record.sequence);
+    }
+  }
+  auto mit = memory_.find(destination);
+  if (mit != memory_.end()) {
+    for (const auto& entry: mit->second) {
+      parse(entry.data->data(), entry.data->size(), entry.sequence);
+    }
+  }
+  auto lit = lost_.find(destination);
+  return lit == lost_.end() or lit->second <= acknowledged;
+}
+
+size_t PolluxReplayLog::getMemoryBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memoryBytes_;
+}
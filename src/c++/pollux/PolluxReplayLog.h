@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_REPLAY_LOG_H_
+#define __POLLUX_REPLAY_LOG_H_
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "pollux.pb.h"
+
+//Sender side log of sequenced messages not acknowledged yet, replayed to
+//a restarted payload (see ZebulonPayloadClient replay).
+//Recent messages stay in memory up to memoryLimit bytes, older ones spill
+//to a file mapped in memory used as a ring: once full, the oldest records
+//are overwritten and lost for replay.
+//Receivers acknowledge cumulatively: everything up to a sequence number.
+class PolluxReplayLog {
+  public:
+    //path: spill file, a temporary file removed at once if empty
+    PolluxReplayLog(
+      size_t memoryLimit = 16*1024*1024,
+      size_t fileSize = 256*1024*1024,
+      const std::string& path = "");
+    PolluxReplayLog(const PolluxReplayLog&) = delete;
+    ~PolluxReplayLog();
+
+    //message holds one sequence number per destination (parallel fields)
+    void append(const std::vector<int>& destinations, const pollux::PolluxMessage& message);
+    //message serialized beforehand, sequence numbers not needed in it:
+    //the caller keeps serialization out of its own locks
+    void append(
+      const std::vector<int>& destinations,
+      std::span<const uint64_t> sequences,
+      std::shared_ptr<const std::string> data);
+    void acknowledge(int destination, uint64_t sequence);
+    uint64_t getAcknowledged(int destination) const;
+
+    //messages to destination after its last acknowledgement, in sequence
+    //order, addressed to destination alone with their sequence number
+    //returns false if some of them were lost
+    bool replay(int destination, std::vector<pollux::PolluxMessage>& messages) const;
+
+    size_t getMemoryBytes() const;
+    size_t getNbSpilled() const { return nbSpilled_; }
+    //unacknowledged messages overwritten in the spill file
+    size_t getNbLost() const { return nbLost_; }
+
+  private:
+    struct Entry {
+      uint64_t                            sequence  {0};
+      //shared by all destinations of a message
+      std::shared_ptr<const std::string>  data      {};
+    };
+    struct Record {
+      int       destination {-1};
+      uint64_t  sequence    {0};
+      size_t    offset      {0};
+      size_t    size        {0};
+    };
+
+    //lock must be held
+    void spillLocked();
+    //drop spilled records overlapping [begin, end)
+    void evictLocked(size_t begin, size_t end);
+
+    size_t                                memoryLimit_  {0};
+    size_t                                fileSize_     {0};
+    int                                   fd_           {-1};
+    char*                                 file_         {nullptr};
+    mutable std::mutex                    mutex_;
+    std::map<int, std::deque<Entry>>      memory_       {};
+    size_t                                memoryBytes_  {0};
+    //memory entries in append order, for spilling the oldest first
+    std::deque<std::pair<int, uint64_t>>  appendOrder_  {};
+    //spilled records in file order, oldest first
+    std::deque<Record>                    spilled_      {};
+    size_t                                writeOffset_  {0};
+    std::map<int, uint64_t>               acknowledged_ {};
+    //per destination: last sequence number lost
+    std::map<int, uint64_t>               lost_         {};
+    size_t                                nbSpilled_    {0};
+    size_t                                nbLost_       {0};
+};
+
+#endif /* __POLLUX_REPLAY_LOG_H_ */
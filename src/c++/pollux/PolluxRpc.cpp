@@ -0,0 +1,194 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxRpc.h"
+
+#include <cstring>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+PolluxRpc::PolluxRpc(
+  int localID,
+  ZebulonPayloadClient::MessageSender sender,
+  std::chrono::milliseconds timeout):
+  localID_(localID),
+  sender_(sender),
+  timeout_(timeout) {
+  timeoutThread_ = std::thread(&PolluxRpc::checkTimeouts, this);
+}
+
+PolluxRpc::PolluxRpc(
+  PolluxPayload& payload,
+  ZebulonPayloadClient* client,
+  std::chrono::milliseconds timeout):
+  PolluxRpc(payload.getLocalID(), client->getMessageSender(), timeout) {
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, ResponseKey, handler);
+  registrations_.registerMessageHandler(payload, ErrorKey, handler);
+  //unknown methods are answered too
+  registrations_.registerPrefixHandler(payload, RequestPrefix, handler);
+}
+
+PolluxRpc::~PolluxRpc() {
+  //no answer handled while the timeout thread stops
+  registrations_.clear();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  deadlinesChanged_.notify_all();
+  timeoutThread_.join();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& [correlationID, pendingCall]: pendingCalls_) {
+    pendingCall.promise.set_exception(std::make_exception_ptr(PolluxPayloadException("rpc stopped")));
+  }
+  pendingCalls_.clear();
+}
+
+void PolluxRpc::registerMethod(const std::string& method, Handler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  methods_[method] = handler;
+}
+
+PolluxRpc::Response PolluxRpc::call(int destination, const std::string& method, pollux::PolluxMessage& request) {
+  return call(destination, method, request, timeout_);
+}
+
+PolluxRpc::Response PolluxRpc::call(int destination, const std::string& method, const std::string& request) {
+  pollux::PolluxMessage message;
+  message.set_strvalue(request);
+  return call(destination, method, message, timeout_);
+}
+
+PolluxRpc::Response PolluxRpc::call(
+  int destination,
+  const std::string& method,
+  pollux::PolluxMessage& request,
+  std::chrono::milliseconds timeout) {
+  uint64_t correlationID = 0;
+  Response response;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    correlationID = nextCorrelationID_++;
+    auto& pendingCall = pendingCalls_[correlationID];
+    pendingCall.deadline = std::chrono::steady_clock::now() + timeout;
+    response = pendingCall.promise.get_future();
+    deadlines_.emplace(pendingCall.deadline, correlationID);
+  }
+  deadlinesChanged_.notify_all();
+  request.set_key(RequestPrefix + method);
+  request.set_correlationid(correlationID);
+  try {
+    sender_(ZebulonPayloadClient::Destinations({destination}), request);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto pit = pendingCalls_.find(correlationID);
+    if (pit != pendingCalls_.end()) {
+      takePendingCallLocked(pit);
+    }
+    throw;
+  }
+  return response;
+}
+
+void PolluxRpc::receive(const pollux::PolluxMessage* message) {
+  if (message->key().rfind(RequestPrefix, 0) == 0) {
+    handleRequest(message);
+  } else {
+    handleResponse(message);
+  }
+}
+
+void PolluxRpc::handleRequest(const pollux::PolluxMessage* message) {
+  std::string method = message->key().substr(std::strlen(RequestPrefix));
+  Handler handler;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto mit = methods_.find(method);
+    if (mit != methods_.end()) {
+      handler = mit->second;
+    }
+  }
+  pollux::PolluxMessage response;
+  if (not handler) {
+    response.set_key(ErrorKey);
+    response.set_strvalue("unknown rpc method: " + method + " on " + std::to_string(localID_));
+  } else {
+    try {
+      handler(*message, response);
+      response.set_key(ResponseKey);
+    } catch (const PolluxPayloadException& e) {
+      response.Clear();
+      response.set_key(ErrorKey);
+      response.set_strvalue(e.getReason());
+    } catch (const std::exception& e) {
+      response.Clear();
+      response.set_key(ErrorKey);
+      response.set_strvalue(e.what());
+    }
+  }
+  response.set_correlationid(message->correlationid());
+  sender_(ZebulonPayloadClient::Destinations({int(message->origin())}), response);
+}
+
+void PolluxRpc::handleResponse(const pollux::PolluxMessage* message) {
+  std::promise<pollux::PolluxMessage> promise;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto pit = pendingCalls_.find(message->correlationid());
+    if (pit == pendingCalls_.end()) {
+      spdlog::debug("RPC: dropping late response {} from {}", message->correlationid(), message->origin());
+      return;
+    }
+    promise = takePendingCallLocked(pit);
+  }
+  if (message->key() == ErrorKey) {
+    promise.set_exception(std::make_exception_ptr(PolluxPayloadException(message->strvalue())));
+  } else {
+    promise.set_value(*message);
+  }
+}
+
+std::promise<pollux::PolluxMessage> PolluxRpc::takePendingCallLocked(std::map<uint64_t, PendingCall>::iterator pit) {
+  auto [first, last] = deadlines_.equal_range(pit->second.deadline);
+  for (auto dit = first; dit != last; ++dit) {
+    if (dit->second == pit->first) {
+      deadlines_.erase(dit);
+      break;
+    }
+  }
+  auto promise = std::move(pit->second.promise);
+  pendingCalls_.erase(pit);
+  return promise;
+}
+
+void PolluxRpc::checkTimeouts() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (not stopped_) {
+    if (deadlines_.empty()) {
+      deadlinesChanged_.wait(lock);
+      continue;
+    }
+    auto first = deadlines_.begin();
+    if (std::chrono::steady_clock::now() < first->first) {
+      deadlinesChanged_.wait_until(lock, first->first);
+      continue;
+    }
+    uint64_t correlationID = first->second;
+    deadlines_.erase(first);
+    auto pit = pendingCalls_.find(correlationID);
+    if (pit != pendingCalls_.end()) {
+      pit->second.promise.set_exception(std::make_exception_ptr(
+        PolluxPayloadException("rpc call " + std::to_string(correlationID) + " timed out")));
+      pendingCalls_.erase(pit);
+    }
+  }
+}
+
+size_t PolluxRpc::getNbPendingCalls() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pendingCalls_.size();
+}
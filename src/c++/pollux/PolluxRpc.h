@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_RPC_H_
+#define __POLLUX_RPC_H_
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Payload to payload request/response calls on top of transmit.
+//call() sends the request with a fresh correlation ID and returns a future
+//fulfilled by the matching response: many calls can be in flight at once.
+//Callee methods are registered by name, a handler fills the response value.
+//Remote handler errors (PolluxPayloadException), unknown methods and
+//timeouts are reported as PolluxPayloadException through the future.
+class PolluxRpc {
+  public:
+    static constexpr const char* RequestPrefix = "_pollux_rpc_request:";
+    static constexpr const char* ResponseKey = "_pollux_rpc_response";
+    static constexpr const char* ErrorKey = "_pollux_rpc_error";
+
+    using Handler = std::function<void(const pollux::PolluxMessage& request, pollux::PolluxMessage& response)>;
+    using Response = std::future<pollux::PolluxMessage>;
+
+    //transport agnostic constructor
+    PolluxRpc(
+      int localID,
+      ZebulonPayloadClient::MessageSender sender,
+      std::chrono::milliseconds timeout = std::chrono::seconds(10));
+    //convenience constructor: message handlers are registered on payload,
+    //requests of every method included
+    PolluxRpc(
+      PolluxPayload& payload,
+      ZebulonPayloadClient* client,
+      std::chrono::milliseconds timeout = std::chrono::seconds(10));
+    PolluxRpc(const PolluxRpc&) = delete;
+    ~PolluxRpc();
+
+    //callee side
+    void registerMethod(const std::string& method, Handler handler);
+
+    //caller side: request value is moved into the sent message
+    Response call(int destination, const std::string& method, pollux::PolluxMessage& request);
+    Response call(
+      int destination,
+      const std::string& method,
+      pollux::PolluxMessage& request,
+      std::chrono::milliseconds timeout);
+    Response call(int destination, const std::string& method, const std::string& request);
+
+    //handle requests, responses and errors
+    void receive(const pollux::PolluxMessage* message);
+
+    size_t getNbPendingCalls() const;
+
+  private:
+    using Deadline = std::chrono::steady_clock::time_point;
+    struct PendingCall {
+      std::promise<pollux::PolluxMessage> promise   {};
+      Deadline                            deadline  {};
+    };
+
+    //lock must be held: removes the call and its deadline
+    std::promise<pollux::PolluxMessage> takePendingCallLocked(std::map<uint64_t, PendingCall>::iterator pit);
+    void handleRequest(const pollux::PolluxMessage* message);
+    void handleResponse(const pollux::PolluxMessage* message);
+    void checkTimeouts();
+
+    int                                 localID_          {-1};
+    ZebulonPayloadClient::MessageSender sender_           {};
+    std::chrono::milliseconds           timeout_          {0};
+    mutable std::mutex                  mutex_;
+    std::condition_variable             deadlinesChanged_;
+    std::map<std::string, Handler>      methods_          {};
+    uint64_t                            nextCorrelationID_ {1};
+    std::map<uint64_t, PendingCall>     pendingCalls_     {};
+    std::multimap<Deadline, uint64_t>   deadlines_        {};
+    bool                                stopped_          {false};
+    std::thread                         timeoutThread_    {};
+    PolluxPayload::Registrations        registrations_    {};
+};
+
+#endif /* __POLLUX_RPC_H_ */
@@ -0,0 +1,209 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxShardedMap.h"
+
+#include <algorithm>
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+namespace {
+
+//ring position of a key, decorrelated from the shard table hash
+uint64_t getRingHash(uint64_t key) {
+  return PolluxHashTable::hash(key ^ 0x9e3779b97f4a7c15ULL);
+}
+
+std::vector<int> getAllIDs(const PolluxPayload& payload) {
+  auto ids = payload.getOtherIDs();
+  ids.push_back(payload.getLocalID());
+  return ids;
+}
+
+}
+
+PolluxShardedMap::PolluxShardedMap(
+  const std::string& name,
+  int localID,
+  const std::vector<int>& partIDs,
+  ZebulonPayloadClient::MessageSender sender,
+  size_t virtualNodes):
+  name_(name),
+  localID_(localID),
+  sender_(sender) {
+  if (partIDs.empty()) {
+    throw PolluxPayloadException("sharded map " + name_ + ": no part IDs");
+  }
+  virtualNodes = std::max(virtualNodes, size_t(1));
+  ring_.reserve(partIDs.size() * virtualNodes);
+  for (auto id: partIDs) {
+    for (uint64_t point = 0; point < virtualNodes; point++) {
+      ring_.emplace_back(PolluxHashTable::hash((uint64_t(id) << 32) | point), id);
+    }
+  }
+  std::sort(ring_.begin(), ring_.end());
+}
+
+PolluxShardedMap::PolluxShardedMap(PolluxPayload& payload, ZebulonPayloadClient* client, const std::string& name):
+  PolluxShardedMap(name, payload.getLocalID(), getAllIDs(payload), client->getMessageSender()) {
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, OperationsPrefix + name_, handler);
+  registrations_.registerMessageHandler(payload, ResultsPrefix + name_, handler);
+}
+
+int PolluxShardedMap::getOwner(Key key) const {
+  auto rit = std::upper_bound(ring_.begin(), ring_.end(), std::make_pair(getRingHash(key), INT32_MAX));
+  if (rit == ring_.end()) {
+    rit = ring_.begin();
+  }
+  return rit->second;
+}
+
+PolluxShardedMap::Results PolluxShardedMap::insertBatch(const std::vector<std::pair<Key, Value>>& entries) {
+  std::vector<Key> keys;
+  std::vector<Value> values;
+  keys.reserve(entries.size());
+  values.reserve(entries.size());
+  for (const auto& [key, value]: entries) {
+    keys.push_back(key);
+    values.push_back(value);
+  }
+  return execute(Insert, keys, values);
+}
+
+PolluxShardedMap::Results PolluxShardedMap::lookupBatch(const std::vector<Key>& keys) {
+  return execute(Lookup, keys, {});
+}
+
+PolluxShardedMap::Results PolluxShardedMap::eraseBatch(const std::vector<Key>& keys) {
+  return execute(Erase, keys, {});
+}
+
+std::optional<PolluxShardedMap::Value> PolluxShardedMap::applyLocked(OperationKind kind, Key key, Value value) {
+  switch (kind) {
+    case Insert: return shard_.insert(key, value);
+    case Lookup: return shard_.find(key);
+    case Erase: return shard_.erase(key);
+  }
+  return std::nullopt;
+}
+
+PolluxShardedMap::Results PolluxShardedMap::execute(
+  OperationKind kind,
+  const std::vector<Key>& keys,
+  const std::vector<Value>& values) {
+  auto request = std::make_shared<BatchRequest>();
+  request->results.resize(keys.size());
+  //one message per owner: kind, then key (and value for Insert) per operation
+  std::map<int, pollux::PolluxMessage> messages;
+  std::map<int, std::vector<size_t>> positions;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t position = 0; position < keys.size(); position++) {
+      Value value = kind == Insert ? values[position] : 0;
+      int owner = getOwner(keys[position]);
+      if (owner == localID_) {
+        request->results[position] = applyLocked(kind, keys[position], value);
+        continue;
+      }
+      auto& message = messages[owner];
+      auto operations = message.mutable_int64arrayvalue()->mutable_values();
+      if (operations->empty()) {
+        operations->Add(kind);
+      }
+      operations->Add(keys[position]);
+      if (kind == Insert) {
+        operations->Add(value);
+      }
+      positions[owner].push_back(position);
+    }
+    for (auto& [owner, message]: messages) {
+      uint64_t correlationID = nextCorrelationID_++;
+      message.set_key(OperationsPrefix + name_);
+      message.set_correlationid(correlationID);
+      pendingBatches_[correlationID] = PendingBatch{request, std::move(positions[owner])};
+    }
+    request->remaining = messages.size();
+  }
+  Results results = request->promise.get_future();
+  if (messages.empty()) {
+    request->promise.set_value(std::move(request->results));
+  }
+  for (auto& [owner, message]: messages) {
+    ++nbSentMessages_;
+    sender_(ZebulonPayloadClient::Destinations({owner}), message);
+  }
+  return results;
+}
+
+void PolluxShardedMap::receive(const pollux::PolluxMessage* message) {
+  if (message->value_case() != pollux::PolluxMessage::kInt64ArrayValue
+    or message->int64arrayvalue().values_size() == 0) {
+    throw PolluxPayloadException("malformed sharded map message from: " + std::to_string(message->origin()));
+  }
+  if (message->key().rfind(ResultsPrefix, 0) == 0) {
+    receiveResults(message);
+    return;
+  }
+  const auto& operations = message->int64arrayvalue().values();
+  auto kind = static_cast<OperationKind>(operations[0]);
+  int stride = kind == Insert ? 2 : 1;
+  if ((operations.size() - 1) % stride != 0) {
+    throw PolluxPayloadException("malformed sharded map operations from: " + std::to_string(message->origin()));
+  }
+  //results: found flag and value per operation
+  pollux::PolluxMessage results;
+  auto values = results.mutable_int64arrayvalue()->mutable_values();
+  values->Reserve(2 * (operations.size() - 1) / stride);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 1; i < operations.size(); i += stride) {
+      auto result = applyLocked(kind, operations[i], kind == Insert ? operations[i+1] : 0);
+      values->Add(result.has_value());
+      values->Add(result.value_or(0));
+    }
+  }
+  results.set_key(ResultsPrefix + name_);
+  results.set_correlationid(message->correlationid());
+  ++nbSentMessages_;
+  sender_(ZebulonPayloadClient::Destinations({int(message->origin())}), results);
+}
+
+void PolluxShardedMap::receiveResults(const pollux::PolluxMessage* message) {
+  const auto& values = message->int64arrayvalue().values();
+  std::shared_ptr<BatchRequest> completed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto pit = pendingBatches_.find(message->correlationid());
+    if (pit == pendingBatches_.end()) {
+      return;
+    }
+    auto& [request, positions] = pit->second;
+    if (size_t(values.size()) != 2 * positions.size()) {
+      throw PolluxPayloadException("sharded map " + name_ + ": unexpected number of results");
+    }
+    for (size_t i = 0; i < positions.size(); i++) {
+      if (values[2*i]) {
+        request->results[positions[i]] = values[2*i+1];
+      }
+    }
+    if (--request->remaining == 0) {
+      completed = request;
+    }
+    pendingBatches_.erase(pit);
+  }
+  if (completed) {
+    completed->promise.set_value(std::move(completed->results));
+  }
+}
+
+size_t PolluxShardedMap::getLocalSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return shard_.size();
+}
+
+void PolluxShardedMap::reserveLocal(size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  shard_.reserve(size);
+}
@@ -0,0 +1,95 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_SHARDED_MAP_H_
+#define __POLLUX_SHARDED_MAP_H_
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "PolluxHashTable.h"
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Key-value store sharded across payloads (memoization, transposition tables,
+//visited states...).
+//Keys are placed on a consistent hashing ring with virtual nodes per payload,
+//each payload owns a PolluxHashTable shard.
+//Batch operations send one message per owner and return a future of the
+//results in keys order: for each key, the value it had before the operation
+//(std::nullopt if absent). Local keys are served without any message.
+class PolluxShardedMap {
+  public:
+    static constexpr const char* OperationsPrefix = "_pollux_shardedmap_ops:";
+    static constexpr const char* ResultsPrefix = "_pollux_shardedmap_results:";
+
+    using Key = PolluxHashTable::Key;
+    using Value = PolluxHashTable::Value;
+    using Results = std::future<std::vector<std::optional<Value>>>;
+
+    //transport agnostic constructor
+    //name: identifies the map, same on every payload
+    //partIDs: all payloads IDs sharing the map (local one included)
+    //virtualNodes: ring points per payload, more points balance shards better
+    PolluxShardedMap(
+      const std::string& name,
+      int localID,
+      const std::vector<int>& partIDs,
+      ZebulonPayloadClient::MessageSender sender,
+      size_t virtualNodes = 64);
+    //convenience constructor: map is shared by all payloads,
+    //message handlers are registered on payload
+    PolluxShardedMap(PolluxPayload& payload, ZebulonPayloadClient* client, const std::string& name);
+    PolluxShardedMap(const PolluxShardedMap&) = delete;
+
+    int getOwner(Key key) const;
+
+    //insert or assign
+    Results insertBatch(const std::vector<std::pair<Key, Value>>& entries);
+    Results lookupBatch(const std::vector<Key>& keys);
+    Results eraseBatch(const std::vector<Key>& keys);
+
+    //handle operations (owner side) and results
+    void receive(const pollux::PolluxMessage* message);
+
+    //local shard
+    size_t getLocalSize() const;
+    void reserveLocal(size_t size);
+
+    size_t getNbSentMessages() const { return nbSentMessages_; }
+
+  private:
+    enum OperationKind { Insert = 0, Lookup = 1, Erase = 2 };
+    struct BatchRequest {
+      std::promise<std::vector<std::optional<Value>>> promise   {};
+      std::vector<std::optional<Value>>               results   {};
+      size_t                                          remaining {0};
+    };
+    struct PendingBatch {
+      std::shared_ptr<BatchRequest> request   {};
+      //positions in request results of the sent keys
+      std::vector<size_t>           positions {};
+    };
+
+    //values are ignored for Lookup and Erase
+    Results execute(OperationKind kind, const std::vector<Key>& keys, const std::vector<Value>& values);
+    //lock must be held
+    std::optional<Value> applyLocked(OperationKind kind, Key key, Value value);
+    void receiveResults(const pollux::PolluxMessage* message);
+
+    std::string                         name_               {};
+    int                                 localID_            {-1};
+    ZebulonPayloadClient::MessageSender sender_             {};
+    //sorted ring points: hash -> payload ID
+    std::vector<std::pair<uint64_t, int>> ring_             {};
+    mutable std::mutex                  mutex_;
+    PolluxHashTable                     shard_              {};
+    uint64_t                            nextCorrelationID_  {1};
+    std::map<uint64_t, PendingBatch>    pendingBatches_     {};
+    std::atomic<size_t>                 nbSentMessages_     {0};
+    PolluxPayload::Registrations        registrations_      {};
+};
+
+#endif /* __POLLUX_SHARDED_MAP_H_ */
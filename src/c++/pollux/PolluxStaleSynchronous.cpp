@@ -0,0 +1,187 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxStaleSynchronous.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+PolluxStaleSynchronous::PolluxStaleSynchronous(
+  int localID,
+  const std::vector<int>& peers,
+  uint32_t staleness,
+  ZebulonPayloadClient::MessageSender sender):
+  localID_(localID),
+  staleness_(staleness),
+  sender_(sender) {
+  for (auto peer: peers) {
+    peerClocks_[peer] = 0;
+  }
+}
+
+PolluxStaleSynchronous::PolluxStaleSynchronous(PolluxPayload& payload, ZebulonPayloadClient* client):
+  PolluxStaleSynchronous(payload.getLocalID(), payload.getOtherIDs(), payload.getStaleness(), client->getMessageSender()) {
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, ClockKey, handler);
+  registrations_.registerMessageHandler(payload, WaitKey, handler);
+  registrations_.addMessageObserver(payload, [this](const pollux::PolluxMessage* message) { observe(message); });
+  client_ = client;
+  hookID_ = client->addOutgoingHook(
+    [this](const ZebulonPayloadClient::Destinations& destinations, pollux::PolluxMessage& message) {
+      stamp(destinations, message);
+    });
+}
+
+PolluxStaleSynchronous::~PolluxStaleSynchronous() {
+  if (client_) {
+    client_->removeOutgoingHook(hookID_);
+  }
+}
+
+uint32_t PolluxStaleSynchronous::getClock() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return clock_;
+}
+
+uint32_t PolluxStaleSynchronous::getMinPeerClock() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return getMinPeerClockLocked();
+}
+
+uint32_t PolluxStaleSynchronous::getMinPeerClockLocked() const {
+  uint32_t minClock = FinishedClock;
+  for (const auto& [peer, clock]: peerClocks_) {
+    minClock = std::min(minClock, clock);
+  }
+  return minClock;
+}
+
+void PolluxStaleSynchronous::advance() {
+  std::vector<std::pair<int, uint32_t>> notifications;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (clock_ != FinishedClock) {
+    ++clock_;
+  }
+  for (auto wit = waiters_.begin(); wit != waiters_.end(); ) {
+    if (clock_ >= wit->second) {
+      notifications.emplace_back(wit->first, clock_);
+      wit = waiters_.erase(wit);
+    } else {
+      ++wit;
+    }
+  }
+  uint32_t required = clock_ > staleness_ ? clock_ - staleness_ : 0;
+  if (not notifications.empty()) {
+    lock.unlock();
+    for (const auto& [peer, clock]: notifications) {
+      sendClock(peer, clock);
+    }
+    lock.lock();
+  }
+  if (getMinPeerClockLocked() >= required) {
+    return;
+  }
+
+  ++nbBlocked_;
+  const auto start{std::chrono::steady_clock::now()};
+  spdlog::debug("SSP: clock {} blocked, waiting for peers to reach {}", clock_, required);
+  while (getMinPeerClockLocked() < required) {
+    std::vector<int> lagging;
+    for (const auto& [peer, clock]: peerClocks_) {
+      if (clock < required and requested_[peer] < required) {
+        requested_[peer] = required;
+        lagging.push_back(peer);
+      }
+    }
+    if (not lagging.empty()) {
+      lock.unlock();
+      for (auto peer: lagging) {
+        pollux::PolluxMessage message;
+        message.set_key(WaitKey);
+        message.set_int64value(required);
+        sender_(ZebulonPayloadClient::Destinations({peer}), message);
+      }
+      lock.lock();
+      continue;
+    }
+    clockChanged_.wait(lock);
+  }
+  const std::chrono::duration<double> elapsed_seconds{std::chrono::steady_clock::now() - start};
+  blockedSeconds_ += elapsed_seconds.count();
+}
+
+void PolluxStaleSynchronous::finish() {
+  std::vector<int> peers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clock_ = FinishedClock;
+    waiters_.clear();
+    for (const auto& [peer, clock]: peerClocks_) {
+      //finished peers do not wait for anyone
+      if (clock != FinishedClock) {
+        peers.push_back(peer);
+      }
+    }
+  }
+  for (auto peer: peers) {
+    sendClock(peer, FinishedClock);
+  }
+}
+
+void PolluxStaleSynchronous::stamp(
+  const ZebulonPayloadClient::Destinations& destinations,
+  pollux::PolluxMessage& message) {
+  //wait requests are answered by ClockKey messages only: subscriptions or
+  //admission may still drop this one after the hooks
+  std::lock_guard<std::mutex> lock(mutex_);
+  message.set_clock(clock_);
+}
+
+void PolluxStaleSynchronous::observe(const pollux::PolluxMessage* message) {
+  if (message->clock() > 0) {
+    updateClock(message->origin(), message->clock());
+  }
+}
+
+void PolluxStaleSynchronous::receive(const pollux::PolluxMessage* message) {
+  if (message->value_case() != pollux::PolluxMessage::kInt64Value) {
+    throw PolluxPayloadException("malformed SSP message from: " + std::to_string(message->origin()));
+  }
+  uint32_t clock = static_cast<uint32_t>(message->int64value());
+  if (message->key() == ClockKey) {
+    updateClock(message->origin(), clock);
+    return;
+  }
+  //wait request: notify now or once our clock reaches the requested one
+  uint32_t localClock = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (clock_ < clock) {
+      auto& waiter = waiters_[message->origin()];
+      waiter = std::max(waiter, clock);
+      return;
+    }
+    localClock = clock_;
+  }
+  sendClock(message->origin(), localClock);
+}
+
+void PolluxStaleSynchronous::updateClock(int origin, uint32_t clock) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto pit = peerClocks_.find(origin);
+  if (pit != peerClocks_.end() and clock > pit->second) {
+    pit->second = clock;
+    clockChanged_.notify_all();
+  }
+}
+
+void PolluxStaleSynchronous::sendClock(int destination, uint32_t clock) {
+  pollux::PolluxMessage message;
+  message.set_key(ClockKey);
+  message.set_int64value(clock);
+  sender_(ZebulonPayloadClient::Destinations({destination}), message);
+}
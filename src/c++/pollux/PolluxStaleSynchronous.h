@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_STALE_SYNCHRONOUS_H_
+#define __POLLUX_STALE_SYNCHRONOUS_H_
+
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Stale synchronous parallel (SSP) execution: in non synchronized mode,
+//a payload may run up to "staleness" iterations ahead of the slowest peer.
+//Each payload keeps an iteration clock, piggybacked on every outgoing
+//message. advance() is called at the end of each iteration and only blocks
+//when the staleness bound would be exceeded: lagging peers are then asked
+//to notify their clock once they have caught up.
+//staleness 0 is lockstep.
+class PolluxStaleSynchronous {
+  public:
+    static constexpr const char* ClockKey = "_pollux_ssp_clock";
+    static constexpr const char* WaitKey = "_pollux_ssp_wait";
+    static constexpr uint32_t FinishedClock = std::numeric_limits<uint32_t>::max();
+
+    //transport agnostic constructor
+    PolluxStaleSynchronous(
+      int localID,
+      const std::vector<int>& peers,
+      uint32_t staleness,
+      ZebulonPayloadClient::MessageSender sender);
+    //convenience constructor: staleness is payload one, message handlers,
+    //clock observer and client clock stamping are registered
+    PolluxStaleSynchronous(PolluxPayload& payload, ZebulonPayloadClient* client);
+    PolluxStaleSynchronous(const PolluxStaleSynchronous&) = delete;
+    //removes the client clock stamping, to be destroyed once transmits stopped
+    ~PolluxStaleSynchronous();
+
+    uint32_t getStaleness() const { return staleness_; }
+    uint32_t getClock() const;
+    //slowest known peer clock
+    uint32_t getMinPeerClock() const;
+
+    //end of iteration: increment local clock then block while
+    //the slowest peer is more than staleness iterations behind
+    void advance();
+    //payload does not iterate anymore: release all peers
+    void finish();
+
+    //outgoing hook: stamp message with local clock
+    void stamp(const ZebulonPayloadClient::Destinations& destinations, pollux::PolluxMessage& message);
+    //incoming observer: update origin clock from any message
+    void observe(const pollux::PolluxMessage* message);
+    //handle ClockKey and WaitKey messages
+    void receive(const pollux::PolluxMessage* message);
+
+    size_t getNbBlocked() const { return nbBlocked_; }
+    double getBlockedSeconds() const { return blockedSeconds_; }
+
+  private:
+    void updateClock(int origin, uint32_t clock);
+    void sendClock(int destination, uint32_t clock);
+    //lock must be held
+    uint32_t getMinPeerClockLocked() const;
+
+    int                                 localID_        {-1};
+    uint32_t                            staleness_      {0};
+    ZebulonPayloadClient::MessageSender sender_         {};
+    mutable std::mutex                  mutex_;
+    std::condition_variable             clockChanged_;
+    uint32_t                            clock_          {0};
+    std::map<int, uint32_t>             peerClocks_     {};
+    //peers waiting for our clock to reach a value, answered by advance()
+    std::map<int, uint32_t>             waiters_        {};
+    //clock we already asked each peer to notify
+    std::map<int, uint32_t>             requested_      {};
+    size_t                              nbBlocked_      {0};
+    double                              blockedSeconds_ {0};
+    ZebulonPayloadClient*               client_         {nullptr};
+    size_t                              hookID_         {0};
+    PolluxPayload::Registrations        registrations_  {};
+};
+
+#endif /* __POLLUX_STALE_SYNCHRONOUS_H_ */
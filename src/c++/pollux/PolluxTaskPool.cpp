@@ -0,0 +1,227 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxTaskPool.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+namespace {
+
+constexpr std::chrono::microseconds MinStealBackoff{100};
+constexpr std::chrono::microseconds MaxStealBackoff{10000};
+
+std::vector<int> getAllIDs(const PolluxPayload& payload) {
+  auto ids = payload.getOtherIDs();
+  ids.push_back(payload.getLocalID());
+  return ids;
+}
+
+}
+
+PolluxTaskPool::PolluxTaskPool(
+  const std::string& name,
+  int localID,
+  const std::vector<int>& partIDs,
+  ZebulonPayloadClient::MessageSender sender):
+  name_(name),
+  localID_(localID),
+  partIDs_(partIDs),
+  sender_(sender),
+  generator_(std::random_device()() + localID) {
+  std::sort(partIDs_.begin(), partIDs_.end());
+  auto pit = std::find(partIDs_.begin(), partIDs_.end(), localID_);
+  if (pit == partIDs_.end()) {
+    throw PolluxPayloadException("task pool " + name_ + ": local ID not in part IDs");
+  }
+  rank_ = std::distance(partIDs_.begin(), pit);
+  std::copy_if(partIDs_.begin(), partIDs_.end(), std::back_inserter(peers_),
+    [this](int id) { return id != localID_; });
+}
+
+PolluxTaskPool::PolluxTaskPool(PolluxPayload& payload, ZebulonPayloadClient* client, const std::string& name):
+  PolluxTaskPool(name, payload.getLocalID(), getAllIDs(payload), client->getMessageSender()) {
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, StealPrefix + name_, handler);
+  registrations_.registerMessageHandler(payload, TasksPrefix + name_, handler);
+  registrations_.registerMessageHandler(payload, TokenPrefix + name_, handler);
+  registrations_.registerMessageHandler(payload, DonePrefix + name_, handler);
+}
+
+void PolluxTaskPool::push(pollux::PolluxMessage task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  changed_.notify_all();
+}
+
+void PolluxTaskPool::run(Executor executor) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (not terminated_) {
+    if (not tasks_.empty()) {
+      //newest first: depth first exploration keeps deques small
+      pollux::PolluxMessage task = std::move(tasks_.back());
+      tasks_.pop_back();
+      executing_ = true;
+      lock.unlock();
+      executor(task);
+      ++nbExecuted_;
+      lock.lock();
+      executing_ = false;
+      continue;
+    }
+    //idle from here: forward the token, detect termination or steal
+    if (handleTokenLocked(lock) or terminated_) {
+      continue;
+    }
+    if (not stealPending_ and not peers_.empty()) {
+      if (std::chrono::steady_clock::now() < nextSteal_) {
+        changed_.wait_until(lock, nextSteal_);
+        continue;
+      }
+      stealPending_ = true;
+      std::uniform_int_distribution<size_t> distribution(0, peers_.size()-1);
+      int victim = peers_[distribution(generator_)];
+      ++nbStealRequests_;
+      lock.unlock();
+      pollux::PolluxMessage request;
+      request.set_key(StealPrefix + name_);
+      sender_(ZebulonPayloadClient::Destinations({victim}), request);
+      lock.lock();
+      continue;
+    }
+    changed_.wait(lock);
+  }
+}
+
+bool PolluxTaskPool::handleTokenLocked(std::unique_lock<std::mutex>& lock) {
+  if (peers_.empty()) {
+    terminated_ = true;
+    return false;
+  }
+  Token token;
+  if (rank_ == 0) {
+    if (waveStarted_) {
+      if (not tokenHeld_) {
+        return false;
+      }
+      tokenHeld_ = false;
+      if (not token_.black and not black_ and token_.count + counter_ == 0) {
+        spdlog::debug("TaskPool {}: terminated", name_);
+        terminated_ = true;
+        lock.unlock();
+        pollux::PolluxMessage done;
+        done.set_key(DonePrefix + name_);
+        sender_(peers_, done);
+        lock.lock();
+        return true;
+      }
+    }
+    //start a new wave
+    waveStarted_ = true;
+    black_ = false;
+  } else {
+    if (not tokenHeld_) {
+      return false;
+    }
+    tokenHeld_ = false;
+    token = Token{token_.count + counter_, token_.black or black_};
+    black_ = false;
+  }
+  lock.unlock();
+  sendToken(token);
+  lock.lock();
+  return true;
+}
+
+void PolluxTaskPool::sendToken(const Token& token) {
+  pollux::PolluxMessage message;
+  message.set_key(TokenPrefix + name_);
+  auto values = message.mutable_int64arrayvalue()->mutable_values();
+  values->Add(token.count);
+  values->Add(token.black);
+  sender_(ZebulonPayloadClient::Destinations({partIDs_[(rank_ + 1) % partIDs_.size()]}), message);
+}
+
+void PolluxTaskPool::serveSteal(int thief) {
+  pollux::PolluxMessageBatch batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    //oldest half: tasks close to the root are usually the biggest ones
+    //a single task is only given away while another one is executing
+    size_t nbStolen = executing_ ? (tasks_.size() + 1) / 2 : tasks_.size() / 2;
+    for (size_t i = 0; i < nbStolen; i++) {
+      *batch.add_messages() = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    if (nbStolen > 0) {
+      ++counter_;
+    }
+  }
+  pollux::PolluxMessage reply;
+  reply.set_key(TasksPrefix + name_);
+  reply.set_bytesvalue(batch.SerializeAsString());
+  sender_(ZebulonPayloadClient::Destinations({thief}), reply);
+}
+
+void PolluxTaskPool::receive(const pollux::PolluxMessage* message) {
+  const std::string& key = message->key();
+  if (key.rfind(StealPrefix, 0) == 0) {
+    serveSteal(message->origin());
+    return;
+  }
+  if (key.rfind(TasksPrefix, 0) == 0) {
+    pollux::PolluxMessageBatch batch;
+    if (not batch.ParseFromString(message->bytesvalue())) {
+      throw PolluxPayloadException("malformed task pool tasks from: " + std::to_string(message->origin()));
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stealPending_ = false;
+      if (batch.messages_size() > 0) {
+        --counter_;
+        black_ = true;
+        for (auto& task: *batch.mutable_messages()) {
+          tasks_.push_back(std::move(task));
+        }
+        nbStolen_ += batch.messages_size();
+        stealBackoff_ = std::chrono::microseconds(0);
+      } else {
+        stealBackoff_ = std::clamp(stealBackoff_ * 2, MinStealBackoff, MaxStealBackoff);
+        nextSteal_ = std::chrono::steady_clock::now() + stealBackoff_;
+      }
+    }
+    changed_.notify_all();
+    return;
+  }
+  if (key.rfind(TokenPrefix, 0) == 0) {
+    if (message->value_case() != pollux::PolluxMessage::kInt64ArrayValue
+      or message->int64arrayvalue().values_size() != 2) {
+      throw PolluxPayloadException("malformed task pool token from: " + std::to_string(message->origin()));
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tokenHeld_ = true;
+      token_ = Token{message->int64arrayvalue().values(0), message->int64arrayvalue().values(1) != 0};
+    }
+    changed_.notify_all();
+    return;
+  }
+  if (key.rfind(DonePrefix, 0) == 0) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminated_ = true;
+    }
+    changed_.notify_all();
+  }
+}
+
+bool PolluxTaskPool::isTerminated() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return terminated_;
+}
@@ -0,0 +1,103 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_TASK_POOL_H_
+#define __POLLUX_TASK_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Distributed work stealing task farm for irregular workloads
+//(branch-and-bound trees, adaptive quadrature...).
+//Each payload owns a deque of tasks (serialized as PolluxMessage): it executes
+//the newest ones first, an idle payload asks a random victim for work and
+//receives the oldest half of its deque.
+//Global termination (all deques empty, nothing executing, no task in flight)
+//is detected with the Dijkstra-Safra token ring: messages carrying tasks are
+//counted, the token is only forwarded by idle payloads.
+//A pool runs once: push initial tasks, then call run() on every payload.
+class PolluxTaskPool {
+  public:
+    static constexpr const char* StealPrefix = "_pollux_taskpool_steal:";
+    static constexpr const char* TasksPrefix = "_pollux_taskpool_tasks:";
+    static constexpr const char* TokenPrefix = "_pollux_taskpool_token:";
+    static constexpr const char* DonePrefix = "_pollux_taskpool_done:";
+
+    //executes one task, may push new tasks
+    using Executor = std::function<void(const pollux::PolluxMessage& task)>;
+
+    //transport agnostic constructor
+    //name: identifies the pool, same on every payload
+    //partIDs: all payloads IDs sharing the pool (local one included)
+    PolluxTaskPool(
+      const std::string& name,
+      int localID,
+      const std::vector<int>& partIDs,
+      ZebulonPayloadClient::MessageSender sender);
+    //convenience constructor: pool is shared by all payloads,
+    //message handlers are registered on payload
+    PolluxTaskPool(PolluxPayload& payload, ZebulonPayloadClient* client, const std::string& name);
+    PolluxTaskPool(const PolluxTaskPool&) = delete;
+
+    void push(pollux::PolluxMessage task);
+
+    //execute and steal tasks until global termination
+    void run(Executor executor);
+
+    //handle steal requests (served outside run), stolen tasks, token and termination
+    void receive(const pollux::PolluxMessage* message);
+
+    bool isTerminated() const;
+    size_t getNbExecuted() const { return nbExecuted_; }
+    size_t getNbStolen() const { return nbStolen_; }
+    size_t getNbStealRequests() const { return nbStealRequests_; }
+
+  private:
+    struct Token {
+      //sum of payloads counters along the wave
+      int64_t count {0};
+      bool    black {false};
+    };
+
+    //idle payload side, lock must be held
+    //returns true if lock was released
+    bool handleTokenLocked(std::unique_lock<std::mutex>& lock);
+    void sendToken(const Token& token);
+    void serveSteal(int thief);
+
+    std::string                         name_             {};
+    int                                 localID_          {-1};
+    //ring order, rank 0 is the termination detection initiator
+    std::vector<int>                    partIDs_          {};
+    size_t                              rank_             {0};
+    std::vector<int>                    peers_            {};
+    ZebulonPayloadClient::MessageSender sender_           {};
+    mutable std::mutex                  mutex_;
+    std::condition_variable             changed_;
+    std::deque<pollux::PolluxMessage>   tasks_            {};
+    bool                                executing_        {false};
+    //Safra state: sent minus received task messages, black after a receive
+    int64_t                             counter_          {0};
+    bool                                black_            {false};
+    bool                                tokenHeld_        {false};
+    Token                               token_            {};
+    bool                                waveStarted_      {false};
+    bool                                stealPending_     {false};
+    //after a refused steal, wait before asking again
+    std::chrono::microseconds           stealBackoff_     {0};
+    std::chrono::steady_clock::time_point nextSteal_      {};
+    bool                                terminated_       {false};
+    std::mt19937                        generator_;
+    std::atomic<size_t>                 nbExecuted_       {0};
+    std::atomic<size_t>                 nbStolen_         {0};
+    std::atomic<size_t>                 nbStealRequests_  {0};
+    PolluxPayload::Registrations        registrations_    {};
+};
+
+#endif /* __POLLUX_TASK_POOL_H_ */
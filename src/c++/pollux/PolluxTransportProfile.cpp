@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxTransportProfile.h"
+
+#include "PolluxPayloadException.h"
+
+PolluxTransportProfile::PolluxTransportProfile(const std::string& name):
+  name_(name) {
+  if (name_ == "lazy") {
+    return;
+  }
+  if (name_ != "lan" and name_ != "wan") {
+    throw PolluxPayloadException("unknown transport profile: " + name_ + " (lan, wan or lazy)");
+  }
+  warmUp_ = true;
+  //zebulon (gRPC Go) closes connections pinging more often than every 5 minutes
+  keepaliveTime_ = 5*60*1000;
+  keepaliveTimeout_ = 20*1000;
+  bdpProbe_ = true;
+  maxMessageSize_ = 64*1024*1024;
+  if (name_ == "lan") {
+    connectTimeout_ = std::chrono::milliseconds(10*1000);
+    windowSize_ = 1024*1024;
+  } else {
+    //first large messages do not wait for BDP probing to open the window
+    connectTimeout_ = std::chrono::milliseconds(30*1000);
+    windowSize_ = 16*1024*1024;
+  }
+}
+
+grpc::ChannelArguments PolluxTransportProfile::getChannelArguments() const {
+  grpc::ChannelArguments arguments;
+  if (keepaliveTime_ > 0) {
+    arguments.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, keepaliveTime_);
+    arguments.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, keepaliveTimeout_);
+  }
+  if (bdpProbe_) {
+    arguments.SetInt(GRPC_ARG_HTTP2_BDP_PROBE, 1);
+  }
+  if (windowSize_ > 0) {
+    arguments.SetInt(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES, windowSize_);
+  }
+  if (maxMessageSize_ > 0) {
+    arguments.SetMaxSendMessageSize(maxMessageSize_);
+    arguments.SetMaxReceiveMessageSize(maxMessageSize_);
+  }
+  return arguments;
+}
+
+void PolluxTransportProfile::apply(grpc::ServerBuilder& builder) const {
+  if (keepaliveTime_ > 0) {
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, keepaliveTime_);
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, keepaliveTimeout_);
+  }
+  if (bdpProbe_) {
+    builder.AddChannelArgument(GRPC_ARG_HTTP2_BDP_PROBE, 1);
+  }
+  if (windowSize_ > 0) {
+    builder.AddChannelArgument(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES, windowSize_);
+  }
+  if (maxMessageSize_ > 0) {
+    builder.SetMaxReceiveMessageSize(maxMessageSize_);
+    builder.SetMaxSendMessageSize(maxMessageSize_);
+  }
+}
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_TRANSPORT_PROFILE_H_
+#define __POLLUX_TRANSPORT_PROFILE_H_
+
+#include <chrono>
+#include <string>
+
+#include <grpcpp/grpcpp.h>
+
+//gRPC connection settings of a payload: its channels to zebulon and its
+//own server. Profiles:
+// - lan (default): connections opened at startup, BDP probing, 64 MiB messages
+// - wan: same with larger initial windows and a longer connection timeout
+// - lazy: gRPC defaults, connections opened by the first call
+//Selected by the --transport_profile command line option or the
+//"transport_profile" user option (client channels only, the server is
+//already running when user options are received).
+class PolluxTransportProfile {
+  public:
+    static constexpr const char* OptionName = "transport_profile";
+
+    //throws PolluxPayloadException for unknown names
+    explicit PolluxTransportProfile(const std::string& name = "lan");
+
+    std::string getName() const { return name_; }
+    //channels are connected before the first call (see ZebulonPayloadClient)
+    bool warmsUp() const { return warmUp_; }
+    std::chrono::milliseconds getConnectTimeout() const { return connectTimeout_; }
+    //largest message the server receives, 0 for the gRPC default
+    size_t getMaxMessageSize() const { return maxMessageSize_; }
+
+    grpc::ChannelArguments getChannelArguments() const;
+    void apply(grpc::ServerBuilder& builder) const;
+
+  private:
+    std::string               name_             {};
+    bool                      warmUp_           {false};
+    std::chrono::milliseconds connectTimeout_   {0};
+    //0: gRPC defaults
+    int                       keepaliveTime_    {0};
+    int                       keepaliveTimeout_ {0};
+    bool                      bdpProbe_         {false};
+    int                       windowSize_       {0};
+    size_t                    maxMessageSize_   {0};
+};
+
+#endif /* __POLLUX_TRANSPORT_PROFILE_H_ */
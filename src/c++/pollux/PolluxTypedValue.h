@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_TYPED_VALUE_H_
+#define __POLLUX_TYPED_VALUE_H_
+
+#include <array>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "pollux.pb.h"
+#include "PolluxPayloadException.h"
+
+//Views are trivially copyable too but their pointers mean nothing to the
+//receiver: standard views, and pairs or arrays holding pointers or views.
+//Pointer fields of user structs cannot be detected.
+template<typename T>
+struct PolluxHoldsPointer: std::is_pointer<T> {};
+template<typename T, size_t Extent>
+struct PolluxHoldsPointer<std::span<T, Extent>>: std::true_type {};
+template<typename Char, typename Traits>
+struct PolluxHoldsPointer<std::basic_string_view<Char, Traits>>: std::true_type {};
+template<typename T>
+struct PolluxHoldsPointer<std::reference_wrapper<T>>: std::true_type {};
+template<typename T, size_t Size>
+struct PolluxHoldsPointer<std::array<T, Size>>: PolluxHoldsPointer<std::remove_cv_t<T>> {};
+template<typename First, typename Second>
+struct PolluxHoldsPointer<std::pair<First, Second>>: std::bool_constant<
+  PolluxHoldsPointer<std::remove_cv_t<First>>::value or PolluxHoldsPointer<std::remove_cv_t<Second>>::value> {};
+
+//Plain structs (std::pair<double, double>, std::array, aggregates of
+//arithmetic fields...) copied as they are in memory: no per field encoding.
+//Class types only, arithmetic values and arrays of them have their own
+//protobuf encodings.
+template<typename T>
+concept PolluxTrivialValue = std::is_class_v<T>
+  and std::is_standard_layout_v<T>
+  and std::is_trivially_copy_constructible_v<T>
+  and std::is_trivially_destructible_v<T>
+  and not PolluxHoldsPointer<T>::value;
+
+//Typed values travel in bytesValue: a type fingerprint then the values
+//memory. The fingerprint, computed at compile time from the type name, its
+//size and its alignment, is checked on receive: a payload decoding another
+//type gets an exception instead of garbage. Payloads exchanging typed values
+//are built by the same compiler for the same architecture (byte order and
+//padding are not converted).
+class PolluxTypedValue {
+  public:
+    static constexpr size_t HeaderSize = sizeof(uint64_t);
+
+    template<PolluxTrivialValue T>
+    static constexpr uint64_t getFingerprint() {
+      //FNV-1a
+      uint64_t hash = 14695981039346656037ull;
+      auto mix = [&hash](uint64_t byte) { hash = (hash ^ byte) * 1099511628211ull; };
+      for (char c: getTypeName<T>()) {
+        mix(static_cast<unsigned char>(c));
+      }
+      for (size_t value: {sizeof(T), alignof(T)}) {
+        for (size_t i = 0; i < sizeof(value); i++) {
+          mix((value >> (8*i)) & 0xff);
+        }
+      }
+      return hash;
+    }
+
+    template<PolluxTrivialValue T>
+    static void set(pollux::PolluxMessage& message, std::span<const T> values) {
+      constexpr uint64_t fingerprint = getFingerprint<T>();
+      std::string* bytes = message.mutable_bytesvalue();
+      bytes->resize(HeaderSize + values.size_bytes());
+      std::memcpy(bytes->data(), &fingerprint, HeaderSize);
+      if (not values.empty()) {
+        std::memcpy(bytes->data() + HeaderSize, values.data(), values.size_bytes());
+      }
+    }
+
+    //message holds values of type T
+    template<PolluxTrivialValue T>
+    static bool holds(const pollux::PolluxMessage& message) {
+      if (message.value_case() != pollux::PolluxMessage::kBytesValue
+        or message.bytesvalue().size() < HeaderSize
+        or (message.bytesvalue().size() - HeaderSize) % sizeof(T) != 0) {
+        return false;
+      }
+      uint64_t fingerprint = 0;
+      std::memcpy(&fingerprint, message.bytesvalue().data(), HeaderSize);
+      return fingerprint == getFingerprint<T>();
+    }
+
+    //throws PolluxPayloadException if message does not hold values of type T
+    template<PolluxTrivialValue T>
+    static std::vector<T> getArray(const pollux::PolluxMessage& message) {
+      check<T>(message);
+      const std::string& bytes = message.bytesvalue();
+      const size_t size = (bytes.size() - HeaderSize) / sizeof(T);
+      //bytes are not aligned for T: values are copied out
+      std::vector<T> values(size);
+      if (size > 0) {
+        std::memcpy(static_cast<void*>(values.data()), bytes.data() + HeaderSize, size * sizeof(T));
+      }
+      return values;
+    }
+
+    //throws PolluxPayloadException unless message holds exactly one T
+    template<PolluxTrivialValue T>
+    static T get(const pollux::PolluxMessage& message) {
+      check<T>(message);
+      if (message.bytesvalue().size() != HeaderSize + sizeof(T)) {
+        throw PolluxPayloadException("typed value: " + std::to_string(message.origin())
+          + " sent several values on key: " + message.key());
+      }
+      alignas(T) unsigned char storage[sizeof(T)];
+      std::memcpy(storage, message.bytesvalue().data() + HeaderSize, sizeof(T));
+      return *std::launder(reinterpret_cast<const T*>(storage));
+    }
+
+  private:
+    template<typename T>
+    static constexpr std::string_view getTypeName() {
+      return __PRETTY_FUNCTION__;
+    }
+
+    template<PolluxTrivialValue T>
+    static void check(const pollux::PolluxMessage& message) {
+      if (not holds<T>(message)) {
+        throw PolluxPayloadException("typed value: unexpected type from: " + std::to_string(message.origin())
+          + " on key: " + message.key());
+      }
+    }
+};
+
+#endif /* __POLLUX_TYPED_VALUE_H_ */
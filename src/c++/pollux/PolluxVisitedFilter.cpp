@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PolluxVisitedFilter.h"
+
+#include <algorithm>
+
+#include "PolluxPayload.h"
+#include "PolluxPayloadException.h"
+
+namespace {
+
+std::vector<int> getAllIDs(const PolluxPayload& payload) {
+  auto ids = payload.getOtherIDs();
+  ids.push_back(payload.getLocalID());
+  return ids;
+}
+
+}
+
+PolluxVisitedFilter::PolluxVisitedFilter(
+  const std::string& name,
+  int localID,
+  const std::vector<int>& partIDs,
+  size_t nbBits,
+  size_t nbHashes,
+  ZebulonPayloadClient::MessageSender sender):
+  name_(name),
+  localID_(localID),
+  partIDs_(partIDs),
+  sender_(sender),
+  shard_(nbBits, nbHashes) {
+  if (partIDs_.empty()) {
+    throw PolluxPayloadException("visited filter " + name_ + ": no part IDs");
+  }
+  std::sort(partIDs_.begin(), partIDs_.end());
+}
+
+PolluxVisitedFilter::PolluxVisitedFilter(
+  PolluxPayload& payload,
+  ZebulonPayloadClient* client,
+  const std::string& name,
+  size_t nbEntries,
+  double falsePositiveRate):
+  PolluxVisitedFilter(
+    name,
+    payload.getLocalID(),
+    getAllIDs(payload),
+    PolluxBloomFilter::getOptimalNbBits(nbEntries, falsePositiveRate) / payload.getNumberOfPayloads(),
+    PolluxBloomFilter::getOptimalNbHashes(PolluxBloomFilter::getOptimalNbBits(nbEntries, falsePositiveRate), nbEntries),
+    client->getMessageSender()) {
+  auto handler = [this](const pollux::PolluxMessage* message) { receive(message); };
+  registrations_.registerMessageHandler(payload, OperationsPrefix + name_, handler);
+  registrations_.registerMessageHandler(payload, ResultsPrefix + name_, handler);
+}
+
+int PolluxVisitedFilter::getOwner(uint64_t hash) const {
+  //lower 32 bits: shards use the upper ones to pick a block
+  return partIDs_[((hash & 0xffffffffULL) * partIDs_.size()) >> 32];
+}
+
+PolluxVisitedFilter::Results PolluxVisitedFilter::insertBatch(const std::vector<uint64_t>& keys) {
+  return execute(Insert, keys);
+}
+
+PolluxVisitedFilter::Results PolluxVisitedFilter::containsBatch(const std::vector<uint64_t>& keys) {
+  return execute(Contains, keys);
+}
+
+bool PolluxVisitedFilter::applyLocked(OperationKind kind, uint64_t hash) {
+  return kind == Insert ? shard_.insert(hash) : shard_.contains(hash);
+}
+
+PolluxVisitedFilter::Results PolluxVisitedFilter::execute(OperationKind kind, const std::vector<uint64_t>& keys) {
+  std::vector<uint64_t> hashes(keys.size());
+  PolluxBloomFilter::hashBatch(keys.data(), keys.size(), hashes.data());
+  auto request = std::make_shared<BatchRequest>();
+  request->results.resize(keys.size());
+  //one message per owner: kind, then hashes
+  std::map<int, pollux::PolluxMessage> messages;
+  std::map<int, std::vector<size_t>> positions;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t position = 0; position < hashes.size(); position++) {
+      int owner = getOwner(hashes[position]);
+      if (owner == localID_) {
+        request->results[position] = applyLocked(kind, hashes[position]);
+        continue;
+      }
+      auto operations = messages[owner].mutable_int64arrayvalue()->mutable_values();
+      if (operations->empty()) {
+        operations->Add(kind);
+      }
+      operations->Add(hashes[position]);
+      positions[owner].push_back(position);
+    }
+    for (auto& [owner, message]: messages) {
+      uint64_t correlationID = nextCorrelationID_++;
+      message.set_key(OperationsPrefix + name_);
+      message.set_correlationid(correlationID);
+      pendingBatches_[correlationID] = PendingBatch{request, std::move(positions[owner])};
+    }
+    request->remaining = messages.size();
+  }
+  Results results = request->promise.get_future();
+  if (messages.empty()) {
+    request->promise.set_value(std::move(request->results));
+  }
+  for (auto& [owner, message]: messages) {
+    ++nbSentMessages_;
+    sender_(ZebulonPayloadClient::Destinations({owner}), message);
+  }
+  return results;
+}
+
+void PolluxVisitedFilter::receive(const pollux::PolluxMessage* message) {
+  if (message->value_case() != pollux::PolluxMessage::kInt64ArrayValue
+    or message->int64arrayvalue().values_size() == 0) {
+    throw PolluxPayloadException("malformed visited filter message from: " + std::to_string(message->origin()));
+  }
+  if (message->key().rfind(ResultsPrefix, 0) == 0) {
+    receiveResults(message);
+    return;
+  }
+  const auto& operations = message->int64arrayvalue().values();
+  auto kind = static_cast<OperationKind>(operations[0]);
+  size_t nbOperations = operations.size() - 1;
+  //results: flags packed 64 per value
+  pollux::PolluxMessage results;
+  auto flags = results.mutable_int64arrayvalue()->mutable_values();
+  flags->Resize((nbOperations + 63) / 64, 0);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < nbOperations; i++) {
+      if (applyLocked(kind, operations[i+1])) {
+        flags->Set(i / 64, flags->Get(i / 64) | int64_t(uint64_t(1) << (i % 64)));
+      }
+    }
+  }
+  results.set_key(ResultsPrefix + name_);
+  results.set_correlationid(message->correlationid());
+  ++nbSentMessages_;
+  sender_(ZebulonPayloadClient::Destinations({int(message->origin())}), results);
+}
+
+void PolluxVisitedFilter::receiveResults(const pollux::PolluxMessage* message) {
+  const auto& flags = message->int64arrayvalue().values();
+  std::shared_ptr<BatchRequest> completed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto pit = pendingBatches_.find(message->correlationid());
+    if (pit == pendingBatches_.end()) {
+      return;
+    }
+    auto& [request, positions] = pit->second;
+    if (size_t(flags.size()) != (positions.size() + 63) / 64) {
+      throw PolluxPayloadException("visited filter " + name_ + ": unexpected number of results");
+    }
+    for (size_t i = 0; i < positions.size(); i++) {
+      request->results[positions[i]] = (uint64_t(flags[i / 64]) >> (i % 64)) & 1;
+    }
+    if (--request->remaining == 0) {
+      completed = request;
+    }
+    pendingBatches_.erase(pit);
+  }
+  if (completed) {
+    completed->promise.set_value(std::move(completed->results));
+  }
+}
+
+size_t PolluxVisitedFilter::getLocalNbInserted() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return shard_.getNbInserted();
+}
@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: 2023 Pollux authors <https://github.com/polluxio/pollux-payload/blob/main/AUTHORS>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __POLLUX_VISITED_FILTER_H_
+#define __POLLUX_VISITED_FILTER_H_
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "PolluxBloomFilter.h"
+#include "PolluxPayload.h"
+#include "ZebulonPayloadClient.h"
+
+//Probabilistic set of visited search states sharded across payloads:
+//each payload owns a PolluxBloomFilter shard, a state key hash selects its owner.
+//Keys are hashed once by the caller, owners receive the hashes.
+//Batch operations send one message per owner and asynchronously return
+//one flag per key (true: probably already visited, false: surely not).
+//A false positive only skips an unexplored state, no exact set is kept.
+class PolluxVisitedFilter {
+  public:
+    static constexpr const char* OperationsPrefix = "_pollux_filter_ops:";
+    static constexpr const char* ResultsPrefix = "_pollux_filter_results:";
+
+    using Results = std::future<std::vector<bool>>;
+
+    //transport agnostic constructor
+    //name: identifies the filter, same on every payload
+    //partIDs: all payloads IDs sharing the filter (local one included)
+    //nbBits, nbHashes: local shard size and number of bits per key
+    PolluxVisitedFilter(
+      const std::string& name,
+      int localID,
+      const std::vector<int>& partIDs,
+      size_t nbBits,
+      size_t nbHashes,
+      ZebulonPayloadClient::MessageSender sender);
+    //convenience constructor: filter is shared by all payloads and sized for
+    //nbEntries states in total, message handlers are registered on payload
+    PolluxVisitedFilter(
+      PolluxPayload& payload,
+      ZebulonPayloadClient* client,
+      const std::string& name,
+      size_t nbEntries,
+      double falsePositiveRate = 0.01);
+    PolluxVisitedFilter(const PolluxVisitedFilter&) = delete;
+
+    int getOwner(uint64_t hash) const;
+
+    //test and insert: flags tell which keys were already visited
+    Results insertBatch(const std::vector<uint64_t>& keys);
+    Results containsBatch(const std::vector<uint64_t>& keys);
+
+    //handle operations (owner side) and results
+    void receive(const pollux::PolluxMessage* message);
+
+    size_t getLocalNbInserted() const;
+    size_t getNbSentMessages() const { return nbSentMessages_; }
+
+  private:
+    enum OperationKind { Insert = 0, Contains = 1 };
+    struct BatchRequest {
+      std::promise<std::vector<bool>> promise   {};
+      std::vector<bool>               results   {};
+      size_t                          remaining {0};
+    };
+    struct PendingBatch {
+      std::shared_ptr<BatchRequest> request   {};
+      //positions in request results of the sent hashes
+      std::vector<size_t>           positions {};
+    };
+
+    Results execute(OperationKind kind, const std::vector<uint64_t>& keys);
+    //lock must be held
+    bool applyLocked(OperationKind kind, uint64_t hash);
+    void receiveResults(const pollux::PolluxMessage* message);
+
+    std::string                         name_               {};
+    int                                 localID_            {-1};
+    std::vector<int>                    partIDs_            {};
+    ZebulonPayloadClient::MessageSender sender_             {};
+    mutable std::mutex                  mutex_;
+    PolluxBloomFilter                   shard_;
+    uint64_t                            nextCorrelationID_  {1};
+    std::map<uint64_t, PendingBatch>    pendingBatches_     {};
+    std::atomic<size_t>                 nbSentMessages_     {0};
+    PolluxPayload::Registrations        registrations_      {};
+};
+
+#endif /* __POLLUX_VISITED_FILTER_H_ */
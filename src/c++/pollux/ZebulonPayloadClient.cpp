@@ -3,34 +3,159 @@
 
 #include "ZebulonPayloadClient.h"
 
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <random>
+#include <thread>
+
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
 #include "spdlog/spdlog.h"
 
+#include "PolluxMessageArena.h"
+#include "PolluxPayloadException.h"
+#include "PolluxReplayLog.h"
+#include "PolluxTransportProfile.h"
+
 namespace {
 
-void transmit(
+//recent latencies kept for the hedge delay, and samples needed before hedging
+const size_t nbLatencySamples = 256;
+const size_t minLatencySamples = 32;
+
+void setDeadline(grpc::ClientContext& context, std::chrono::milliseconds timeout) {
+  if (timeout.count() > 0) {
+    context.set_deadline(std::chrono::system_clock::now() + timeout);
+  }
+}
+
+//A deadline exceeded goes to the caller, which may retry or give up (the
+//message may have been delivered), any other failure means zebulon is gone.
+void checkStatus(const grpc::Status& status, const std::string& call) {
+  if (status.ok()) {
+    return;
+  }
+  spdlog::error("Error while \"{}\": {}", call, status.error_message());
+  if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+    throw PolluxPayloadException("\"" + call + "\" deadline exceeded");
+  }
+  exit(-54);
+}
+
+//A single destination without a vector allocated per transmit. A transmit
+//made meanwhile by the same thread (outgoing hook, admission) gets its own.
+template <typename Transmit>
+void withDestination(int id, Transmit transmit) {
+  thread_local ZebulonPayloadClient::Destinations destinations;
+  thread_local bool inUse = false;
+  if (inUse) {
+    transmit(ZebulonPayloadClient::Destinations({id}));
+    return;
+  }
+  inUse = true;
+  destinations.assign(1, id);
+  try {
+    transmit(destinations);
+  } catch (...) {
+    inUse = false;
+    throw;
+  }
+  inUse = false;
+}
+
+void setRouting(
   const ZebulonPayloadClient::Destinations& destinations,
   int origin,
-  pollux::ZebulonPayload::Stub* stub,
   const std::string& key,
   pollux::PolluxMessage& message) {
-  const auto start{std::chrono::steady_clock::now()};
   message.set_origin(origin);
   message.set_key(key);
   for (auto destination: destinations) {
     message.add_destinations(destination);
   }
+}
+
+void transmit(
+  const ZebulonPayloadClient::Destinations& destinations,
+  int origin,
+  pollux::ZebulonPayload::Stub* stub,
+  const std::string& key,
+  pollux::PolluxMessage& message,
+  std::chrono::milliseconds timeout,
+  grpc_compression_algorithm compression = GRPC_COMPRESS_NONE) {
+  const auto start{std::chrono::steady_clock::now()};
+  setRouting(destinations, origin, key, message);
   grpc::ClientContext context;
-  pollux::PolluxMessageResponse response;
-  grpc::Status status = stub->Transmit(&context, message, &response);
-  if (not status.ok()) {
-    spdlog::error("Error while \"transmit\": {}", status.error_message());
-    exit(-54);
+  setDeadline(context, timeout);
+  //setting it, even to none, adds metadata allocated per call
+  if (compression != GRPC_COMPRESS_NONE) {
+    context.set_compression_algorithm(compression);
   }
+  //reused by the thread, cleared fields keep their capacity
+  thread_local pollux::PolluxMessageResponse response;
+  response.Clear();
+  grpc::Status status = stub->Transmit(&context, message, &response);
+  checkStatus(status, "transmit");
   const auto end{std::chrono::steady_clock::now()};
   const std::chrono::duration<double> elapsed_seconds{end - start};
   spdlog::debug("Transmit::Response: {} in {:.6f} seconds", response.info(), elapsed_seconds.count());
 }
 
+//fragments waiting for a stream writer, bounded so that a large message
+//is never held twice in memory
+class FragmentQueue {
+  public:
+    explicit FragmentQueue(size_t capacity): capacity_(capacity) {}
+    void push(pollux::PolluxMessage&& fragment) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return fragments_.size() < capacity_; });
+      fragments_.push_back(std::move(fragment));
+      changed_.notify_all();
+    }
+    //returns false once closed and empty
+    bool pop(pollux::PolluxMessage& fragment) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return closed_ or not fragments_.empty(); });
+      if (fragments_.empty()) {
+        return false;
+      }
+      fragment = std::move(fragments_.front());
+      fragments_.pop_front();
+      changed_.notify_all();
+      return true;
+    }
+    void close() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+      changed_.notify_all();
+    }
+  private:
+    size_t                            capacity_   {0};
+    std::mutex                        mutex_;
+    std::condition_variable           changed_;
+    std::deque<pollux::PolluxMessage> fragments_  {};
+    bool                              closed_     {false};
+};
+
+//serialization sink: the adaptor hands over one fragment size block at a time
+class FragmentOutputStream: public google::protobuf::io::CopyingOutputStream {
+  public:
+    using Consumer = std::function<void(const void* data, size_t size, uint64_t offset)>;
+    explicit FragmentOutputStream(Consumer consumer): consumer_(consumer) {}
+    bool Write(const void* buffer, int size) override {
+      consumer_(buffer, size, offset_);
+      offset_ += size;
+      return true;
+    }
+  private:
+    Consumer  consumer_ {};
+    uint64_t  offset_   {0};
+};
+
 ZebulonPayloadClient::NodeStatus grpcNodeStatusToNodeStatus(pollux::NodeStatusResponse_NodeStatus grpcStatus) {
   switch (grpcStatus) {
     case pollux::NodeStatusResponse_NodeStatus_UNKNOWN:
@@ -52,65 +177,828 @@ ZebulonPayloadClient::NodeStatus grpcNodeStatusToNodeStatus(pollux::NodeStatusRe
 }
 
 ZebulonPayloadClient::ZebulonPayloadClient(std::shared_ptr<grpc::Channel> channel, int id):
-  stub_(pollux::ZebulonPayload::NewStub(channel)),
-  id_(id)
-{}
+  id_(id) {
+  std::random_device random;
+  incarnation_ = (uint64_t(random()) << 32 | random()) ^ std::chrono::system_clock::now().time_since_epoch().count();
+  for (auto& stub: stubs_) {
+    stub.store(createStub(channel), std::memory_order_release);
+  }
+  //what this payload receives: its server keeps the gRPC receive limit
+  advertised_.add_compressions(pollux::PolluxCapabilities::GZIP);
+  advertised_.add_compressions(pollux::PolluxCapabilities::DEFLATE);
+  advertised_.set_streaming(true);
+  advertised_.set_sequencing(true);
+  advertised_.set_nodebarrier(true);
+  advertised_.set_maxmessagesize(maxMessageSize_);
+}
+
+ZebulonPayloadClient::~ZebulonPayloadClient() {
+  flushOneWay();
+  {
+    std::lock_guard<std::mutex> lock(hedgesMutex_);
+    stopped_ = true;
+  }
+  hedgesChanged_.notify_all();
+  if (hedgesThread_.joinable()) {
+    hedgesThread_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(writersMutex_);
+    writersStopped_ = true;
+  }
+  writersChanged_.notify_all();
+  for (auto& writer: writers_) {
+    writer.join();
+  }
+}
+
+void ZebulonPayloadClient::setLaneChannel(Lane lane, std::shared_ptr<grpc::Channel> channel) {
+  stubs_[lane].store(createStub(channel), std::memory_order_release);
+}
+
+std::shared_ptr<grpc::Channel> ZebulonPayloadClient::createLaneChannel(
+  const std::string& address,
+  grpc::ChannelArguments arguments) {
+  //channels with identical arguments share their connection
+  arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  return grpc::CreateCustomChannel(address, grpc::InsecureChannelCredentials(), arguments);
+}
+
+ZebulonPayloadClient::Lane ZebulonPayloadClient::getTransmitLane(
+  const std::string& key,
+  const pollux::PolluxMessage& message) const {
+  if (key.rfind("_pollux_", 0) == 0 or message.ByteSizeLong() <= smallMessageSize_) {
+    return Control;
+  }
+  return Data;
+}
 
 void ZebulonPayloadClient::sendPayloadReady(uint16_t port) {
   grpc::ClientContext context;
+  setDeadline(context, transmissionTimeout_);
   pollux::PolluxVersion* version = new pollux::PolluxVersion();
   version->set_version(pollux::PolluxVersion_Version::PolluxVersion_Version_CURRENT);
   pollux::PayloadReadyMessage request;
   request.set_info("I'm alive from: " + std::to_string(id_));
   request.set_port(port);
   request.set_allocated_version(version);
+  *request.mutable_capabilities() = advertised_;
   spdlog::debug("Sending Payload Ready with port {} and GRPC schema version {}",
       port, pollux::PolluxVersion_Version::PolluxVersion_Version_CURRENT);
   pollux::PolluxStandardResponse response;
-  grpc::Status status = stub_->PayloadReady(&context, request, &response);
-  if (not status.ok()) {
-    spdlog::error("Error while sending \"sendPayloadReady\": {}", status.error_message());
-    exit(-54);
-  }
+  grpc::Status status = getStub(Control)->PayloadReady(&context, request, &response);
+  checkStatus(status, "sendPayloadReady");
   spdlog::debug("Response from Zebulon to PayloadReady: {}", response.info());
 }
 
-void ZebulonPayloadClient::sendPayloadLoopReadyForNextIteration(int iteration) {
+uint32_t ZebulonPayloadClient::sendPayloadLoopReadyForNextIteration(int iteration) {
+  return sendPayloadLoopReadyForNextIteration(iteration, Destinations());
+}
+
+uint32_t ZebulonPayloadClient::sendPayloadLoopReadyForNextIteration(int iteration, const Destinations& partIDs) {
+  prepareBarrier();
+  //no deadline: waits for the other payloads
   grpc::ClientContext context;
   pollux::PayloadLoopMessage request;
   request.set_iteration(iteration);
+  for (auto id: partIDs) {
+    request.add_partids(id);
+  }
   pollux::PolluxStandardResponse response;
-  grpc::Status status = stub_->PayloadLoopReadyForNextIteration(&context, request, &response);
+  grpc::Status status = getStub(Control)->PayloadLoopReadyForNextIteration(&context, request, &response);
   spdlog::info("Sending PayloadLoopReadyForNextIteration");
   if (not status.ok()) {
     spdlog::error("Error while sending \"sendPayloadLoopReadyForNextIteration\": {}", status.error_message());
     exit(-54);
   }
-  spdlog::debug("Response from Zebulon to PayloadLoopReadyForNextIteration: {}", response.info());
+  spdlog::debug("Response from Zebulon to PayloadLoopReadyForNextIteration: {}, iteration: {}",
+    response.info(), response.iteration());
+  return response.iteration();
+}
+
+void ZebulonPayloadClient::prepareBarrier() {
+  for (const auto& [hookID, hook]: barrierHooks_) {
+    hook();
+  }
+  flushOneWay();
 }
 
 void ZebulonPayloadClient::sendPayloadLoopEnd(int iteration) {
+  flushOneWay();
   grpc::ClientContext context;
+  setDeadline(context, transmissionTimeout_);
   pollux::PayloadLoopMessage request;
   request.set_iteration(iteration);
   pollux::PolluxStandardResponse response;
-  grpc::Status status = stub_->PayloadLoopEnd(&context, request, &response);
+  grpc::Status status = getStub(Control)->PayloadLoopEnd(&context, request, &response);
   spdlog::info("Sending PayloadEnd");
+  checkStatus(status, "sendPayloadLoopEnd");
+  spdlog::debug("Response from Zebulon to PayloadEnd: ", response.info());
+}
+
+void ZebulonPayloadClient::transmitMessage(
+  const Destinations& destinations,
+  const std::string& key,
+  pollux::PolluxMessage& message) {
+  for (const auto& [hookID, hook]: outgoingHooks_) {
+    hook(destinations, message);
+  }
+  //a relayed message must not keep its previous sequence numbers
+  message.clear_sequences();
+  //receivers start the order of a restarted payload over
+  message.set_incarnation(incarnation_);
+  //library reserved keys are neither filtered nor admitted
+  if (key.rfind("_pollux_", 0) == 0) {
+    if (isOneWay()) {
+      transmitOneWay(destinations, key, message);
+    } else {
+      ::transmit(destinations, id_, getStub(Control).get(), key, message, transmissionTimeout_);
+    }
+    return;
+  }
+  //before admission: a message that cannot be sent must not take credits
+  if (not streaming_ and message.ByteSizeLong() > maxMessageSize_) {
+    throw PolluxPayloadException("message of " + std::to_string(message.ByteSizeLong())
+      + " bytes on key: " + key + " larger than what every payload accepts without streaming");
+  }
+  //destinations are only copied when expanded or admitted
+  const Destinations* targets = &destinations;
+  Destinations expanded;
+  {
+    std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+    //broadcast expanded to interested peers, admission needs them too
+    if (targets->empty() and not peers_.empty() and (admission_ or not subscriptions_.empty())) {
+      expanded = getSubscribersLocked(key);
+      targets = &expanded;
+      nbFilteredDeliveries_ += peers_.size() - targets->size();
+      if (targets->empty()) {
+        return;
+      }
+    }
+  }
+  if (admission_) {
+    expanded = admission_(*targets, message);
+    targets = &expanded;
+    if (targets->empty()) {
+      return;
+    }
+  }
+  if (isSequenced(key)) {
+    if (targets->empty()) {
+      std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+      expanded = peers_;
+      targets = &expanded;
+    }
+    setSequences(*targets, key, message);
+  }
+  Lane lane = getTransmitLane(key, message);
+  if (lane == Data and streaming_ and message.ByteSizeLong() > fragmentSize_) {
+    transmitStreamed(*targets, key, message);
+    return;
+  }
+  if (lane == Control and isOneWay()) {
+    transmitOneWay(*targets, key, message);
+    return;
+  }
+  if (lane == Control and hedging_ and message.sequences_size() > 0) {
+    transmitHedged(*targets, key, message);
+    return;
+  }
+  ::transmit(*targets, id_, getStub(lane).get(), key, message, transmissionTimeout_,
+    lane == Data ? compression_ : GRPC_COMPRESS_NONE);
+}
+
+void ZebulonPayloadClient::setHedging(bool hedging) {
+  //receivers not sequencing would deliver both copies
+  if (hedging and not sequencing_) {
+    spdlog::warn("Hedging needs sequencing, not supported by every payload: stays off");
+    return;
+  }
+  hedging_ = hedging;
+}
+
+void ZebulonPayloadClient::transmitHedged(
+  const Destinations& destinations,
+  const std::string& key,
+  pollux::PolluxMessage& message) {
+  setRouting(destinations, id_, key, message);
+  const auto start{std::chrono::steady_clock::now()};
+  grpc::ClientContext context;
+  setDeadline(context, transmissionTimeout_);
+  auto call = std::make_shared<HedgedCall>();
+  std::chrono::microseconds delay = hedgeDelay_;
+  if (delay.count() > 0) {
+    call->message = message;
+    call->original = &context;
+    std::lock_guard<std::mutex> lock(hedgesMutex_);
+    if (not hedgesThread_.joinable()) {
+      hedgesThread_ = std::thread(&ZebulonPayloadClient::runHedges, this);
+    }
+    hedges_.emplace(start + delay, call);
+    hedgesChanged_.notify_all();
+  }
+  thread_local pollux::PolluxMessageResponse response;
+  response.Clear();
+  grpc::Status status = getStub(Control)->Transmit(&context, message, &response);
+  {
+    std::lock_guard<std::mutex> lock(call->mutex);
+    call->original = nullptr;
+    if (status.ok()) {
+      call->done = true;
+    } else if (call->done) {
+      //cancelled: the hedge was answered first
+      status = grpc::Status::OK;
+    }
+  }
+  checkStatus(status, "transmit");
+  recordLatency(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+}
+
+void ZebulonPayloadClient::transmitOneWay(
+  const Destinations& destinations,
+  const std::string& key,
+  pollux::PolluxMessage& message) {
+  setRouting(destinations, id_, key, message);
+  std::unique_lock<std::mutex> lock(oneWayMutex_);
+  if (not oneWayStream_) {
+    oneWayStream_ = std::make_unique<OneWayStream>();
+    oneWayStream_->stub = getStub(Control);
+    oneWayStream_->writer = oneWayStream_->stub->TransmitStream(&oneWayStream_->context, &oneWayStream_->response);
+  }
+  ++nbOneWay_;
+  if (oneWayStream_->writer->Write(message)) {
+    return;
+  }
+  //broken stream: Finish tells why
+  auto stream = std::move(oneWayStream_);
+  lock.unlock();
+  closeOneWay(std::move(stream));
+}
+
+void ZebulonPayloadClient::flushOneWay() {
+  std::unique_lock<std::mutex> lock(oneWayMutex_);
+  if (not oneWayStream_) {
+    return;
+  }
+  //finished outside the lock: handlers answering messages from other
+  //payloads must be able to write meanwhile, on a new stream
+  auto stream = std::move(oneWayStream_);
+  lock.unlock();
+  closeOneWay(std::move(stream));
+}
+
+void ZebulonPayloadClient::closeOneWay(std::unique_ptr<OneWayStream> stream) {
+  stream->writer->WritesDone();
+  grpc::Status status = stream->writer->Finish();
   if (not status.ok()) {
-    spdlog::error("Error while sending \"sendPayloadLoopEnd\": {}", status.error_message());
+    spdlog::error("Error while \"transmit\" one way: {}", status.error_message());
     exit(-54);
   }
-  spdlog::debug("Response from Zebulon to PayloadEnd: ", response.info());
 }
 
-void ZebulonPayloadClient::transmit(const Destinations& destinations, const std::string& key, const std::string& value) {
+void ZebulonPayloadClient::recordLatency(std::chrono::microseconds latency) {
+  std::lock_guard<std::mutex> lock(hedgesMutex_);
+  if (latencies_.size() < nbLatencySamples) {
+    latencies_.push_back(latency);
+  } else {
+    latencies_[nbLatencies_ % nbLatencySamples] = latency;
+  }
+  ++nbLatencies_;
+  if (nbLatencies_ >= minLatencySamples and nbLatencies_ % 16 == 0) {
+    auto latencies = latencies_;
+    auto p95 = latencies.begin() + latencies.size() * 95 / 100;
+    std::nth_element(latencies.begin(), p95, latencies.end());
+    hedgeDelay_ = *p95;
+  }
+}
+
+void ZebulonPayloadClient::runHedges() {
+  std::unique_lock<std::mutex> lock(hedgesMutex_);
+  while (not stopped_) {
+    if (hedges_.empty()) {
+      hedgesChanged_.wait(lock);
+      continue;
+    }
+    auto first = hedges_.begin();
+    if (std::chrono::steady_clock::now() < first->first) {
+      hedgesChanged_.wait_until(lock, first->first);
+      continue;
+    }
+    auto call = first->second.lock();
+    hedges_.erase(first);
+    if (not call) {
+      //original transmit already returned
+      continue;
+    }
+    lock.unlock();
+    sendHedge(call);
+    lock.lock();
+  }
+}
+
+void ZebulonPayloadClient::sendHedge(const std::shared_ptr<HedgedCall>& call) {
+  {
+    std::lock_guard<std::mutex> lock(call->mutex);
+    if (call->done) {
+      return;
+    }
+  }
+  ++nbHedges_;
+  //another connection than the original one
+  //without transmission timeout, a hedge gives up after 100 hedge delays
+  //so that the hedging thread is never stuck
+  grpc::ClientContext context;
+  std::chrono::milliseconds timeout = transmissionTimeout_;
+  if (timeout.count() == 0) {
+    timeout = std::max(std::chrono::duration_cast<std::chrono::milliseconds>(100 * hedgeDelay_.load()), std::chrono::milliseconds(1));
+  }
+  setDeadline(context, timeout);
+  pollux::PolluxMessageResponse response;
+  grpc::Status status = getStub(Data)->Transmit(&context, call->message, &response);
+  if (not status.ok()) {
+    //the original transmit reports failures
+    spdlog::debug("Hedged transmit failed: {}", status.error_message());
+    return;
+  }
+  std::lock_guard<std::mutex> lock(call->mutex);
+  if (not call->done) {
+    call->done = true;
+    ++nbHedgeWins_;
+    if (call->original) {
+      call->original->TryCancel();
+    }
+  }
+}
+
+void ZebulonPayloadClient::setUnordered(const std::string& key) {
+  std::lock_guard<std::mutex> lock(sequencesMutex_);
+  unorderedKeys_.insert(key);
+}
+
+bool ZebulonPayloadClient::isSequenced(const std::string& key) const {
+  if (not ordered_ or not sequencing_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sequencesMutex_);
+  return unorderedKeys_.find(key) == unorderedKeys_.end();
+}
+
+void ZebulonPayloadClient::setSequences(
+  const Destinations& destinations,
+  const std::string& key,
+  pollux::PolluxMessage& message) {
+  //without known peers a broadcast cannot be sequenced
+  if (destinations.empty()) {
+    return;
+  }
+  //serialized outside of the lock, without sequence numbers: replay sets
+  //them per destination
+  std::shared_ptr<const std::string> logged;
+  if (replayLog_) {
+    message.set_key(key);
+    logged = std::make_shared<const std::string>(message.SerializeAsString());
+  }
+  std::lock_guard<std::mutex> lock(sequencesMutex_);
+  for (auto destination: destinations) {
+    message.add_sequences(++sequences_[destination]);
+  }
+  //under the same lock as numbering: a replay never misses a message
+  if (logged) {
+    replayLog_->append(destinations, {message.sequences().data(), size_t(message.sequences_size())},
+      std::move(logged));
+  }
+}
+
+void ZebulonPayloadClient::setReplayLog(std::unique_ptr<PolluxReplayLog> replayLog) {
+  std::lock_guard<std::mutex> lock(sequencesMutex_);
+  replayLog_ = std::move(replayLog);
+}
+
+void ZebulonPayloadClient::acknowledge(int destination, uint64_t sequence) {
+  {
+    std::lock_guard<std::mutex> lock(sequencesMutex_);
+    auto& acknowledged = acknowledged_[destination];
+    acknowledged = std::max(acknowledged, sequence);
+  }
+  if (replayLog_) {
+    replayLog_->acknowledge(destination, sequence);
+  }
+}
+
+uint64_t ZebulonPayloadClient::getNbUnacknowledged(int destination) const {
+  std::lock_guard<std::mutex> lock(sequencesMutex_);
+  auto sit = sequences_.find(destination);
+  if (sit == sequences_.end()) {
+    return 0;
+  }
+  auto ait = acknowledged_.find(destination);
+  return sit->second - (ait == acknowledged_.end() ? 0 : ait->second);
+}
+
+void ZebulonPayloadClient::replay(int destination) {
+  std::vector<pollux::PolluxMessage> messages;
+  pollux::PolluxMessage start;
+  {
+    std::lock_guard<std::mutex> lock(sequencesMutex_);
+    //the restarted payload waits for the start anyway
+    if (not replayLog_) {
+      spdlog::warn("Replay requested by {} without replay log: unacknowledged messages lost", destination);
+    } else if (not replayLog_->replay(destination, messages)) {
+      spdlog::error("Replay to {}: messages lost, replay log too small", destination);
+    }
+    start.set_int64value(messages.empty() ? sequences_[destination] + 1 : messages.front().sequences(0));
+  }
+  spdlog::info("Replaying {} messages to {} from sequence {}", messages.size(), destination, start.int64value());
+  ::transmit(Destinations({destination}), id_, getStub(Control).get(), ReplayStartKey, start, transmissionTimeout_);
+  //already numbered and addressed: sent as they are
+  for (auto& message: messages) {
+    const std::string key = message.key();
+    Lane lane = getTransmitLane(key, message);
+    if (lane == Data and streaming_ and message.ByteSizeLong() > fragmentSize_) {
+      transmitStreamed(Destinations({destination}), key, message);
+    } else {
+      ::transmit(Destinations(), id_, getStub(lane).get(), key, message, transmissionTimeout_,
+        lane == Data ? compression_ : GRPC_COMPRESS_NONE);
+    }
+  }
+}
+
+void ZebulonPayloadClient::setCapabilities(const pollux::PolluxCapabilities& capabilities) {
+  capabilities_ = capabilities;
+  streaming_ = capabilities.streaming();
+  sequencing_ = capabilities.sequencing();
+  if (not streaming_ and oneWay_) {
+    spdlog::warn("One way transmits need streaming, not supported by every payload: stays off");
+  }
+  if (not capabilities.sequencing()) {
+    if (replayLog_) {
+      spdlog::warn("Replay log needs sequencing, not supported by every payload: nothing is logged");
+    }
+    hedging_ = false;
+  }
+  if (capabilities.maxmessagesize() > 0) {
+    maxMessageSize_ = capabilities.maxmessagesize();
+    //room for the fragment routing
+    fragmentSize_ = std::min(fragmentSize_, std::max(maxMessageSize_ / 2, size_t(1)));
+  }
+  compression_ = GRPC_COMPRESS_NONE;
+  if (capabilities.compressions_size() > 0) {
+    switch (capabilities.compressions(0)) {
+      case pollux::PolluxCapabilities::GZIP:
+        compression_ = GRPC_COMPRESS_GZIP;
+        break;
+      case pollux::PolluxCapabilities::DEFLATE:
+        compression_ = GRPC_COMPRESS_DEFLATE;
+        break;
+      default:
+        break;
+    }
+  }
+  spdlog::info("Capabilities: streaming {}, sequencing {}, max message size {}, compression {}",
+    streaming_.load(), capabilities.sequencing(), maxMessageSize_, int(compression_));
+}
+
+pollux::PolluxCapabilities ZebulonPayloadClient::getCommonCapabilities(
+  const pollux::PolluxCapabilities& first,
+  const pollux::PolluxCapabilities& second) {
+  pollux::PolluxCapabilities common;
+  for (auto compression: first.compressions()) {
+    const auto& others = second.compressions();
+    if (std::find(others.begin(), others.end(), compression) != others.end()) {
+      common.add_compressions(pollux::PolluxCapabilities::Compression(compression));
+    }
+  }
+  common.set_streaming(first.streaming() and second.streaming());
+  common.set_sequencing(first.sequencing() and second.sequencing());
+  common.set_nodebarrier(first.nodebarrier() and second.nodebarrier());
+  auto getMaxMessageSize = [](const pollux::PolluxCapabilities& capabilities) -> uint64_t {
+    return capabilities.maxmessagesize() > 0 ? capabilities.maxmessagesize() : GRPC_DEFAULT_MAX_RECV_MESSAGE_LENGTH;
+  };
+  common.set_maxmessagesize(std::min(getMaxMessageSize(first), getMaxMessageSize(second)));
+  return common;
+}
+
+void ZebulonPayloadClient::setDataChannels(const std::vector<std::shared_ptr<grpc::Channel>>& channels) {
+  std::lock_guard<std::mutex> lock(stubsMutex_);
+  dataStubs_.clear();
+  for (const auto& channel: channels) {
+    dataStubs_.push_back(createStub(channel));
+  }
+}
+
+std::chrono::microseconds ZebulonPayloadClient::setTransportProfile(const PolluxTransportProfile& profile) {
+  const auto arguments = profile.getChannelArguments();
+  std::vector<std::shared_ptr<grpc::Channel>> channels;
+  {
+    //transmits meanwhile use either the previous stubs or the new ones
+    std::lock_guard<std::mutex> lock(stubsMutex_);
+    for (auto& stub: stubs_) {
+      channels.push_back(createLaneChannel(zebulonAddress_, arguments));
+      stub.store(createStub(channels.back()), std::memory_order_release);
+    }
+    for (auto& stub: dataStubs_) {
+      channels.push_back(createLaneChannel(zebulonAddress_, arguments));
+      stub = createStub(channels.back());
+    }
+    transportProfile_ = profile.getName();
+  }
+  if (not profile.warmsUp()) {
+    return std::chrono::microseconds(0);
+  }
+  //resolution, TCP and HTTP/2 handshakes of every connection in parallel
+  const auto start{std::chrono::steady_clock::now()};
+  const auto deadline{std::chrono::system_clock::now() + profile.getConnectTimeout()};
+  for (const auto& channel: channels) {
+    channel->GetState(true);
+  }
+  for (const auto& channel: channels) {
+    if (not channel->WaitForConnected(deadline)) {
+      throw PolluxPayloadException("zebulon not reachable at " + zebulonAddress_
+        + " within " + std::to_string(profile.getConnectTimeout().count()) + " ms");
+    }
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
+
+void ZebulonPayloadClient::setMaxMessageSize(size_t size) {
+  maxMessageSize_ = size;
+  advertised_.set_maxmessagesize(size);
+}
+
+void ZebulonPayloadClient::transmitStreamed(
+  const Destinations& destinations,
+  const std::string& key,
+  pollux::PolluxMessage& message) {
+  message.set_origin(id_);
+  message.set_key(key);
+  //receivers find their sequence number by their index in destinations
+  message.clear_destinations();
+  for (auto destination: destinations) {
+    message.add_destinations(destination);
+  }
+  const size_t totalSize = message.ByteSizeLong();
+  if (totalSize > size_t(INT_MAX)) {
+    spdlog::error("Error while \"transmit\": {} bytes message exceeds protobuf 2 GiB limit", totalSize);
+    exit(-54);
+  }
+  const uint64_t transferID = nextTransferID_++;
+  std::vector<StubPtr> stubs;
+  {
+    std::lock_guard<std::mutex> lock(stubsMutex_);
+    stubs = dataStubs_;
+  }
+  if (stubs.empty()) {
+    stubs.push_back(getStub(Data));
+  }
+  const size_t nbFragments = (totalSize + fragmentSize_ - 1) / fragmentSize_;
+  stubs.resize(std::min(stubs.size(), nbFragments));
+
+  //serialization fills the queue, one pool writer per stream empties it
+  FragmentQueue queue(2*stubs.size());
+  const auto streamTimeout = transmissionTimeout_.load() * ((nbFragments + stubs.size() - 1) / stubs.size());
+  std::vector<std::future<grpc::Status>> streams;
+  for (const auto& stub: stubs) {
+    auto writeFragments = std::make_shared<std::packaged_task<grpc::Status()>>(
+      [&queue, stub, streamTimeout, compression = compression_]() {
+        grpc::ClientContext context;
+        setDeadline(context, streamTimeout);
+        if (compression != GRPC_COMPRESS_NONE) {
+          context.set_compression_algorithm(compression);
+        }
+        pollux::PolluxMessageResponse response;
+        auto writer = stub->TransmitStream(&context, &response);
+        pollux::PolluxMessage fragmentMessage;
+        bool broken = false;
+        while (queue.pop(fragmentMessage)) {
+          //a broken stream (Finish tells why) still empties the queue:
+          //serialization must not wait for it
+          broken = broken or not writer->Write(fragmentMessage);
+        }
+        writer->WritesDone();
+        return writer->Finish();
+      });
+    streams.push_back(writeFragments->get_future());
+    postWriterJob([writeFragments]() { (*writeFragments)(); });
+  }
+  FragmentOutputStream fragments([&](const void* data, size_t size, uint64_t offset) {
+    pollux::PolluxMessage fragmentMessage;
+    fragmentMessage.set_origin(id_);
+    fragmentMessage.set_incarnation(incarnation_);
+    fragmentMessage.set_key(FragmentKey);
+    for (auto destination: destinations) {
+      fragmentMessage.add_destinations(destination);
+    }
+    auto fragment = fragmentMessage.mutable_fragment();
+    fragment->set_transferid(transferID);
+    fragment->set_offset(offset);
+    fragment->set_totalsize(totalSize);
+    fragment->set_data(static_cast<const char*>(data), size);
+    queue.push(std::move(fragmentMessage));
+  });
+  {
+    google::protobuf::io::CopyingOutputStreamAdaptor adaptor(&fragments, fragmentSize_);
+    message.SerializeToZeroCopyStream(&adaptor);
+    adaptor.Flush();
+  }
+  queue.close();
+  //every writer is done with the queue before a failure is reported
+  std::vector<grpc::Status> statuses;
+  for (auto& stream: streams) {
+    statuses.push_back(stream.get());
+  }
+  for (const auto& status: statuses) {
+    checkStatus(status, "transmitStream");
+  }
+  spdlog::debug("Transmit: {} bytes streamed in {} fragments over {} channels", totalSize, nbFragments, stubs.size());
+}
+
+void ZebulonPayloadClient::postWriterJob(std::function<void()> job) {
+  std::lock_guard<std::mutex> lock(writersMutex_);
+  writerJobs_.push_back(std::move(job));
+  //streams of a message are written in parallel: a writer is added
+  //when none is idle
+  if (nbIdleWriters_ < writerJobs_.size()) {
+    writers_.emplace_back(&ZebulonPayloadClient::runWriter, this);
+    ++nbIdleWriters_;
+  }
+  writersChanged_.notify_one();
+}
+
+void ZebulonPayloadClient::runWriter() {
+  std::unique_lock<std::mutex> lock(writersMutex_);
+  while (true) {
+    writersChanged_.wait(lock, [this]() { return writersStopped_ or not writerJobs_.empty(); });
+    if (writerJobs_.empty()) {
+      return;
+    }
+    auto job = std::move(writerJobs_.front());
+    writerJobs_.pop_front();
+    --nbIdleWriters_;
+    lock.unlock();
+    job();
+    lock.lock();
+    ++nbIdleWriters_;
+  }
+}
+
+bool ZebulonPayloadClient::addFragment(const pollux::PolluxMessage& fragmentMessage, pollux::PolluxMessage& message) {
+  const auto& fragment = fragmentMessage.fragment();
+  const uint64_t offset = fragment.offset();
+  const size_t size = fragment.data().size();
+  if (fragment.totalsize() > uint64_t(INT_MAX) or size == 0
+    or offset > fragment.totalsize() or size > fragment.totalsize() - offset) {
+    spdlog::error("Malformed fragment at {} of {} bytes from {}",
+      offset, fragment.totalsize(), fragmentMessage.origin());
+    ++nbDroppedFragments_;
+    return false;
+  }
+  const auto transferKey = std::make_pair(int(fragmentMessage.origin()), fragment.transferid());
+  const auto now = std::chrono::steady_clock::now();
+  std::shared_ptr<char[]> buffer;
+  {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    evictTransfersLocked(fragmentMessage.origin(), fragmentMessage.incarnation(), now);
+    auto& transfer = transfers_[transferKey];
+    if (not transfer.buffer) {
+      transfer.buffer.reset(new char[fragment.totalsize()]);
+      transfer.size = fragment.totalsize();
+      transfer.incarnation = fragmentMessage.incarnation();
+    }
+    //fragments are checked against what the transfer recorded
+    auto next = transfer.ranges.upper_bound(offset);
+    bool overlaps = (next != transfer.ranges.end() and next->first < offset + size)
+      or (next != transfer.ranges.begin() and std::prev(next)->second > offset);
+    if (fragment.totalsize() != transfer.size or overlaps) {
+      spdlog::warn("Fragment at {} of {} bytes from {} dropped: {}", offset, fragment.totalsize(),
+        fragmentMessage.origin(), overlaps ? "already received" : "transfer size differs");
+      ++nbDroppedFragments_;
+      return false;
+    }
+    transfer.ranges.emplace_hint(next, offset, offset + size);
+    transfer.lastFragment = now;
+    buffer = transfer.buffer;
+  }
+  //fragments of one transfer may arrive concurrently on several streams:
+  //their ranges are reserved, the buffer stays alive until they are copied
+  std::memcpy(buffer.get() + offset, fragment.data().data(), size);
+  Transfer transfer;
+  {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    auto tit = transfers_.find(transferKey);
+    if (tit == transfers_.end() or tit->second.buffer != buffer) {
+      //evicted meanwhile
+      return false;
+    }
+    tit->second.nbReceived += size;
+    if (tit->second.nbReceived < tit->second.size) {
+      return false;
+    }
+    transfer = std::move(tit->second);
+    transfers_.erase(tit);
+  }
+  if (not message.ParseFromArray(transfer.buffer.get(), transfer.size)) {
+    spdlog::error("Cannot parse {} bytes message streamed from {}", transfer.size, fragmentMessage.origin());
+    return false;
+  }
+  return true;
+}
+
+void ZebulonPayloadClient::evictTransfersLocked(int origin, uint64_t incarnation, std::chrono::steady_clock::time_point now) {
+  const auto timeout = transferTimeout_.load();
+  for (auto tit = transfers_.begin(); tit != transfers_.end(); ) {
+    bool restarted = tit->first.first == origin and tit->second.incarnation != incarnation;
+    bool expired = timeout.count() > 0 and now - tit->second.lastFragment > timeout;
+    if (not restarted and not expired) {
+      ++tit;
+      continue;
+    }
+    spdlog::warn("Incomplete transfer {} from {} evicted ({} of {} bytes): {}", tit->first.second, tit->first.first,
+      tit->second.nbReceived, tit->second.size, restarted ? "origin restarted" : "timed out");
+    ++nbEvictedTransfers_;
+    tit = transfers_.erase(tit);
+  }
+}
+
+size_t ZebulonPayloadClient::getNbPendingTransfers() const {
+  std::lock_guard<std::mutex> lock(transfersMutex_);
+  return transfers_.size();
+}
+
+void ZebulonPayloadClient::setPeers(const Destinations& peers) {
+  std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+  peers_ = peers;
+}
+
+void ZebulonPayloadClient::publishSubscriptions(const std::set<std::string>& keys) {
+  pollux::PolluxSubscriptions subscriptions;
+  Destinations peers;
+  {
+    std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+    subscriptions.set_version(++subscriptionsVersion_);
+    subscriptions.set_incarnation(incarnation_);
+    peers = peers_;
+  }
+  if (peers.empty()) {
+    return;
+  }
+  for (const auto& key: keys) {
+    subscriptions.add_keys(key);
+  }
   pollux::PolluxMessage message;
-  message.set_strvalue(value);
-  ::transmit(destinations, id_, stub_.get(), key, message);
+  message.set_bytesvalue(subscriptions.SerializeAsString());
+  transmitMessage(peers, SubscriptionsKey, message);
+}
+
+void ZebulonPayloadClient::setSubscriptions(int id, const pollux::PolluxSubscriptions& subscriptions) {
+  std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+  auto& recorded = subscriptions_[id];
+  if (subscriptions.incarnation() == recorded.incarnation and subscriptions.version() < recorded.version) {
+    return;
+  }
+  recorded = Subscriptions{subscriptions.incarnation(), subscriptions.version(), {}, {}};
+  for (const auto& key: subscriptions.keys()) {
+    if (not key.empty() and key.back() == '*') {
+      recorded.prefixes.push_back(key.substr(0, key.size()-1));
+    } else {
+      recorded.keys.insert(key);
+    }
+  }
+}
+
+ZebulonPayloadClient::Destinations ZebulonPayloadClient::getSubscribers(const std::string& key) const {
+  std::lock_guard<std::mutex> lock(subscriptionsMutex_);
+  return getSubscribersLocked(key);
+}
+
+ZebulonPayloadClient::Destinations ZebulonPayloadClient::getSubscribersLocked(const std::string& key) const {
+  Destinations subscribers;
+  for (auto peer: peers_) {
+    auto sit = subscriptions_.find(peer);
+    if (sit == subscriptions_.end()) {
+      subscribers.push_back(peer);
+      continue;
+    }
+    const auto& subscriptions = sit->second;
+    bool interested = (subscriptions.keys.empty() and subscriptions.prefixes.empty())
+      or subscriptions.keys.find(key) != subscriptions.keys.end()
+      or std::any_of(subscriptions.prefixes.begin(), subscriptions.prefixes.end(),
+        [&key](const std::string& prefix) { return key.rfind(prefix, 0) == 0; });
+    if (interested) {
+      subscribers.push_back(peer);
+    }
+  }
+  return subscribers;
+}
+
+void ZebulonPayloadClient::transmit(const Destinations& destinations, const std::string& key, const std::string& value) {
+  PolluxMessageArena arena;
+  auto message = arena.create<pollux::PolluxMessage>();
+  message->set_strvalue(value);
+  transmitMessage(destinations, key, *message);
 }
 
 void ZebulonPayloadClient::transmit(int id, const std::string& key, const std::string& value) {
-  transmit(Destinations({id}), key, value);
+  withDestination(id, [&](const Destinations& destinations) { transmit(destinations, key, value); });
 }
 
 void ZebulonPayloadClient::transmit(const std::string& key, const std::string& value) {
@@ -118,13 +1006,14 @@ void ZebulonPayloadClient::transmit(const std::string& key, const std::string& v
 }
 
 void ZebulonPayloadClient::transmit(const Destinations& destinations, const std::string& key, int64_t value) {
-  pollux::PolluxMessage message;
-  message.set_int64value(value);
-  ::transmit(destinations, id_, stub_.get(), key, message);
+  PolluxMessageArena arena;
+  auto message = arena.create<pollux::PolluxMessage>();
+  message->set_int64value(value);
+  transmitMessage(destinations, key, *message);
 }
 
 void ZebulonPayloadClient::transmit(int id, const std::string& key, int64_t value) {
-  transmit(Destinations({id}), key, value);
+  withDestination(id, [&](const Destinations& destinations) { transmit(destinations, key, value); });
 }
 
 void ZebulonPayloadClient::transmit(const std::string& key, int64_t value) {
@@ -132,16 +1021,18 @@ void ZebulonPayloadClient::transmit(const std::string& key, int64_t value) {
 }
 
 void ZebulonPayloadClient::transmit(const Destinations& destinations, const std::string& key, const Int64Array& values) {
-  pollux::PolluxMessage message;
-  auto int64Array = message.mutable_int64arrayvalue();
+  PolluxMessageArena arena;
+  auto message = arena.create<pollux::PolluxMessage>();
+  auto int64Array = message->mutable_int64arrayvalue()->mutable_values();
+  int64Array->Reserve(values.size());
   for (auto value: values) {
-    int64Array->add_values(value);
+    int64Array->AddAlreadyReserved(value);
   }
-  ::transmit(destinations, id_, stub_.get(), key, message);
+  transmitMessage(destinations, key, *message);
 }
 
 void ZebulonPayloadClient::transmit(int id, const std::string& key, const Int64Array& values) {
-  transmit(Destinations({id}), key, values);
+  withDestination(id, [&](const Destinations& destinations) { transmit(destinations, key, values); });
 }
 
 void ZebulonPayloadClient::transmit(const std::string& key, const Int64Array& values) {
@@ -149,49 +1040,89 @@ void ZebulonPayloadClient::transmit(const std::string& key, const Int64Array& va
 }
 
 void ZebulonPayloadClient::transmit(const Destinations& destinations, const std::string& key, const DoubleArray& values) {
-  pollux::PolluxMessage message;
-  auto doubleArray = message.mutable_doublearrayvalue();
+  PolluxMessageArena arena;
+  auto message = arena.create<pollux::PolluxMessage>();
+  auto doubleArray = message->mutable_doublearrayvalue()->mutable_values();
+  doubleArray->Reserve(values.size());
   for (auto value: values) {
-    doubleArray->add_values(value);
+    doubleArray->AddAlreadyReserved(value);
   }
-  ::transmit(destinations, id_, stub_.get(), key, message);
+  transmitMessage(destinations, key, *message);
 }
 
 void ZebulonPayloadClient::transmit(int id, const std::string& key, const DoubleArray& values) {
-  transmit(Destinations({id}), key, values);
+  withDestination(id, [&](const Destinations& destinations) { transmit(destinations, key, values); });
 }
 
 void ZebulonPayloadClient::transmit(const std::string& key, const DoubleArray& values) {
   transmit(Destinations(), key, values);
 }
 
+void ZebulonPayloadClient::transmit(const Destinations& destinations, pollux::PolluxMessage& message) {
+  message.clear_destinations();
+  transmitMessage(destinations, message.key(), message);
+}
+
+void ZebulonPayloadClient::transmitBatch(pollux::PolluxMessageBatch& batch) {
+  //messages are already stamped by their origin: no outgoing hooks here
+  grpc::ClientContext context;
+  setDeadline(context, transmissionTimeout_);
+  if (compression_ != GRPC_COMPRESS_NONE) {
+    context.set_compression_algorithm(compression_);
+  }
+  pollux::PolluxMessageResponse response;
+  grpc::Status status = getStub(Data)->TransmitBatch(&context, batch, &response);
+  checkStatus(status, "transmitBatch");
+  spdlog::debug("TransmitBatch::Response: {} for {} messages", response.info(), batch.messages_size());
+}
+
+ZebulonPayloadClient::MessageSender ZebulonPayloadClient::getMessageSender() {
+  return [this](const Destinations& destinations, pollux::PolluxMessage& message) {
+    transmit(destinations, message);
+  };
+}
+
+size_t ZebulonPayloadClient::addOutgoingHook(MessageSender hook) {
+  outgoingHooks_.emplace_back(nextHookID_, hook);
+  return nextHookID_++;
+}
+
+void ZebulonPayloadClient::removeOutgoingHook(size_t hookID) {
+  std::erase_if(outgoingHooks_, [hookID](const auto& hook) { return hook.first == hookID; });
+}
+
+size_t ZebulonPayloadClient::addBarrierHook(BarrierHook hook) {
+  barrierHooks_.emplace_back(nextHookID_, hook);
+  return nextHookID_++;
+}
+
+void ZebulonPayloadClient::removeBarrierHook(size_t hookID) {
+  std::erase_if(barrierHooks_, [hookID](const auto& hook) { return hook.first == hookID; });
+}
+
 void ZebulonPayloadClient::polluxLog(const std::string& key, const std::string& value) {
   grpc::ClientContext context;
+  setDeadline(context, transmissionTimeout_);
   pollux::PolluxLogMessage message;
   message.set_origin(id_);
   (*message.mutable_map())[key] = value;
 
   pollux::PolluxStandardResponse response;
-  grpc::Status status = stub_->PolluxLog(&context, message, &response);
-  if (not status.ok()) {
-    spdlog::error("Error while sending \"polluxLog\": {}", status.error_message());
-    exit(-54);
-  }
+  grpc::Status status = getStub(Telemetry)->PolluxLog(&context, message, &response);
+  checkStatus(status, "polluxLog");
   spdlog::debug("PolluxLog: {}", response.info());
 }
 
 void ZebulonPayloadClient::polluxReport(const std::string& key, const std::string& value) {
   grpc::ClientContext context;
+  setDeadline(context, transmissionTimeout_);
   pollux::PolluxReportMessage message;
   message.set_origin(id_);
   (*message.mutable_map())[key] = value;
 
   pollux::PolluxStandardResponse response;
-  grpc::Status status = stub_->PolluxReport(&context, message, &response);
-  if (not status.ok()) {
-    spdlog::error("Error while sending \"polluxReport\": {}", status.error_message());
-    exit(-54);
-  }
+  grpc::Status status = getStub(Telemetry)->PolluxReport(&context, message, &response);
+  checkStatus(status, "polluxReport");
   spdlog::debug("PolluxReport: {}", response.info());
 }
 
@@ -213,15 +1144,13 @@ std::string ZebulonPayloadClient::NodeStatus::getString() const {
 
 ZebulonPayloadClient::NodeStatus ZebulonPayloadClient::getNodeStatus(unsigned nodeID) const {
   grpc::ClientContext context;
+  setDeadline(context, transmissionTimeout_);
   pollux::NodeStatusMessage message;
   message.set_nodeid(nodeID);
 
   pollux::NodeStatusResponse response;
-  grpc::Status status = stub_->GetNodeStatus(&context, message, &response);
-  if (not status.ok()) {
-    spdlog::error("Error while sending \"getNodeStatus\": {}", status.error_message());
-    exit(-54);
-  }
+  grpc::Status status = getStub(Control)->GetNodeStatus(&context, message, &response);
+  checkStatus(status, "getNodeStatus");
   ZebulonPayloadClient::NodeStatus nodeStatus = grpcNodeStatusToNodeStatus(response.status());
   spdlog::debug("getNodeStatus: {}", nodeStatus.getString());
   return nodeStatus;
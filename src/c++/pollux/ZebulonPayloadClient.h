@@ -4,21 +4,44 @@
 #ifndef __ZEBULON_PAYLOAD_CLIENT_H_
 #define __ZEBULON_PAYLOAD_CLIENT_H_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include <grpcpp/grpcpp.h>
 #include "pollux_payload.grpc.pb.h"
 
+#include "PolluxMessageArena.h"
+#include "PolluxTypedValue.h"
+
+class PolluxReplayLog;
+class PolluxTransportProfile;
+
 class ZebulonPayloadClient {
   public:
     ZebulonPayloadClient(std::shared_ptr<grpc::Channel> channel, int id);
+    ~ZebulonPayloadClient();
 
     void sendPayloadReady(uint16_t port);
-    void sendPayloadLoopReadyForNextIteration(int iteration);
-    void sendPayloadLoopEnd(int iteration);
-    
     //send communication to outside world
     using Destinations = std::vector<int>;
+
+    //returns the iteration currently released by zebulon
+    uint32_t sendPayloadLoopReadyForNextIteration(int iteration);
+    //node leader reporting several co-located payloads at once
+    uint32_t sendPayloadLoopReadyForNextIteration(int iteration, const Destinations& partIDs);
+    //what the barrier call does before reporting (barrier hooks, one way
+    //transmits flush), for a payload its node leader reports
+    void prepareBarrier();
+    void sendPayloadLoopEnd(int iteration);
+    
     void transmit(const Destinations& destinations, const std::string& key, const std::string& value);
     void transmit(int destination, const std::string& key, const std::string& value);
     void transmit(const std::string& key, const std::string& value);
@@ -38,6 +61,182 @@ class ZebulonPayloadClient {
     void transmit(int destination, const std::string& key, const DoubleArray& values);
     void transmit(const std::string& key, const DoubleArray& values);
 
+    //plain structs and arrays of them, memory copied in bytesValue
+    //(see PolluxTypedValue, received with PolluxPayload::registerValueHandler)
+    //Views (std::span, std::string_view...) are not values: a span sends
+    //the values it points to, whether its elements are const or not.
+    template<typename T, size_t Extent>
+      requires PolluxTrivialValue<std::remove_const_t<T>>
+    void transmit(const Destinations& destinations, const std::string& key, std::span<T, Extent> values) {
+      using Value = std::remove_const_t<T>;
+      PolluxMessageArena arena;
+      auto message = arena.create<pollux::PolluxMessage>();
+      PolluxTypedValue::set<Value>(*message, std::span<const Value>(values));
+      transmitMessage(destinations, key, *message);
+    }
+    template<PolluxTrivialValue T>
+    void transmit(const Destinations& destinations, const std::string& key, const std::vector<T>& values) {
+      transmit(destinations, key, std::span<const T>(values));
+    }
+    template<PolluxTrivialValue T>
+    void transmit(const Destinations& destinations, const std::string& key, const T& value) {
+      transmit(destinations, key, std::span<const T>(&value, 1));
+    }
+    template<typename T, size_t Extent>
+      requires PolluxTrivialValue<std::remove_const_t<T>>
+    void transmit(int destination, const std::string& key, std::span<T, Extent> values) {
+      transmit(Destinations({destination}), key, values);
+    }
+    template<typename T, size_t Extent>
+      requires PolluxTrivialValue<std::remove_const_t<T>>
+    void transmit(const std::string& key, std::span<T, Extent> values) {
+      transmit(Destinations(), key, values);
+    }
+    template<PolluxTrivialValue T>
+    void transmit(int destination, const std::string& key, const std::vector<T>& values) {
+      transmit(Destinations({destination}), key, values);
+    }
+    template<PolluxTrivialValue T>
+    void transmit(const std::string& key, const std::vector<T>& values) {
+      transmit(Destinations(), key, values);
+    }
+    template<PolluxTrivialValue T>
+    void transmit(int destination, const std::string& key, const T& value) {
+      transmit(Destinations({destination}), key, value);
+    }
+    template<PolluxTrivialValue T>
+    void transmit(const std::string& key, const T& value) {
+      transmit(Destinations(), key, value);
+    }
+
+    //send an already filled message: origin and destinations are set here
+    void transmit(const Destinations& destinations, pollux::PolluxMessage& message);
+
+    //send several already filled messages in one call,
+    //origins are kept (node leader forwarding co-located payloads messages)
+    void transmitBatch(pollux::PolluxMessageBatch& batch);
+
+    //transport agnostic sending function used by library modules
+    //(gossip, ...) so that they can also run on a loopback network
+    using MessageSender = std::function<void(const Destinations& destinations, pollux::PolluxMessage& message)>;
+    MessageSender getMessageSender();
+
+    //hooks called on every outgoing message before it is sent
+    //(clock piggybacking, ...). To be added before any transmit and removed,
+    //with the returned ID, once transmits stopped.
+    size_t addOutgoingHook(MessageSender hook);
+    void removeOutgoingHook(size_t hookID);
+    //hooks called before reporting to the iteration barrier (modules sending
+    //what they combined or deferred), same rules as outgoing hooks
+    using BarrierHook = std::function<void()>;
+    size_t addBarrierHook(BarrierHook hook);
+    void removeBarrierHook(size_t hookID);
+
+    //Admission of outgoing messages (flow control...): returns the destinations
+    //the message is sent to, may block. Broadcasts are expanded to peers first,
+    //before peers are known (setPeers) admission gets them as empty destinations.
+    //Library reserved keys ("_pollux_") are not submitted. To be set before any transmit,
+    //and reset (empty admission) once transmits stopped.
+    using Admission = std::function<Destinations(const Destinations& destinations, const pollux::PolluxMessage& message)>;
+    void setAdmission(Admission admission) { admission_ = admission; }
+
+    //Key subscriptions: broadcasts (transmit without destinations) only reach
+    //payloads interested in their key. Payloads that never published
+    //subscriptions, or published an empty set, receive every broadcast.
+    //Library reserved keys ("_pollux_") and explicit destinations are never filtered.
+    //A restarted payload (new incarnation) replaces its previous subscriptions
+    //whatever their version.
+    static constexpr const char* SubscriptionsKey = "_pollux_subscriptions";
+    //all other payloads IDs, needed to expand filtered broadcasts
+    void setPeers(const Destinations& peers);
+    //send local subscriptions to every other payload
+    void publishSubscriptions(const std::set<std::string>& keys);
+    //record subscriptions received from another payload
+    void setSubscriptions(int id, const pollux::PolluxSubscriptions& subscriptions);
+    //peers a broadcast of key is delivered to
+    Destinations getSubscribers(const std::string& key) const;
+    //deliveries saved by subscriptions filtering
+    size_t getNbFilteredDeliveries() const { return nbFilteredDeliveries_; }
+
+    //Ordered delivery: a message gets one sequence number per destination
+    //(broadcasts are expanded to peers) and receiving payloads deliver
+    //messages from one origin in that order, whatever lane, channel or stream
+    //they took. Library reserved keys ("_pollux_"), keys declared unordered
+    //and batches are delivered on arrival. Messages carry the incarnation:
+    //receivers start the order of a restarted payload over. On by default,
+    //applied once every payload announced sequencing (see setCapabilities).
+    void setOrdered(bool ordered) { ordered_ = ordered; }
+    void setUnordered(const std::string& key);
+
+    //Deadline of every call to zebulon (0: none), from PolluxControl
+    //transmissionTimeout. Fragment streams get it once per fragment they carry.
+    //The barrier call (sendPayloadLoopReadyForNextIteration) is not bounded:
+    //waiting for slow payloads is its purpose, see quorumTimeout.
+    //A call past its deadline throws PolluxPayloadException: the message may
+    //still have been delivered, retrying is the caller's choice.
+    void setTransmissionTimeout(std::chrono::milliseconds timeout) { transmissionTimeout_ = timeout; }
+    //Hedged transmits: a small sequenced message not answered after the 95th
+    //percentile of recent transmit latencies is sent again on the Data lane
+    //connection, first answer wins. Receivers drop the duplicate by its
+    //sequence number. Off by default, needs ordered delivery: only turned on
+    //once every payload announced sequencing (see setCapabilities).
+    void setHedging(bool hedging);
+    std::chrono::microseconds getHedgeDelay() const { return hedgeDelay_; }
+    size_t getNbHedges() const { return nbHedges_; }
+    //hedges answered before their original transmit
+    size_t getNbHedgeWins() const { return nbHedgeWins_; }
+
+    //Replay log (off until set): sequenced messages are kept until their
+    //destination acknowledges them (AckKey, every AckInterval deliveries and
+    //at barriers for the remaining ones).
+    //A restarted payload asks other payloads to replay (ReplayKey), each one
+    //answers with the first sequence number it replays (ReplayStartKey)
+    //then sends the unacknowledged messages again. To be set before any transmit.
+    static constexpr const char* AckKey = "_pollux_replay_ack";
+    static constexpr const char* ReplayKey = "_pollux_replay";
+    static constexpr const char* ReplayStartKey = "_pollux_replay_start";
+    static constexpr uint64_t AckInterval = 64;
+    void setReplayLog(std::unique_ptr<PolluxReplayLog> replayLog);
+    bool hasReplayLog() const { return replayLog_ != nullptr; }
+    PolluxReplayLog* getReplayLog() const { return replayLog_.get(); }
+    void acknowledge(int destination, uint64_t sequence);
+    //send the replay start and the unacknowledged messages to a restarted payload
+    void replay(int destination);
+
+    //One way mode (off by default): Control lane messages are written on a
+    //long lived TransmitStream, no response per message, no hedging.
+    //Writes are only bounded by gRPC flow control, not by the transmission
+    //timeout. Receivers acknowledge sequenced messages cumulatively
+    //(AckKey). The stream is flushed before barrier calls so that every
+    //message of an iteration is handled before the next one.
+    //Needs streaming: applied once every payload announced it (see
+    //setCapabilities).
+    void setOneWay(bool oneWay) { oneWay_ = oneWay; }
+    bool isOneWay() const { return oneWay_ and streaming_; }
+    //waits until zebulon handled every one way message written so far
+    void flushOneWay();
+    //receivers must send AckKey messages (replay log or one way mode)
+    bool needsAcknowledgements() const { return isOneWay() or replayLog_ != nullptr; }
+    //sequenced messages sent to destination and not acknowledged yet
+    uint64_t getNbUnacknowledged(int destination) const;
+    size_t getNbOneWay() const { return nbOneWay_; }
+
+    //Capabilities (see PolluxCapabilities): fast paths implemented here,
+    //advertised by sendPayloadReady. Until setCapabilities applies the set
+    //common to the run received in Start, the client keeps to the baseline
+    //(no fragments, sequence numbers, one way stream nor compression).
+    //Fast paths left out of the common set stay off, the first common codec
+    //compresses Data lane calls. Empty capabilities (Start from an older
+    //zebulon) leave the baseline. To be called before any transmit.
+    pollux::PolluxCapabilities getAdvertisedCapabilities() const { return advertised_; }
+    //applied set, empty until setCapabilities
+    pollux::PolluxCapabilities getCapabilities() const { return capabilities_; }
+    void setCapabilities(const pollux::PolluxCapabilities& capabilities);
+    //what both advertisements support, codecs in first one preference order
+    static pollux::PolluxCapabilities getCommonCapabilities(
+      const pollux::PolluxCapabilities& first,
+      const pollux::PolluxCapabilities& second);
+
     class NodeStatus {
       public:
         enum NodeStatusEnum {
@@ -62,9 +261,192 @@ class ZebulonPayloadClient {
     void polluxReport(const std::string& key, const std::string& value);
     std::string getString() const;
 
+    //Lanes: one connection each, so that latency critical traffic never waits
+    //behind bulk data on the same HTTP/2 connection.
+    // - Control: barrier and status calls, library and small messages
+    // - Data: messages larger than the small message size, batches
+    // - Telemetry: logs and reports
+    //All lanes use the constructor channel until set, to be set before any call.
+    //Messages sent on different lanes may overtake each other, ordered
+    //delivery puts them back in order.
+    enum Lane { Control, Data, Telemetry, NbLanes };
+    void setLaneChannel(Lane lane, std::shared_ptr<grpc::Channel> channel);
+    //channel opening its own connection (no subchannel sharing)
+    static std::shared_ptr<grpc::Channel> createLaneChannel(
+      const std::string& address,
+      grpc::ChannelArguments arguments = grpc::ChannelArguments());
+    //messages up to this serialized size travel on the Control lane
+    void setSmallMessageSize(size_t size) { smallMessageSize_ = size; }
+
+    //Data lane connection pool: messages larger than the fragment size are
+    //serialized by fragments into FragmentKey messages, written on one
+    //TransmitStream per pool channel in parallel, and put back together by
+    //the receiving payload (addFragment).
+    //Fragments keep messages under gRPC maximum message size, sender memory
+    //is bounded by a few fragments per stream.
+    static constexpr const char* FragmentKey = "_pollux_fragment";
+    void setDataChannels(const std::vector<std::shared_ptr<grpc::Channel>>& channels);
+    //clamped to [1, 64 MiB]
+    void setFragmentSize(size_t size) { fragmentSize_ = std::clamp(size, size_t(1), size_t(64*1024*1024)); }
+    //receiver side: fragments are copied into a buffer preallocated to the
+    //message size, returns true and fills message once all bytes arrived.
+    //Fragments out of the announced size, or overlapping bytes already
+    //received (duplicates), are dropped. Incomplete transfers are evicted once
+    //no fragment came for the transfer timeout, or when their origin restarted.
+    bool addFragment(const pollux::PolluxMessage& fragment, pollux::PolluxMessage& message);
+    //0 keeps incomplete transfers forever
+    void setTransferTimeout(std::chrono::milliseconds timeout) { transferTimeout_ = timeout; }
+    size_t getNbPendingTransfers() const;
+    size_t getNbDroppedFragments() const { return nbDroppedFragments_; }
+    size_t getNbEvictedTransfers() const { return nbEvictedTransfers_; }
+    Lane getTransmitLane(const std::string& key, const pollux::PolluxMessage& message) const;
+
+    //random per process: peers tell a restarted payload from the one they knew
+    uint64_t getIncarnation() const { return incarnation_; }
+
+    void setZebulonAddress(const std::string& address) { zebulonAddress_ = address; }
+    std::string getZebulonAddress() const { return zebulonAddress_; }
+
+    //Lane and data pool channels to zebulon created again with the profile
+    //arguments, and connected at once if the profile warms up (throws
+    //PolluxPayloadException if zebulon cannot be reached in time).
+    //Previous stubs are released once the calls and streams still using
+    //them are done. Returns the connection setup time, 0 without warm up.
+    std::chrono::microseconds setTransportProfile(const PolluxTransportProfile& profile);
+    std::string getTransportProfile() const {
+      std::lock_guard<std::mutex> lock(stubsMutex_);
+      return transportProfile_;
+    }
+    //largest message this payload receives, advertised in its capabilities
+    void setMaxMessageSize(size_t size);
+
   private:
-    std::unique_ptr<pollux::ZebulonPayload::Stub> stub_;
+    struct HedgedCall {
+      //copy sent by the hedging thread
+      pollux::PolluxMessage     message   {};
+      std::mutex                mutex;
+      //original call context while it runs, cancelled when the hedge wins
+      grpc::ClientContext*      original  {nullptr};
+      bool                      done      {false};
+    };
+    using StubPtr = std::shared_ptr<pollux::ZebulonPayload::Stub>;
+    struct OneWayStream {
+      //destroyed last: the writer calls through its channel
+      StubPtr                                                     stub      {};
+      grpc::ClientContext                                         context   {};
+      pollux::PolluxMessageResponse                               response  {};
+      std::unique_ptr<grpc::ClientWriter<pollux::PolluxMessage>>  writer    {};
+    };
+    struct Transfer {
+      //shared with the threads copying fragments outside of the lock
+      std::shared_ptr<char[]>   buffer      {};
+      size_t                    size        {0};
+      size_t                    nbReceived  {0};
+      uint64_t                  incarnation {0};
+      //received bytes: offset -> end
+      std::map<uint64_t, uint64_t> ranges   {};
+      std::chrono::steady_clock::time_point lastFragment {};
+    };
+    struct Subscriptions {
+      uint64_t                  incarnation {0};
+      uint64_t                  version     {0};
+      std::set<std::string>     keys        {};
+      std::vector<std::string>  prefixes    {};
+    };
+
+    void transmitMessage(const Destinations& destinations, const std::string& key, pollux::PolluxMessage& message);
+    //transfersMutex_ must be held
+    //evicts transfers of a restarted origin and the ones timed out
+    void evictTransfersLocked(int origin, uint64_t incarnation, std::chrono::steady_clock::time_point now);
+    //subscriptionsMutex_ must be held
+    Destinations getSubscribersLocked(const std::string& key) const;
+    //shared with the calls and streams using it: a replaced stub stays
+    //valid until they are done
+    StubPtr getStub(Lane lane) const { return stubs_[lane].load(std::memory_order_acquire); }
+    static StubPtr createStub(std::shared_ptr<grpc::Channel> channel) {
+      return StubPtr(pollux::ZebulonPayload::NewStub(channel));
+    }
+    bool isSequenced(const std::string& key) const;
+    //logs the message when replay is on
+    void setSequences(const Destinations& destinations, const std::string& key, pollux::PolluxMessage& message);
+    void transmitStreamed(const Destinations& destinations, const std::string& key, pollux::PolluxMessage& message);
+    //fragment streams are written by a pool of threads kept across messages,
+    //grown to the number of streams written at the same time
+    void postWriterJob(std::function<void()> job);
+    void runWriter();
+    void transmitHedged(const Destinations& destinations, const std::string& key, pollux::PolluxMessage& message);
+    void transmitOneWay(const Destinations& destinations, const std::string& key, pollux::PolluxMessage& message);
+    void closeOneWay(std::unique_ptr<OneWayStream> stream);
+    void recordLatency(std::chrono::microseconds latency);
+    //hedging thread
+    void runHedges();
+    void sendHedge(const std::shared_ptr<HedgedCall>& call);
+
+    //swapped by setTransportProfile while other threads transmit
+    std::atomic<StubPtr>                            stubs_[NbLanes] {};
+    mutable std::mutex                              stubsMutex_;
+    std::string                                     transportProfile_ {"lazy"};
+    pollux::PolluxCapabilities                      advertised_     {};
+    pollux::PolluxCapabilities                      capabilities_   {};
+    std::atomic<bool>                               streaming_      {false};
+    std::atomic<bool>                               sequencing_     {false};
+    //messages larger than this fail without streaming
+    size_t                                          maxMessageSize_ {GRPC_DEFAULT_MAX_RECV_MESSAGE_LENGTH};
+    grpc_compression_algorithm                      compression_    {GRPC_COMPRESS_NONE};
+    size_t                                          smallMessageSize_ {64*1024};
+    //guarded by stubsMutex_
+    std::vector<StubPtr>                            dataStubs_      {};
+    size_t                                          fragmentSize_   {1024*1024};
+    std::atomic<uint64_t>                           nextTransferID_ {1};
+    std::mutex                                      writersMutex_;
+    std::condition_variable                         writersChanged_;
+    std::deque<std::function<void()>>               writerJobs_     {};
+    std::vector<std::thread>                        writers_        {};
+    size_t                                          nbIdleWriters_  {0};
+    bool                                            writersStopped_ {false};
+    mutable std::mutex                              transfersMutex_;
+    //(origin, transfer ID) -> message being received
+    std::map<std::pair<int, uint64_t>, Transfer>    transfers_      {};
+    std::atomic<std::chrono::milliseconds>          transferTimeout_ {std::chrono::milliseconds(60000)};
+    std::atomic<size_t>                             nbDroppedFragments_ {0};
+    std::atomic<size_t>                             nbEvictedTransfers_ {0};
     int                                             id_;
+    uint64_t                                        incarnation_    {0};
+    std::vector<std::pair<size_t, MessageSender>>   outgoingHooks_  {};
+    std::vector<std::pair<size_t, BarrierHook>>     barrierHooks_   {};
+    size_t                                          nextHookID_     {1};
+    Admission                                       admission_      {};
+    std::string                                     zebulonAddress_ {};
+    mutable std::mutex                              subscriptionsMutex_;
+    Destinations                                    peers_          {};
+    std::map<int, Subscriptions>                    subscriptions_  {};
+    uint64_t                                        subscriptionsVersion_ {0};
+    std::atomic<size_t>                             nbFilteredDeliveries_ {0};
+    std::atomic<bool>                               ordered_        {true};
+    mutable std::mutex                              sequencesMutex_;
+    std::set<std::string>                           unorderedKeys_  {};
+    //last sequence number sent to each destination
+    std::map<int, uint64_t>                         sequences_      {};
+    std::unique_ptr<PolluxReplayLog>                replayLog_      {};
+    //last sequence number acknowledged by each destination
+    std::map<int, uint64_t>                         acknowledged_   {};
+    std::atomic<bool>                               oneWay_         {false};
+    std::mutex                                      oneWayMutex_;
+    std::unique_ptr<OneWayStream>                   oneWayStream_   {};
+    std::atomic<size_t>                             nbOneWay_       {0};
+    std::atomic<std::chrono::milliseconds>          transmissionTimeout_ {std::chrono::milliseconds(0)};
+    std::atomic<bool>                               hedging_        {false};
+    std::mutex                                      hedgesMutex_;
+    std::condition_variable                         hedgesChanged_;
+    std::multimap<std::chrono::steady_clock::time_point, std::weak_ptr<HedgedCall>> hedges_ {};
+    std::thread                                     hedgesThread_   {};
+    bool                                            stopped_        {false};
+    //recent transmit latencies (ring), hedge delay is their 95th percentile
+    std::vector<std::chrono::microseconds>          latencies_      {};
+    size_t                                          nbLatencies_    {0};
+    std::atomic<std::chrono::microseconds>          hedgeDelay_     {std::chrono::microseconds(0)};
+    std::atomic<size_t>                             nbHedges_       {0};
+    std::atomic<size_t>                             nbHedgeWins_    {0};
 };
 
 #endif // __ZEBULON_PAYLOAD_CLIENT_H_
@@ -7,5 +7,21 @@
 #include "PolluxPayload.h"
 #include "PolluxMethods.h"
 #include "PolluxPayloadException.h"
+#include "PolluxGossip.h"
+#include "PolluxGlobalBest.h"
+#include "PolluxStaleSynchronous.h"
+#include "PolluxQuorumBarrier.h"
+#include "PolluxNodeAggregator.h"
+#include "PolluxRpc.h"
+#include "PolluxDistributedArray.h"
+#include "PolluxShardedMap.h"
+#include "PolluxVisitedFilter.h"
+#include "PolluxTaskPool.h"
+#include "PolluxGlobalCounters.h"
+#include "PolluxFlowControl.h"
+#include "PolluxReplayLog.h"
+#include "PolluxMessageArena.h"
+#include "PolluxTypedValue.h"
+#include "PolluxTransportProfile.h"
 
 #endif /* __POLLUX_H_ */
\ No newline at end of file